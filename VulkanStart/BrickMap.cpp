@@ -0,0 +1,320 @@
+#include "BrickMap.h"
+#include "JobSystem.h"
+
+#include <iostream>
+#include <chrono>
+#include <cstring>
+#include <algorithm>
+
+//the header is read as the first uints of the grid buffer
+const size_t BRICK_MAP_HEADER_WORDS = sizeof(BrickMapHeader) / sizeof(uint32_t);
+const int BRICKS_PER_CHUNK_VOLUME = BRICKS_PER_CHUNK * BRICKS_PER_CHUNK * BRICKS_PER_CHUNK;
+const int CHUNKS_PER_BRICK_TASK = 4;
+
+static glm::ivec3 BrickInChunk(const int a_brick)
+{
+	return glm::ivec3(a_brick % BRICKS_PER_CHUNK, (a_brick / BRICKS_PER_CHUNK) % BRICKS_PER_CHUNK, a_brick / (BRICKS_PER_CHUNK * BRICKS_PER_CHUNK));
+}
+
+void BrickMap::Build(const VoxelWorld& a_world)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	m_header = BrickMapHeader{};
+	m_header.voxelSize = glm::vec4(a_world.GetVoxelSize(), 0.0f, 0.0f, 0.0f);
+	m_header.pool.y = BRICK_WORDS;
+
+	std::vector<const VoxelChunk*> chunks;
+	for (const auto& entry : a_world.GetChunks()) {
+		if (!entry.second.IsEmpty())
+		{
+			chunks.push_back(&entry.second);
+		}
+	}
+
+	glm::ivec3 minBrick(0);
+	glm::ivec3 maxBrick(-1);
+	if (!chunks.empty())
+	{
+		minBrick = chunks.front()->GetCoord() * BRICKS_PER_CHUNK;
+		maxBrick = minBrick;
+		for (const VoxelChunk* chunk : chunks) {
+			minBrick = glm::min(minBrick, chunk->GetCoord() * BRICKS_PER_CHUNK);
+			maxBrick = glm::max(maxBrick, chunk->GetCoord() * BRICKS_PER_CHUNK + glm::ivec3(BRICKS_PER_CHUNK - 1));
+		}
+
+		minBrick -= glm::ivec3(BRICK_MAP_GRID_MARGIN);
+		maxBrick += glm::ivec3(BRICK_MAP_GRID_MARGIN);
+	}
+
+	glm::ivec3 brickCounts = maxBrick - minBrick + glm::ivec3(1);
+	size_t slotCount = static_cast<size_t>(brickCounts.x) * brickCounts.y * brickCounts.z;
+
+	m_header.minCell = glm::ivec4(minBrick * BRICK_SIZE, 0);
+	m_header.brickCounts = glm::ivec4(brickCounts, 0);
+
+	m_grid.assign(BRICK_MAP_HEADER_WORDS + slotCount, BRICK_MAP_EMPTY_BRICK);
+
+	//which of the 64 bricks of every chunk hold a solid cell, so the bricks get their slots before they are filled
+	std::vector<uint64_t> solidBricks(chunks.size(), 0);
+
+	TaskGroup countGroup;
+	JobSystem::GetInstance().ParallelFor(countGroup, static_cast<int>(chunks.size()), CHUNKS_PER_BRICK_TASK, [&](int a_begin, int a_end)
+		{
+			for (int c = a_begin; c < a_end; c++) {
+				const std::vector<uint32_t>& materials = chunks[c]->GetMaterials();
+
+				for (int i = 0; i < CHUNK_VOLUME; i++) {
+					if (materials[i] != EMPTY_MATERIAL)
+					{
+						glm::ivec3 brick = glm::ivec3(i % CHUNK_SIZE, (i / CHUNK_SIZE) % CHUNK_SIZE, i / CHUNK_AREA) / BRICK_SIZE;
+						solidBricks[c] |= 1ull << (brick.x + brick.y * BRICKS_PER_CHUNK + brick.z * BRICKS_PER_CHUNK * BRICKS_PER_CHUNK);
+					}
+				}
+			}
+		});
+	countGroup.Wait();
+
+	std::vector<uint32_t> brickBases(chunks.size());
+	uint32_t brickCount = 0;
+	for (size_t c = 0; c < chunks.size(); c++) {
+		brickBases[c] = brickCount;
+		for (int b = 0; b < BRICKS_PER_CHUNK_VOLUME; b++) {
+			brickCount += (solidBricks[c] >> b) & 1ull;
+		}
+	}
+
+	//room for the bricks edits add later
+	uint32_t capacity = brickCount + std::max(BRICK_MAP_MIN_FREE_BRICKS, static_cast<uint32_t>(brickCount * BRICK_MAP_FREE_BRICK_RATIO));
+
+	m_pool.assign(static_cast<size_t>(capacity) * BRICK_WORDS, 0);
+	m_header.pool.x = capacity;
+	m_header.brickCounts.w = static_cast<int>(brickCount);
+
+	//handed out from the lowest slot on, nothing reads the old pool anymore
+	m_freeBricks.clear();
+	m_retiredBricks.clear();
+	for (uint32_t slot = capacity; slot > brickCount; slot--) {
+		m_freeBricks.push_back(slot - 1);
+	}
+
+	//every task writes the grid slots and bricks of its own chunks only
+	TaskGroup fillGroup;
+	JobSystem::GetInstance().ParallelFor(fillGroup, static_cast<int>(chunks.size()), CHUNKS_PER_BRICK_TASK, [&](int a_begin, int a_end)
+		{
+			for (int c = a_begin; c < a_end; c++) {
+				uint32_t slot = brickBases[c];
+
+				for (int b = 0; b < BRICKS_PER_CHUNK_VOLUME; b++) {
+					if (((solidBricks[c] >> b) & 1ull) == 0)
+					{
+						continue;
+					}
+
+					glm::ivec3 local = BrickInChunk(b);
+					FillBrick(*chunks[c], local * BRICK_SIZE, m_pool.data() + static_cast<size_t>(slot) * BRICK_WORDS);
+					GetSlot(chunks[c]->GetCoord() * BRICKS_PER_CHUNK + local) = slot;
+					slot++;
+				}
+			}
+		});
+	fillGroup.Wait();
+
+	std::memcpy(m_grid.data(), &m_header, sizeof(BrickMapHeader));
+
+	//a build is uploaded as a whole
+	m_dirtyBricks.clear();
+	m_version++;
+
+	m_buildTime = std::chrono::duration<float, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+bool BrickMap::Update(const VoxelWorld& a_world, const std::vector<glm::ivec3>& a_changedChunks)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	std::vector<uint32_t> brick(BRICK_WORDS);
+	m_updatedBricks = 0;
+
+	//the grids in use still point at the slots replaced now, they are retired with the next version
+	uint64_t version = m_version + 1;
+	size_t retiredCount = m_retiredBricks.size();
+
+	for (const glm::ivec3& coord : a_changedChunks) {
+		const VoxelChunk* chunk = a_world.FindChunk(coord);
+
+		for (int b = 0; b < BRICKS_PER_CHUNK_VOLUME; b++) {
+			glm::ivec3 local = BrickInChunk(b);
+			glm::ivec3 brickCoord = coord * BRICKS_PER_CHUNK + local;
+
+			bool solid = chunk != nullptr && FillBrick(*chunk, local * BRICK_SIZE, brick.data());
+
+			if (!IsInGrid(brickCoord))
+			{
+				if (solid)
+				{
+					return false;
+				}
+				continue;
+			}
+
+			uint32_t& slot = GetSlot(brickCoord);
+
+			//streamed out, the slot is free once no grid in use points at it
+			if (!solid)
+			{
+				if (slot != BRICK_MAP_EMPTY_BRICK)
+				{
+					m_retiredBricks.push_back({ slot, version });
+					slot = BRICK_MAP_EMPTY_BRICK;
+					m_header.brickCounts.w--;
+				}
+				continue;
+			}
+
+			if (slot == BRICK_MAP_EMPTY_BRICK)
+			{
+				m_header.brickCounts.w++;
+			}
+			else
+			{
+				//the chunk changed, but maybe not this brick of it
+				const uint32_t* poolBrick = m_pool.data() + static_cast<size_t>(slot) * BRICK_WORDS;
+				if (std::equal(brick.begin(), brick.end(), poolBrick))
+				{
+					continue;
+				}
+			}
+
+			if (m_freeBricks.empty())
+			{
+				return false;
+			}
+
+			//never written in place, the frames in flight may still trace the old brick
+			if (slot != BRICK_MAP_EMPTY_BRICK)
+			{
+				m_retiredBricks.push_back({ slot, version });
+			}
+
+			slot = m_freeBricks.back();
+			m_freeBricks.pop_back();
+
+			std::copy(brick.begin(), brick.end(), m_pool.data() + static_cast<size_t>(slot) * BRICK_WORDS);
+			m_dirtyBricks.push_back(slot);
+			m_updatedBricks++;
+		}
+	}
+
+	std::memcpy(m_grid.data(), &m_header, sizeof(BrickMapHeader));
+
+	if (m_updatedBricks > 0 || m_retiredBricks.size() > retiredCount)
+	{
+		m_version = version;
+	}
+
+	m_updateTime = std::chrono::duration<float, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - start).count();
+
+	return true;
+}
+
+void BrickMap::FreeRetiredBricks(const uint64_t a_version)
+{
+	auto retired = [a_version](const RetiredBrick& a_brick) { return a_brick.version <= a_version; };
+
+	for (const RetiredBrick& brick : m_retiredBricks) {
+		if (retired(brick))
+		{
+			m_freeBricks.push_back(brick.slot);
+		}
+	}
+
+	m_retiredBricks.erase(std::remove_if(m_retiredBricks.begin(), m_retiredBricks.end(), retired), m_retiredBricks.end());
+}
+
+const std::vector<uint32_t>& BrickMap::GetGrid() const
+{
+	return m_grid;
+}
+
+const std::vector<uint32_t>& BrickMap::GetPool() const
+{
+	return m_pool;
+}
+
+const BrickMapHeader& BrickMap::GetHeader() const
+{
+	return m_header;
+}
+
+uint64_t BrickMap::GetVersion() const
+{
+	return m_version;
+}
+
+const std::vector<uint32_t>& BrickMap::GetDirtyBricks() const
+{
+	return m_dirtyBricks;
+}
+
+void BrickMap::ClearDirtyBricks()
+{
+	m_dirtyBricks.clear();
+}
+
+void BrickMap::PrintStats() const
+{
+	size_t slotCount = m_grid.size() - BRICK_MAP_HEADER_WORDS;
+
+	std::cout << "" << std::endl;
+	std::cout << "Brick map: " << m_header.brickCounts.w << " of " << m_header.pool.x << " brick slots used, grid of " << slotCount << " slots ("
+		<< m_grid.size() * sizeof(uint32_t) / 1024 << " KB), pool " << m_pool.size() * sizeof(uint32_t) / (1024 * 1024) << " MB, build took "
+		<< m_buildTime << " ms";
+
+	if (m_updateTime > 0.0f)
+	{
+		std::cout << ", last update wrote " << m_updatedBricks << " bricks in " << m_updateTime << " ms";
+	}
+	std::cout << std::endl;
+}
+
+bool BrickMap::FillBrick(const VoxelChunk& a_chunk, const glm::ivec3& a_localCell, uint32_t* a_brick) const
+{
+	const std::vector<uint32_t>& materials = a_chunk.GetMaterials();
+
+	std::fill(a_brick, a_brick + BRICK_WORDS, 0u);
+	bool solid = false;
+
+	for (int z = 0; z < BRICK_SIZE; z++) {
+		for (int y = 0; y < BRICK_SIZE; y++) {
+			for (int x = 0; x < BRICK_SIZE; x++) {
+				uint32_t material = materials[VoxelChunk::ToIndex(a_localCell.x + x, a_localCell.y + y, a_localCell.z + z)];
+				if (material == EMPTY_MATERIAL)
+				{
+					continue;
+				}
+
+				int cell = x + y * BRICK_SIZE + z * BRICK_SIZE * BRICK_SIZE;
+				a_brick[cell / 32] |= 1u << (cell % 32);
+				a_brick[BRICK_MASK_WORDS + cell] = material;
+				solid = true;
+			}
+		}
+	}
+
+	return solid;
+}
+
+uint32_t& BrickMap::GetSlot(const glm::ivec3& a_brick)
+{
+	glm::ivec3 slot = a_brick - glm::ivec3(m_header.minCell) / BRICK_SIZE;
+	return m_grid[BRICK_MAP_HEADER_WORDS + slot.x + slot.y * m_header.brickCounts.x + static_cast<size_t>(slot.z) * m_header.brickCounts.x * m_header.brickCounts.y];
+}
+
+bool BrickMap::IsInGrid(const glm::ivec3& a_brick) const
+{
+	glm::ivec3 slot = a_brick - glm::ivec3(m_header.minCell) / BRICK_SIZE;
+	glm::ivec3 brickCounts = glm::ivec3(m_header.brickCounts);
+
+	return slot.x >= 0 && slot.y >= 0 && slot.z >= 0 && slot.x < brickCounts.x && slot.y < brickCounts.y && slot.z < brickCounts.z;
+}
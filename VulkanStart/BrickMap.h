@@ -0,0 +1,79 @@
+#ifndef BRICK_MAP_H
+#define BRICK_MAP_H
+
+#include "VoxelWorld.h"
+#include "MyStructs.h"
+
+#include <vector>
+#include <cstdint>
+
+const int BRICK_SIZE = 8;
+const int BRICK_VOLUME = BRICK_SIZE * BRICK_SIZE * BRICK_SIZE;
+// 512 occupancy bits, bit x + y * 8 + z * 64 is the cell
+const int BRICK_MASK_WORDS = BRICK_VOLUME / 32;
+// the mask and a colour for every cell, every brick slot of the pool has the same size
+const int BRICK_WORDS = BRICK_MASK_WORDS + BRICK_VOLUME;
+const int BRICKS_PER_CHUNK = CHUNK_SIZE / BRICK_SIZE;
+// Grid slot of a brick without solid cells
+const uint32_t BRICK_MAP_EMPTY_BRICK = 0xFFFFFFFF;
+// Empty bricks the grid reaches past the world on every side, edits there do not need a new grid
+const int BRICK_MAP_GRID_MARGIN = 4;
+// Free brick slots the pool keeps on top of the bricks of a Build, in bricks and relative to them
+const uint32_t BRICK_MAP_MIN_FREE_BRICKS = 256;
+const float BRICK_MAP_FREE_BRICK_RATIO = 0.25f;
+
+// Two level grid for the compute ray tracer: a coarse grid with one slot per 8^3 cells pointing into a pool of bricks,
+// every brick is a 512 bit occupancy mask followed by the colours of its cells.
+// The bricks have a fixed size, so a brick is streamed in or out on its own: Update writes every changed brick of the changed chunks
+// into a free slot and remembers it, the engine uploads those bricks and the (small) grid and nothing else.
+// Slots are never written while a grid on the gpu may still point at them: the slots an Update replaces or empties are retired
+// with the version of the grid that stopped using them and only become free once no older grid is in use anymore.
+class BrickMap
+{
+public:
+	// Rebuilds grid and pool, the chunks are filled in parallel on the JobSystem
+	void Build(const VoxelWorld& a_world);
+	// Rebuilds the bricks of a_changedChunks, false if one of them is outside the grid or the pool ran out of slots (Build again then)
+	bool Update(const VoxelWorld& a_world, const std::vector<glm::ivec3>& a_changedChunks);
+	// Frees the slots retired by the Updates up to grid version a_version, the oldest version any grid in use has
+	void FreeRetiredBricks(const uint64_t a_version);
+
+	// Header and grid slots
+	const std::vector<uint32_t>& GetGrid() const;
+	// All brick slots, BRICK_WORDS uints each
+	const std::vector<uint32_t>& GetPool() const;
+	const BrickMapHeader& GetHeader() const;
+	// Changes with every Build and every Update that changed a brick
+	uint64_t GetVersion() const;
+
+	// Slots written by the Updates since the last ClearDirtyBricks
+	const std::vector<uint32_t>& GetDirtyBricks() const;
+	void ClearDirtyBricks();
+
+	void PrintStats() const;
+
+private:
+	// Writes the brick starting at a_localCell of a_chunk into a_brick, false if it has no solid cell
+	bool FillBrick(const VoxelChunk& a_chunk, const glm::ivec3& a_localCell, uint32_t* a_brick) const;
+	uint32_t& GetSlot(const glm::ivec3& a_brick);
+	bool IsInGrid(const glm::ivec3& a_brick) const;
+
+	struct RetiredBrick
+	{
+		uint32_t slot;
+		uint64_t version;		// the first grid version without it
+	};
+
+	BrickMapHeader m_header{};
+	std::vector<uint32_t> m_grid;
+	std::vector<uint32_t> m_pool;
+	std::vector<uint32_t> m_freeBricks;
+	std::vector<uint32_t> m_dirtyBricks;
+	std::vector<RetiredBrick> m_retiredBricks;
+	uint64_t m_version = 0;
+
+	float m_buildTime = 0.0f;		// ms
+	float m_updateTime = 0.0f;		// ms
+	size_t m_updatedBricks = 0;
+};
+#endif // !BRICK_MAP_H
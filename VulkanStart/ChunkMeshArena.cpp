@@ -0,0 +1,624 @@
+#include "ChunkMeshArena.h"
+
+#include <iostream>
+#include <stdexcept>
+#include <algorithm>
+#include <iterator>
+#include <cstring>
+
+void ChunkMeshArena::Init(VkDevice a_logicalDevice, DeviceMemoryAllocator* a_pAllocator, UploadRing* a_pUploadRing, const bool a_directWrite,
+	const uint32_t a_frameCount)
+{
+	m_logicalDevice = a_logicalDevice;
+	m_pAllocator = a_pAllocator;
+	m_pUploadRing = a_pUploadRing;
+	m_queueFamilies = a_pUploadRing->GetQueueFamilies();
+	m_directWrite = a_directWrite;
+
+	m_frames.resize(a_frameCount);
+
+	//written every frame by the cpu culling or by cull.comp, the frame reading them is done by then
+	for (FrameDraws& frame : m_frames) {
+		CreateBuffer(sizeof(VkDrawIndexedIndirectCommand) * ARENA_MAX_DRAWS, VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, false, frame.indirectBuffer, frame.indirectMemory);
+		CreateBuffer(sizeof(ChunkDrawData) * ARENA_MAX_DRAWS, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, false, frame.drawDataBuffer, frame.drawDataMemory);
+		CreateBuffer(sizeof(ChunkCullRecord) * ARENA_MAX_DRAWS, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, false, frame.cullRecordBuffer, frame.cullRecordMemory);
+		CreateBuffer(sizeof(uint32_t) * ARENA_MAX_PAGES, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, false, frame.countBuffer, frame.countMemory);
+	}
+
+	std::cout << "" << std::endl;
+	std::cout << "Success: created chunk mesh arena, pages of " << ARENA_PAGE_VERTEX_COUNT << " vertices and " << ARENA_PAGE_INDEX_COUNT << " indices, "
+		<< (m_directWrite ? "written directly" : "written through the upload ring") << ", up to " << ARENA_MAX_DRAWS << " chunk draws" << std::endl;
+}
+
+void ChunkMeshArena::Destroy()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	for (Page& page : m_pages) {
+		if (!m_directWrite && m_queueFamilies.size() > 1)
+		{
+			m_pUploadRing->RemoveConcurrentBuffer(page.vertexBuffer);
+			m_pUploadRing->RemoveConcurrentBuffer(page.indexBuffer);
+		}
+
+		vkDestroyBuffer(m_logicalDevice, page.vertexBuffer, nullptr);
+		m_pAllocator->Free(page.vertexMemory);
+		vkDestroyBuffer(m_logicalDevice, page.indexBuffer, nullptr);
+		m_pAllocator->Free(page.indexMemory);
+	}
+	m_pages.clear();
+
+	for (FrameDraws& frame : m_frames) {
+		vkDestroyBuffer(m_logicalDevice, frame.indirectBuffer, nullptr);
+		m_pAllocator->Free(frame.indirectMemory);
+		vkDestroyBuffer(m_logicalDevice, frame.drawDataBuffer, nullptr);
+		m_pAllocator->Free(frame.drawDataMemory);
+		vkDestroyBuffer(m_logicalDevice, frame.cullRecordBuffer, nullptr);
+		m_pAllocator->Free(frame.cullRecordMemory);
+		vkDestroyBuffer(m_logicalDevice, frame.countBuffer, nullptr);
+		m_pAllocator->Free(frame.countMemory);
+	}
+	m_frames.clear();
+
+	m_retiredMeshes.clear();
+	m_draws.clear();
+	m_drawIndices.clear();
+	m_culler.Clear();
+}
+
+ArenaMesh ChunkMeshArena::Allocate(const uint32_t a_vertexCount, const uint32_t a_indexCount)
+{
+	if (a_vertexCount > ARENA_PAGE_VERTEX_COUNT || a_indexCount > ARENA_PAGE_INDEX_COUNT)
+	{
+		throw std::runtime_error("chunk mesh does not fit into an arena page!");
+	}
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	bool shortIndices = a_vertexCount <= ARENA_SHORT_INDEX_VERTEX_LIMIT;
+
+	ArenaMesh mesh;
+	mesh.vertexCount = a_vertexCount;
+	mesh.indexCount = a_indexCount;
+
+	for (size_t p = 0; p < m_pages.size(); p++) {
+		Page& page = m_pages[p];
+		if (page.shortIndices != shortIndices || !AllocateRange(page.freeVertices, a_vertexCount, mesh.firstVertex))
+		{
+			continue;
+		}
+
+		if (!AllocateRange(page.freeIndices, a_indexCount, mesh.firstIndex))
+		{
+			FreeRange(page.freeVertices, mesh.firstVertex, a_vertexCount);
+			continue;
+		}
+
+		mesh.page = static_cast<int>(p);
+		break;
+	}
+
+	if (mesh.page < 0)
+	{
+		mesh.page = CreatePage(shortIndices);
+
+		Page& page = m_pages[mesh.page];
+		AllocateRange(page.freeVertices, a_vertexCount, mesh.firstVertex);
+		AllocateRange(page.freeIndices, a_indexCount, mesh.firstIndex);
+	}
+
+	m_pages[mesh.page].usedVertices += a_vertexCount;
+	m_pages[mesh.page].usedIndices += a_indexCount;
+
+	return mesh;
+}
+
+void ChunkMeshArena::Retire(const ArenaMesh& a_mesh, const uint64_t a_frameNumber)
+{
+	if (a_mesh.page < 0)
+	{
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_retiredMeshes.push_back({ a_mesh, a_frameNumber });
+}
+
+void ChunkMeshArena::FreeRetired(const uint64_t a_frameNumber, const bool a_all)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	//same rule as the retired buffers of the engine, the frames in flight of a_frameNumber are done
+	auto retired = [this, a_frameNumber, a_all](const RetiredMesh& a_retired) { return a_all || a_frameNumber >= a_retired.frameNumber + m_frames.size(); };
+
+	for (const RetiredMesh& retiredMesh : m_retiredMeshes) {
+		if (retired(retiredMesh))
+		{
+			FreeMesh(retiredMesh.mesh);
+		}
+	}
+
+	m_retiredMeshes.erase(std::remove_if(m_retiredMeshes.begin(), m_retiredMeshes.end(), retired), m_retiredMeshes.end());
+}
+
+bool ChunkMeshArena::HasShortIndices(const ArenaMesh& a_mesh) const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_pages[a_mesh.page].shortIndices;
+}
+
+VkBuffer ChunkMeshArena::GetVertexBuffer(const ArenaMesh& a_mesh) const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_pages[a_mesh.page].vertexBuffer;
+}
+
+VkBuffer ChunkMeshArena::GetIndexBuffer(const ArenaMesh& a_mesh) const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_pages[a_mesh.page].indexBuffer;
+}
+
+VkDeviceSize ChunkMeshArena::GetVertexOffset(const ArenaMesh& a_mesh) const
+{
+	return sizeof(PackedVertex) * static_cast<VkDeviceSize>(a_mesh.firstVertex);
+}
+
+VkDeviceSize ChunkMeshArena::GetIndexOffset(const ArenaMesh& a_mesh) const
+{
+	return (HasShortIndices(a_mesh) ? sizeof(uint16_t) : sizeof(uint32_t)) * static_cast<VkDeviceSize>(a_mesh.firstIndex);
+}
+
+VkDeviceSize ChunkMeshArena::GetIndexBytes(const ArenaMesh& a_mesh) const
+{
+	return (HasShortIndices(a_mesh) ? sizeof(uint16_t) : sizeof(uint32_t)) * static_cast<VkDeviceSize>(a_mesh.indexCount);
+}
+
+PackedVertex* ChunkMeshArena::GetMappedVertices(const ArenaMesh& a_mesh) const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	void* mapped = m_pages[a_mesh.page].vertexMemory.mapped;
+	if (!m_directWrite || !mapped)
+	{
+		return nullptr;
+	}
+
+	return static_cast<PackedVertex*>(mapped) + a_mesh.firstVertex;
+}
+
+void* ChunkMeshArena::GetMappedIndices(const ArenaMesh& a_mesh) const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	const Page& page = m_pages[a_mesh.page];
+	if (!m_directWrite || !page.indexMemory.mapped)
+	{
+		return nullptr;
+	}
+
+	if (page.shortIndices)
+	{
+		return static_cast<uint16_t*>(page.indexMemory.mapped) + a_mesh.firstIndex;
+	}
+
+	return static_cast<uint32_t*>(page.indexMemory.mapped) + a_mesh.firstIndex;
+}
+
+void ChunkMeshArena::SetDraw(const glm::ivec3& a_coord, const ArenaMesh& a_mesh, const ChunkDrawData& a_drawData, const uint64_t a_frameNumber)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	//cells span origin to origin + CHUNK_SIZE - 1, the voxels reach half an extent past them
+	glm::vec3 origin = glm::vec3(a_drawData.originSize);
+	glm::vec3 boundsMin = origin - a_drawData.originSize.w;
+	glm::vec3 boundsMax = origin + glm::vec3(CHUNK_SIZE - 1) + a_drawData.originSize.w;
+
+	auto it = m_drawIndices.find(a_coord);
+	if (it != m_drawIndices.end())
+	{
+		Draw& draw = m_draws[it->second];
+
+		//frames in flight still draw the old ranges
+		m_retiredMeshes.push_back({ draw.mesh, a_frameNumber });
+		draw.mesh = a_mesh;
+		draw.drawData = a_drawData;
+		m_culler.Set(it->second, boundsMin, boundsMax);
+		m_drawsVersion++;
+		return;
+	}
+
+	m_drawIndices[a_coord] = m_culler.Add(boundsMin, boundsMax);
+	m_draws.push_back({ a_coord, a_mesh, a_drawData });
+	m_drawsVersion++;
+}
+
+void ChunkMeshArena::RemoveDraw(const glm::ivec3& a_coord, const uint64_t a_frameNumber)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	auto it = m_drawIndices.find(a_coord);
+	if (it == m_drawIndices.end())
+	{
+		return;
+	}
+
+	uint32_t index = it->second;
+	m_retiredMeshes.push_back({ m_draws[index].mesh, a_frameNumber });
+	m_drawIndices.erase(it);
+
+	//the last draw moves into the hole, the culler does the same with its box
+	m_culler.Remove(index);
+	if (index + 1 < m_draws.size())
+	{
+		m_draws[index] = m_draws.back();
+		m_drawIndices[m_draws[index].coord] = index;
+	}
+	m_draws.pop_back();
+	m_drawsVersion++;
+}
+
+size_t ChunkMeshArena::GetDrawCount() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_draws.size();
+}
+
+uint64_t ChunkMeshArena::GetDrawsVersion() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_drawsVersion;
+}
+
+void ChunkMeshArena::UpdateFrame(const uint32_t a_frame, const glm::mat4& a_viewProjection)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	FrameDraws& frame = m_frames[a_frame];
+
+	m_culler.SetViewProjection(a_viewProjection);
+	m_culler.Cull(m_visibleDraws);
+
+	if (m_visibleDraws.size() > ARENA_MAX_DRAWS)
+	{
+		throw std::runtime_error("too many visible chunk draws for the chunk mesh arena!");
+	}
+
+	//grouped by page, every page is one indirect draw over its commands, counted first so every draw is written once
+	m_pageDrawCounts.assign(m_pages.size(), 0);
+	for (uint32_t drawIndex : m_visibleDraws) {
+		m_pageDrawCounts[m_draws[drawIndex].mesh.page]++;
+	}
+
+	frame.pageFirstCommand.assign(m_pages.size() + 1, 0);
+	for (size_t p = 0; p < m_pages.size(); p++) {
+		frame.pageFirstCommand[p + 1] = frame.pageFirstCommand[p] + m_pageDrawCounts[p];
+		m_pageDrawCounts[p] = frame.pageFirstCommand[p];		//next free command of the page from here on
+	}
+
+	frame.pageBindings.resize(m_pages.size());
+	for (size_t p = 0; p < m_pages.size(); p++) {
+		frame.pageBindings[p] = { m_pages[p].vertexBuffer, m_pages[p].indexBuffer, m_pages[p].shortIndices ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32 };
+	}
+
+	ChunkDrawData* drawData = static_cast<ChunkDrawData*>(frame.drawDataMemory.mapped);
+	frame.commands.resize(m_visibleDraws.size());
+
+	for (uint32_t drawIndex : m_visibleDraws) {
+		const Draw& draw = m_draws[drawIndex];
+		uint32_t commandIndex = m_pageDrawCounts[draw.mesh.page]++;
+
+		VkDrawIndexedIndirectCommand& command = frame.commands[commandIndex];
+		command.indexCount = draw.mesh.indexCount;
+		command.instanceCount = 1;
+		command.firstIndex = draw.mesh.firstIndex;
+		command.vertexOffset = static_cast<int32_t>(draw.mesh.firstVertex);
+		command.firstInstance = commandIndex;
+
+		drawData[commandIndex] = draw.drawData;
+	}
+
+	if (!frame.commands.empty())
+	{
+		memcpy(frame.indirectMemory.mapped, frame.commands.data(), sizeof(VkDrawIndexedIndirectCommand) * frame.commands.size());
+	}
+}
+
+void ChunkMeshArena::RecordDraws(VkCommandBuffer a_commandBuffer, const uint32_t a_frame, const bool a_multiDrawIndirect) const
+{
+	RecordDrawRange(a_commandBuffer, a_frame, a_multiDrawIndirect, 0, GetCommandCount(a_frame));
+}
+
+uint32_t ChunkMeshArena::GetCommandCount(const uint32_t a_frame) const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return static_cast<uint32_t>(m_frames[a_frame].commands.size());
+}
+
+void ChunkMeshArena::RecordDrawRange(VkCommandBuffer a_commandBuffer, const uint32_t a_frame, const bool a_multiDrawIndirect, const uint32_t a_firstCommand,
+	const uint32_t a_endCommand) const
+{
+	//m_frames is sized once in Init, the frame itself is only written by UpdateFrame
+	const FrameDraws& frame = m_frames[a_frame];
+	VkDeviceSize offset = 0;
+
+	//pages created after the last UpdateFrame of the frame have no commands yet
+	for (size_t p = 0; p + 1 < frame.pageFirstCommand.size(); p++) {
+		uint32_t firstCommand = std::max(frame.pageFirstCommand[p], a_firstCommand);
+		uint32_t endCommand = std::min(frame.pageFirstCommand[p + 1], a_endCommand);
+
+		if (firstCommand >= endCommand)
+		{
+			continue;
+		}
+
+		uint32_t commandCount = endCommand - firstCommand;
+
+		const PageBinding& page = frame.pageBindings[p];
+		vkCmdBindVertexBuffers(a_commandBuffer, 0, 1, &page.vertexBuffer, &offset);
+		vkCmdBindIndexBuffer(a_commandBuffer, page.indexBuffer, 0, page.indexType);
+
+		if (a_multiDrawIndirect)
+		{
+			vkCmdDrawIndexedIndirect(a_commandBuffer, frame.indirectBuffer, sizeof(VkDrawIndexedIndirectCommand) * firstCommand, commandCount,
+				sizeof(VkDrawIndexedIndirectCommand));
+			continue;
+		}
+
+		for (uint32_t c = firstCommand; c < firstCommand + commandCount; c++) {
+			const VkDrawIndexedIndirectCommand& command = frame.commands[c];
+			vkCmdDrawIndexed(a_commandBuffer, command.indexCount, command.instanceCount, command.firstIndex, command.vertexOffset, command.firstInstance);
+		}
+	}
+}
+
+VkBuffer ChunkMeshArena::GetDrawDataBuffer(const uint32_t a_frame) const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_frames[a_frame].drawDataBuffer;
+}
+
+void ChunkMeshArena::UpdateFrameGpu(const uint32_t a_frame, const bool a_compact, ChunkCullPushConstants& a_pushConstants)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	FrameDraws& frame = m_frames[a_frame];
+
+	//the records only change with the draws, a moving camera costs the cpu nothing
+	if (frame.cullRecordVersion != m_drawsVersion)
+	{
+		if (m_draws.size() > ARENA_MAX_DRAWS)
+		{
+			throw std::runtime_error("too many chunk draws for the chunk mesh arena!");
+		}
+
+		//every page owns as many commands as it has chunks, cull.comp fills them from the front
+		m_pageDrawCounts.assign(m_pages.size(), 0);
+		for (const Draw& draw : m_draws) {
+			m_pageDrawCounts[draw.mesh.page]++;
+		}
+
+		frame.pageFirstCommand.assign(m_pages.size() + 1, 0);
+		for (size_t p = 0; p < m_pages.size(); p++) {
+			frame.pageFirstCommand[p + 1] = frame.pageFirstCommand[p] + m_pageDrawCounts[p];
+			m_pageDrawCounts[p] = frame.pageFirstCommand[p];
+		}
+
+		ChunkCullRecord* records = static_cast<ChunkCullRecord*>(frame.cullRecordMemory.mapped);
+
+		for (const Draw& draw : m_draws) {
+			uint32_t recordIndex = m_pageDrawCounts[draw.mesh.page]++;
+
+			glm::vec3 origin = glm::vec3(draw.drawData.originSize);
+
+			ChunkCullRecord& record = records[recordIndex];
+			record.boundsMin = glm::vec4(origin - draw.drawData.originSize.w, 0.0f);
+			record.boundsMax = glm::vec4(origin + glm::vec3(CHUNK_SIZE - 1) + draw.drawData.originSize.w, 0.0f);
+			record.originSize = draw.drawData.originSize;
+			record.indexCount = draw.mesh.indexCount;
+			record.firstIndex = draw.mesh.firstIndex;
+			record.vertexOffset = static_cast<int32_t>(draw.mesh.firstVertex);
+			record.page = static_cast<uint32_t>(draw.mesh.page);
+			record.outputBase = frame.pageFirstCommand[draw.mesh.page];
+		}
+
+		frame.cullRecordCount = static_cast<uint32_t>(m_draws.size());
+		frame.cullRecordVersion = m_drawsVersion;
+	}
+
+	a_pushConstants.recordCount = frame.cullRecordCount;
+	a_pushConstants.compact = a_compact ? 1 : 0;
+}
+
+void ChunkMeshArena::RecordDrawsGpuCulled(VkCommandBuffer a_commandBuffer, const uint32_t a_frame, PFN_vkCmdDrawIndexedIndirectCountKHR a_drawIndexedIndirectCount) const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	const FrameDraws& frame = m_frames[a_frame];
+	VkDeviceSize offset = 0;
+
+	for (size_t p = 0; p + 1 < frame.pageFirstCommand.size(); p++) {
+		uint32_t firstCommand = frame.pageFirstCommand[p];
+		uint32_t maxCommandCount = frame.pageFirstCommand[p + 1] - firstCommand;
+
+		if (maxCommandCount == 0)
+		{
+			continue;
+		}
+
+		const Page& page = m_pages[p];
+		vkCmdBindVertexBuffers(a_commandBuffer, 0, 1, &page.vertexBuffer, &offset);
+		vkCmdBindIndexBuffer(a_commandBuffer, page.indexBuffer, 0, page.shortIndices ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32);
+
+		if (a_drawIndexedIndirectCount)
+		{
+			a_drawIndexedIndirectCount(a_commandBuffer, frame.indirectBuffer, sizeof(VkDrawIndexedIndirectCommand) * firstCommand, 
+				frame.countBuffer, sizeof(uint32_t) * p, maxCommandCount, sizeof(VkDrawIndexedIndirectCommand));
+			continue;
+		}
+
+		vkCmdDrawIndexedIndirect(a_commandBuffer, frame.indirectBuffer, sizeof(VkDrawIndexedIndirectCommand) * firstCommand, maxCommandCount,
+			sizeof(VkDrawIndexedIndirectCommand));
+	}
+}
+
+VkBuffer ChunkMeshArena::GetCullRecordBuffer(const uint32_t a_frame) const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_frames[a_frame].cullRecordBuffer;
+}
+
+VkBuffer ChunkMeshArena::GetIndirectBuffer(const uint32_t a_frame) const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_frames[a_frame].indirectBuffer;
+}
+
+VkBuffer ChunkMeshArena::GetCountBuffer(const uint32_t a_frame) const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_frames[a_frame].countBuffer;
+}
+
+void ChunkMeshArena::PrintStats() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	const float mb = 1024.0f * 1024.0f;
+
+	std::cout << "" << std::endl;
+	std::cout << "Chunk mesh arena: " << m_pages.size() << " pages, " << m_draws.size() << " chunk draws, " << m_retiredMeshes.size()
+		<< " meshes waiting for their frames to retire" << std::endl;
+
+	m_culler.PrintStats();
+
+	for (size_t p = 0; p < m_pages.size(); p++) {
+		const Page& page = m_pages[p];
+		size_t indexSize = page.shortIndices ? sizeof(uint16_t) : sizeof(uint32_t);
+
+		std::cout << "  page " << p << " (" << (page.shortIndices ? "16" : "32") << " bit indices): "
+			<< page.usedVertices * sizeof(PackedVertex) / mb << " of " << ARENA_PAGE_VERTEX_COUNT * sizeof(PackedVertex) / mb << " MB vertices, "
+			<< page.usedIndices * indexSize / mb << " of " << ARENA_PAGE_INDEX_COUNT * indexSize / mb << " MB indices, "
+			<< page.freeVertices.size() + page.freeIndices.size() << " free ranges" << std::endl;
+	}
+}
+
+int ChunkMeshArena::CreatePage(const bool a_shortIndices)
+{
+	if (m_pages.size() >= ARENA_MAX_PAGES)
+	{
+		throw std::runtime_error("chunk mesh arena is out of pages!");
+	}
+
+	Page page;
+	page.shortIndices = a_shortIndices;
+
+	VkMemoryPropertyFlags properties = m_directWrite ? DIRECT_WRITE_MEMORY_PROPERTIES : VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+	bool concurrent = !m_directWrite && m_queueFamilies.size() > 1;
+	VkDeviceSize indexSize = a_shortIndices ? sizeof(uint16_t) : sizeof(uint32_t);
+
+	CreateBuffer(sizeof(PackedVertex) * static_cast<VkDeviceSize>(ARENA_PAGE_VERTEX_COUNT), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		properties, concurrent, page.vertexBuffer, page.vertexMemory);
+	CreateBuffer(indexSize * ARENA_PAGE_INDEX_COUNT, VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		properties, concurrent, page.indexBuffer, page.indexMemory);
+
+	if (concurrent)
+	{
+		m_pUploadRing->AddConcurrentBuffer(page.vertexBuffer);
+		m_pUploadRing->AddConcurrentBuffer(page.indexBuffer);
+	}
+
+	page.freeVertices[0] = ARENA_PAGE_VERTEX_COUNT;
+	page.freeIndices[0] = ARENA_PAGE_INDEX_COUNT;
+
+	m_pages.push_back(page);
+
+	std::cout << "" << std::endl;
+	std::cout << "Chunk mesh arena: added page " << m_pages.size() - 1 << " with " << (a_shortIndices ? "16" : "32") << " bit indices" << std::endl;
+
+	return static_cast<int>(m_pages.size() - 1);
+}
+
+void ChunkMeshArena::CreateBuffer(const VkDeviceSize a_size, const VkBufferUsageFlags a_usage, const VkMemoryPropertyFlags a_properties, const bool a_concurrent,
+	VkBuffer& a_buffer, MemoryAllocation& a_memory)
+{
+	VkBufferCreateInfo bufferInfo{};
+	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferInfo.size = a_size;
+	bufferInfo.usage = a_usage;
+	bufferInfo.sharingMode = a_concurrent ? VK_SHARING_MODE_CONCURRENT : VK_SHARING_MODE_EXCLUSIVE;
+	bufferInfo.queueFamilyIndexCount = a_concurrent ? static_cast<uint32_t>(m_queueFamilies.size()) : 0;
+	bufferInfo.pQueueFamilyIndices = a_concurrent ? m_queueFamilies.data() : nullptr;
+
+	if (vkCreateBuffer(m_logicalDevice, &bufferInfo, nullptr, &a_buffer) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create chunk mesh arena buffer!");
+	}
+
+	VkMemoryRequirements memRequirements;
+	vkGetBufferMemoryRequirements(m_logicalDevice, a_buffer, &memRequirements);
+
+	a_memory = m_pAllocator->Allocate(memRequirements, a_properties, AllocationKind::BUFFER);
+
+	vkBindBufferMemory(m_logicalDevice, a_buffer, a_memory.memory, a_memory.offset);
+}
+
+void ChunkMeshArena::FreeMesh(const ArenaMesh& a_mesh)
+{
+	Page& page = m_pages[a_mesh.page];
+
+	FreeRange(page.freeVertices, a_mesh.firstVertex, a_mesh.vertexCount);
+	FreeRange(page.freeIndices, a_mesh.firstIndex, a_mesh.indexCount);
+
+	page.usedVertices -= a_mesh.vertexCount;
+	page.usedIndices -= a_mesh.indexCount;
+}
+
+bool ChunkMeshArena::AllocateRange(std::map<uint32_t, uint32_t>& a_freeRanges, const uint32_t a_count, uint32_t& a_offset)
+{
+	for (auto it = a_freeRanges.begin(); it != a_freeRanges.end(); ++it) {
+		if (it->second < a_count)
+		{
+			continue;
+		}
+
+		a_offset = it->first;
+		uint32_t rest = it->second - a_count;
+
+		a_freeRanges.erase(it);
+		if (rest > 0)
+		{
+			a_freeRanges[a_offset + a_count] = rest;
+		}
+
+		return true;
+	}
+
+	return false;
+}
+
+void ChunkMeshArena::FreeRange(std::map<uint32_t, uint32_t>& a_freeRanges, const uint32_t a_offset, const uint32_t a_count)
+{
+	auto it = a_freeRanges.emplace(a_offset, a_count).first;
+
+	//merge with the following range
+	auto next = std::next(it);
+	if (next != a_freeRanges.end() && it->first + it->second == next->first)
+	{
+		it->second += next->second;
+		a_freeRanges.erase(next);
+	}
+
+	//and with the preceding one
+	if (it != a_freeRanges.begin())
+	{
+		auto prev = std::prev(it);
+		if (prev->first + prev->second == it->first)
+		{
+			prev->second += it->second;
+			a_freeRanges.erase(it);
+		}
+	}
+}
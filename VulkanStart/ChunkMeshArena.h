@@ -0,0 +1,180 @@
+#ifndef CHUNK_MESH_ARENA_H
+#define CHUNK_MESH_ARENA_H
+
+#include "DeviceMemoryAllocator.h"
+#include "UploadRing.h"
+#include "MyStructs.h"
+#include "VoxelWorld.h"
+#include "FrustumCuller.h"
+
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <mutex>
+
+// Size of one arena page, a page is one vertex and one index buffer
+const uint32_t ARENA_PAGE_VERTEX_COUNT = 4 * 1024 * 1024;		// 32 MB of PackedVertex
+const uint32_t ARENA_PAGE_INDEX_COUNT = 8 * 1024 * 1024;		// 16 MB of 16 bit or 32 MB of 32 bit indices
+// Chunks with more vertices need 32 bit indices, they share pages of their own
+const uint32_t ARENA_SHORT_INDEX_VERTEX_LIMIT = 65536;
+// Chunk draws the indirect and draw data buffer of a frame hold
+const uint32_t ARENA_MAX_DRAWS = 65536;
+// Pages the draw counts of the gpu culling have room for
+const uint32_t ARENA_MAX_PAGES = 64;
+// Workgroup size of cull.comp
+const uint32_t CHUNK_CULL_GROUP_SIZE = 64;
+
+// Where one chunk mesh lives in the arena, vertices and indices are counted in elements of their page
+struct ArenaMesh
+{
+	int page = -1;
+	uint32_t firstVertex = 0;
+	uint32_t vertexCount = 0;
+	uint32_t firstIndex = 0;
+	uint32_t indexCount = 0;
+};
+
+// Every chunk mesh of the chunked mode lives in a few big vertex and index buffers (pages), sub allocated with a free list
+// (first fit, coalescing). Pages hold either 16 bit or 32 bit indices, only chunks with more than 65536 vertices need the latter.
+// Every frame the chunk bounds are culled against the view frustum, the visible chunks are written as VkDrawIndexedIndirectCommands
+// into a buffer per frame in flight, grouped by page, so the world draws with one vkCmdDrawIndexedIndirect per page.
+// firstInstance indexes the ChunkDrawData packed.vert reads.
+// A remeshed chunk gets new ranges, the old ones come back once the frames that may still draw them retired.
+// Allocate and the getters can be called from any thread, everything else only from the render thread.
+class ChunkMeshArena
+{
+public:
+	// Staged pages are shared with the transfer queue of a_pUploadRing (concurrent), so a range can be copied while the others are drawn.
+	// a_directWrite puts the pages into DIRECT_WRITE_MEMORY_PROPERTIES, the cpu writes them through GetMappedVertices/GetMappedIndices
+	void Init(VkDevice a_logicalDevice, DeviceMemoryAllocator* a_pAllocator, UploadRing* a_pUploadRing, const bool a_directWrite,
+		const uint32_t a_frameCount);
+	void Destroy();
+
+	// Adds a page if no page of the index type has room left
+	ArenaMesh Allocate(const uint32_t a_vertexCount, const uint32_t a_indexCount);
+	// The ranges come back with the first FreeRetired a_frameCount frames after a_frameNumber
+	void Retire(const ArenaMesh& a_mesh, const uint64_t a_frameNumber);
+	void FreeRetired(const uint64_t a_frameNumber, const bool a_all);
+
+	bool HasShortIndices(const ArenaMesh& a_mesh) const;
+	VkBuffer GetVertexBuffer(const ArenaMesh& a_mesh) const;
+	VkBuffer GetIndexBuffer(const ArenaMesh& a_mesh) const;
+	VkDeviceSize GetVertexOffset(const ArenaMesh& a_mesh) const;		// in bytes
+	VkDeviceSize GetIndexOffset(const ArenaMesh& a_mesh) const;
+	VkDeviceSize GetIndexBytes(const ArenaMesh& a_mesh) const;
+	// nullptr for staged pages
+	PackedVertex* GetMappedVertices(const ArenaMesh& a_mesh) const;
+	void* GetMappedIndices(const ArenaMesh& a_mesh) const;
+
+	// The chunk draws a_mesh from the next UpdateFrame on, a mesh it drew before is retired
+	void SetDraw(const glm::ivec3& a_coord, const ArenaMesh& a_mesh, const ChunkDrawData& a_drawData, const uint64_t a_frameNumber);
+	void RemoveDraw(const glm::ivec3& a_coord, const uint64_t a_frameNumber);
+	size_t GetDrawCount() const;
+	// Changes with every SetDraw and RemoveDraw, command buffers recorded with the draws of an older version are stale
+	uint64_t GetDrawsVersion() const;
+
+	// Culls the draws against a_viewProjection and writes the indirect commands and draw data of the visible ones for a_frame,
+	// the in flight fence of a_frame has to be waited for
+	void UpdateFrame(const uint32_t a_frame, const glm::mat4& a_viewProjection);
+	// Without a_multiDrawIndirect (multiDrawIndirect and drawIndirectFirstInstance) every chunk is drawn with vkCmdDrawIndexed
+	void RecordDraws(VkCommandBuffer a_commandBuffer, const uint32_t a_frame, const bool a_multiDrawIndirect) const;
+	// Commands the last UpdateFrame of a_frame wrote
+	uint32_t GetCommandCount(const uint32_t a_frame) const;
+	// Records the commands [a_firstCommand, a_endCommand) of a_frame. Takes no lock, so several threads can record ranges
+	// into command buffers of their own at once, valid between UpdateFrame and the next UpdateFrame of a_frame
+	void RecordDrawRange(VkCommandBuffer a_commandBuffer, const uint32_t a_frame, const bool a_multiDrawIndirect, const uint32_t a_firstCommand,
+		const uint32_t a_endCommand) const;
+	VkBuffer GetDrawDataBuffer(const uint32_t a_frame) const;
+
+	// Gpu culling: writes the ChunkCullRecords of a_frame if the draws changed since and fills the push constants of cull.comp,
+	// which then culls against the camera of the frame and writes its indirect commands and draw data. a_compact needs vkCmdDrawIndexedIndirectCountKHR
+	void UpdateFrameGpu(const uint32_t a_frame, const bool a_compact, ChunkCullPushConstants& a_pushConstants);
+	// One indirect draw per page over the commands cull.comp wrote, a_drawIndexedIndirectCount reads the draw count of the page 
+	// from the count buffer, without it every chunk of the page is drawn (culled ones with instanceCount 0)
+	void RecordDrawsGpuCulled(VkCommandBuffer a_commandBuffer, const uint32_t a_frame, PFN_vkCmdDrawIndexedIndirectCountKHR a_drawIndexedIndirectCount) const;
+	VkBuffer GetCullRecordBuffer(const uint32_t a_frame) const;
+	VkBuffer GetIndirectBuffer(const uint32_t a_frame) const;
+	VkBuffer GetCountBuffer(const uint32_t a_frame) const;		// one uint per page, cleared before cull.comp runs
+
+	void PrintStats() const;
+
+private:
+	struct Page
+	{
+		VkBuffer vertexBuffer = VK_NULL_HANDLE;
+		MemoryAllocation vertexMemory;
+		VkBuffer indexBuffer = VK_NULL_HANDLE;
+		MemoryAllocation indexMemory;
+		bool shortIndices = true;
+		std::map<uint32_t, uint32_t> freeVertices;		// offset -> count, neighbours are always merged
+		std::map<uint32_t, uint32_t> freeIndices;
+		uint32_t usedVertices = 0;
+		uint32_t usedIndices = 0;
+	};
+
+	struct Draw
+	{
+		glm::ivec3 coord;
+		ArenaMesh mesh;
+		ChunkDrawData drawData;
+	};
+
+	struct RetiredMesh
+	{
+		ArenaMesh mesh;
+		uint64_t frameNumber;
+	};
+
+	struct PageBinding
+	{
+		VkBuffer vertexBuffer;
+		VkBuffer indexBuffer;
+		VkIndexType indexType;
+	};
+
+	struct FrameDraws
+	{
+		VkBuffer indirectBuffer = VK_NULL_HANDLE;
+		MemoryAllocation indirectMemory;
+		VkBuffer drawDataBuffer = VK_NULL_HANDLE;
+		MemoryAllocation drawDataMemory;
+		std::vector<VkDrawIndexedIndirectCommand> commands;		// cpu copy for the vkCmdDrawIndexed fallback
+		std::vector<uint32_t> pageFirstCommand;					// one more entry than pages, the commands of page p end at p + 1
+		std::vector<PageBinding> pageBindings;					// copy of the page buffers for RecordDrawRange, m_pages may grow meanwhile
+		VkBuffer cullRecordBuffer = VK_NULL_HANDLE;				// gpu culling only from here on
+		MemoryAllocation cullRecordMemory;
+		VkBuffer countBuffer = VK_NULL_HANDLE;
+		MemoryAllocation countMemory;
+		uint64_t cullRecordVersion = 0;
+		uint32_t cullRecordCount = 0;
+	};
+
+	int CreatePage(const bool a_shortIndices);
+	void CreateBuffer(const VkDeviceSize a_size, const VkBufferUsageFlags a_usage, const VkMemoryPropertyFlags a_properties, const bool a_concurrent,
+		VkBuffer& a_buffer, MemoryAllocation& a_memory);
+	// Callers hold m_mutex
+	void FreeMesh(const ArenaMesh& a_mesh);
+
+	static bool AllocateRange(std::map<uint32_t, uint32_t>& a_freeRanges, const uint32_t a_count, uint32_t& a_offset);
+	static void FreeRange(std::map<uint32_t, uint32_t>& a_freeRanges, const uint32_t a_offset, const uint32_t a_count);
+
+	VkDevice m_logicalDevice = VK_NULL_HANDLE;
+	DeviceMemoryAllocator* m_pAllocator = nullptr;
+	UploadRing* m_pUploadRing = nullptr;
+	std::vector<uint32_t> m_queueFamilies;
+	bool m_directWrite = false;
+
+	std::vector<Page> m_pages;
+	std::vector<RetiredMesh> m_retiredMeshes;
+	std::vector<Draw> m_draws;			// dense, draw i is box i of m_culler
+	std::unordered_map<glm::ivec3, uint32_t, ChunkCoordHash> m_drawIndices;
+	FrustumCuller m_culler;
+	std::vector<uint32_t> m_visibleDraws;
+	std::vector<uint32_t> m_pageDrawCounts;
+	uint64_t m_drawsVersion = 1;		// bumped with every change of m_draws, the cull records of older frames are rewritten
+	std::vector<FrameDraws> m_frames;
+
+	mutable std::mutex m_mutex;
+};
+#endif // !CHUNK_MESH_ARENA_H
@@ -0,0 +1,315 @@
+#include "ChunkMesher.h"
+#include <algorithm>
+
+static glm::ivec3 CellFromIndex(const int a_index)
+{
+	return glm::ivec3(a_index % CHUNK_SIZE, (a_index / CHUNK_SIZE) % CHUNK_SIZE, a_index / CHUNK_AREA);
+}
+
+//corner sides of the 8 cube vertices in the order of Voxel::GetVertices
+static const glm::ivec3 CUBE_CORNER_SIDES[VERTEX_COUNT_PER_VOXEL] = 
+{
+	{ 1, 1, 1 }, { 0, 1, 1 }, { 0, 0, 1 }, { 1, 0, 1 },
+	{ 1, 1, 0 }, { 0, 1, 0 }, { 0, 0, 0 }, { 1, 0, 0 }
+};
+
+template<typename Output>
+void ChunkMesher::MeshChunk(const VoxelWorld& a_world, const VoxelChunk& a_chunk, const MeshingMode a_mode, Output& a_output)
+{
+	switch (a_mode)
+	{
+	case MeshingMode::NAIVE:
+		MeshChunkNaive(a_world, a_chunk, a_output);
+		break;
+	case MeshingMode::CULLED:
+		MeshChunkCulled(a_world, a_chunk, a_output);
+		break;
+	case MeshingMode::GREEDY:
+		MeshChunkGreedy(a_world, a_chunk, a_output);
+		break;
+	default:
+		break;
+	}
+}
+
+void ChunkMesher::MeshChunk(const VoxelWorld& a_world, const VoxelChunk& a_chunk, const MeshingMode a_mode, std::vector<Vertex>& a_vertices, std::vector<uint32_t>& a_indices)
+{
+	VectorMeshOutput<Vertex> output(a_vertices, a_indices);
+	MeshChunk(a_world, a_chunk, a_mode, output);
+}
+
+void ChunkMesher::MeshChunk(const VoxelWorld& a_world, const VoxelChunk& a_chunk, const MeshingMode a_mode, std::vector<PackedVertex>& a_vertices, std::vector<uint32_t>& a_indices)
+{
+	VectorMeshOutput<PackedVertex> output(a_vertices, a_indices);
+	MeshChunk(a_world, a_chunk, a_mode, output);
+}
+
+template<typename Output>
+void ChunkMesher::MeshChunkNaive(const VoxelWorld& a_world, const VoxelChunk& a_chunk, Output& a_output)
+{
+	float voxelSize = a_world.GetVoxelSize();
+	const std::vector<uint32_t>& materials = a_chunk.GetMaterials();
+	std::vector<uint32_t> indices = Voxel::GetIndices();
+
+	for (int i = 0; i < CHUNK_VOLUME; i++) 
+	{
+		if (materials[i] == EMPTY_MATERIAL) 
+		{
+			continue;
+		}
+
+		uint32_t vertexOffset = a_output.VertexCount();
+
+		glm::ivec3 local = CellFromIndex(i);
+
+		for (int j = 0; j < VERTEX_COUNT_PER_VOXEL; j++) {
+			a_output.AddVertex(a_chunk, voxelSize, local, CUBE_CORNER_SIDES[j], PACKED_SHARED_FACE, materials[i]);
+		}
+		for (int k = 0; k < INDICES_COUNT_PER_VOXEL; k++) {
+			a_output.AddIndex(indices[k] + vertexOffset);
+		}
+	}
+}
+
+template<typename Output>
+void ChunkMesher::MeshChunkCulled(const VoxelWorld& a_world, const VoxelChunk& a_chunk, Output& a_output)
+{
+	float voxelSize = a_world.GetVoxelSize();
+	const std::vector<uint32_t>& materials = a_chunk.GetMaterials();
+
+	for (int i = 0; i < CHUNK_VOLUME; i++)
+	{
+		if (materials[i] == EMPTY_MATERIAL)
+		{
+			continue;
+		}
+
+		glm::ivec3 local = CellFromIndex(i);
+
+		for (int face = 0; face < FACE_COUNT; face++)
+		{
+			if (IsFaceVisible(a_world, a_chunk, local, face))
+			{
+				AddQuad(a_chunk, voxelSize, face, local, local, materials[i], a_output);
+			}
+		}
+	}
+}
+
+template<typename Output>
+void ChunkMesher::MeshChunkGreedy(const VoxelWorld& a_world, const VoxelChunk& a_chunk, Output& a_output)
+{
+	//merging only closes gaps if the voxels fill their cells
+	if (a_world.GetVoxelSize() < 0.5f)
+	{
+		MeshChunkCulled(a_world, a_chunk, a_output);
+		return;
+	}
+
+	float voxelSize = a_world.GetVoxelSize();
+	std::vector<uint32_t> mask(CHUNK_AREA);
+
+	for (int face = 0; face < FACE_COUNT; face++)
+	{
+		int axis = face / 2;
+		int u = (axis + 1) % 3;
+		int v = (axis + 2) % 3;
+
+		for (int slice = 0; slice < CHUNK_SIZE; slice++)
+		{
+			//collect the material of every visible face in this slice, quads never leave the chunk 
+			//so the visibility test at the border decides everything the neighbour chunk contributes
+			bool sliceHasFaces = false;
+
+			for (int j = 0; j < CHUNK_SIZE; j++)
+			{
+				for (int i = 0; i < CHUNK_SIZE; i++)
+				{
+					glm::ivec3 local;
+					local[axis] = slice;
+					local[u] = i;
+					local[v] = j;
+
+					uint32_t material = a_chunk.GetMaterial(local.x, local.y, local.z);
+					if (material != EMPTY_MATERIAL && !IsFaceVisible(a_world, a_chunk, local, face))
+					{
+						material = EMPTY_MATERIAL;
+					}
+
+					mask[i + j * CHUNK_SIZE] = material;
+					sliceHasFaces |= material != EMPTY_MATERIAL;
+				}
+			}
+
+			if (!sliceHasFaces)
+			{
+				continue;
+			}
+
+			for (int j = 0; j < CHUNK_SIZE; j++)
+			{
+				for (int i = 0; i < CHUNK_SIZE; )
+				{
+					uint32_t material = mask[i + j * CHUNK_SIZE];
+					if (material == EMPTY_MATERIAL)
+					{
+						i++;
+						continue;
+					}
+
+					int width = 1;
+					while (i + width < CHUNK_SIZE && mask[i + width + j * CHUNK_SIZE] == material)
+					{
+						width++;
+					}
+
+					int height = 1;
+					bool rowMatches = true;
+					while (j + height < CHUNK_SIZE && rowMatches)
+					{
+						for (int k = 0; k < width; k++)
+						{
+							if (mask[i + k + (j + height) * CHUNK_SIZE] != material)
+							{
+								rowMatches = false;
+								break;
+							}
+						}
+						if (rowMatches)
+						{
+							height++;
+						}
+					}
+
+					for (int h = 0; h < height; h++)
+					{
+						std::fill_n(mask.begin() + i + (j + h) * CHUNK_SIZE, width, EMPTY_MATERIAL);
+					}
+
+					glm::ivec3 firstCell;
+					firstCell[axis] = slice;
+					firstCell[u] = i;
+					firstCell[v] = j;
+
+					glm::ivec3 lastCell = firstCell;
+					lastCell[u] += width - 1;
+					lastCell[v] += height - 1;
+
+					AddQuad(a_chunk, voxelSize, face, firstCell, lastCell, material, a_output);
+
+					i += width;
+				}
+			}
+		}
+	}
+}
+
+const char* ChunkMesher::GetModeName(const MeshingMode a_mode)
+{
+	switch (a_mode)
+	{
+	case MeshingMode::NAIVE:
+		return "Naive";
+	case MeshingMode::CULLED:
+		return "Culled";
+	case MeshingMode::GREEDY:
+		return "Greedy";
+	default:
+		return "Unknown";
+	}
+}
+
+glm::ivec3 ChunkMesher::GetFaceNormal(const int a_face)
+{
+	glm::ivec3 normal = glm::ivec3(0, 0, 0);
+	normal[a_face / 2] = (a_face % 2 == 0) ? 1 : -1;
+	return normal;
+}
+
+bool ChunkMesher::IsFaceVisible(const VoxelWorld& a_world, const VoxelChunk& a_chunk, const glm::ivec3& a_local, const int a_face)
+{
+	//voxels smaller than their cell never touch, so every face stays visible
+	if (a_world.GetVoxelSize() < 0.5f)
+	{
+		return true;
+	}
+
+	glm::ivec3 neighbour = a_local + GetFaceNormal(a_face);
+
+	if (neighbour.x >= 0 && neighbour.x < CHUNK_SIZE && 
+		neighbour.y >= 0 && neighbour.y < CHUNK_SIZE && 
+		neighbour.z >= 0 && neighbour.z < CHUNK_SIZE)
+	{
+		return !a_chunk.IsSolid(neighbour.x, neighbour.y, neighbour.z);
+	}
+
+	return !a_world.IsSolid(a_chunk.GetOrigin() + neighbour);
+}
+
+template<typename Output>
+void ChunkMesher::AddQuad(const VoxelChunk& a_chunk, const float a_voxelSize, const int a_face, const glm::ivec3& a_firstCell, const glm::ivec3& a_lastCell, 
+	const uint32_t a_material, Output& a_output)
+{
+	//corners run counter clockwise around the outward normal, like the faces of Voxel::GetIndices
+	int axis = a_face / 2;
+	int u = (axis + 1) % 3;
+	int v = (axis + 2) % 3;
+	bool positive = a_face % 2 == 0;
+
+	glm::ivec2 corners[VERTEX_COUNT_PER_FACE] = { {0, 0}, {1, 0}, {1, 1}, {0, 1} };
+	if (!positive)
+	{
+		std::swap(corners[1], corners[3]);
+	}
+
+	uint32_t vertexOffset = a_output.VertexCount();
+
+	for (int c = 0; c < VERTEX_COUNT_PER_FACE; c++)
+	{
+		//the quad spans from the negative side of the first cell to the positive side of the last cell
+		glm::ivec3 side;
+		side[axis] = positive ? 1 : 0;
+		side[u] = corners[c].x;
+		side[v] = corners[c].y;
+
+		glm::ivec3 cell;
+		cell[axis] = a_firstCell[axis];
+		cell[u] = side[u] ? a_lastCell[u] : a_firstCell[u];
+		cell[v] = side[v] ? a_lastCell[v] : a_firstCell[v];
+
+		a_output.AddVertex(a_chunk, a_voxelSize, cell, side, a_face, a_material);
+	}
+
+	a_output.AddIndex(vertexOffset + 0);
+	a_output.AddIndex(vertexOffset + 1);
+	a_output.AddIndex(vertexOffset + 2);
+	a_output.AddIndex(vertexOffset + 2);
+	a_output.AddIndex(vertexOffset + 3);
+	a_output.AddIndex(vertexOffset + 0);
+}
+
+void ChunkMesher::MakeVertex(const VoxelChunk& a_chunk, const float a_voxelSize, const glm::ivec3& a_cell, const glm::ivec3& a_side, 
+	const int a_face, const uint32_t a_material, Vertex& a_vertex)
+{
+	a_vertex.pos = glm::vec3(a_chunk.GetOrigin() + a_cell) + (glm::vec3(a_side) * 2.0f - 1.0f) * a_voxelSize;
+	a_vertex.color = VoxelWorld::UnpackColor(a_material);
+}
+
+void ChunkMesher::MakeVertex(const VoxelChunk& a_chunk, const float a_voxelSize, const glm::ivec3& a_cell, const glm::ivec3& a_side, 
+	const int a_face, const uint32_t a_material, PackedVertex& a_vertex)
+{
+	a_vertex.cell[0] = static_cast<uint8_t>(a_cell.x);
+	a_vertex.cell[1] = static_cast<uint8_t>(a_cell.y);
+	a_vertex.cell[2] = static_cast<uint8_t>(a_cell.z);
+	a_vertex.bits = static_cast<uint8_t>(a_side.x | (a_side.y << 1) | (a_side.z << 2) | (a_face << 3));
+	a_vertex.color = a_material;
+}
+
+//every output the engine meshes into
+template void ChunkMesher::MeshChunk<CountMeshOutput>(const VoxelWorld&, const VoxelChunk&, const MeshingMode, CountMeshOutput&);
+template void ChunkMesher::MeshChunk<VectorMeshOutput<Vertex>>(const VoxelWorld&, const VoxelChunk&, const MeshingMode, VectorMeshOutput<Vertex>&);
+template void ChunkMesher::MeshChunk<VectorMeshOutput<PackedVertex>>(const VoxelWorld&, const VoxelChunk&, const MeshingMode, VectorMeshOutput<PackedVertex>&);
+template void ChunkMesher::MeshChunk<MappedMeshOutput<Vertex>>(const VoxelWorld&, const VoxelChunk&, const MeshingMode, MappedMeshOutput<Vertex>&);
+template void ChunkMesher::MeshChunk<MappedMeshOutput<PackedVertex>>(const VoxelWorld&, const VoxelChunk&, const MeshingMode, MappedMeshOutput<PackedVertex>&);
+template void ChunkMesher::MeshChunk<MappedMeshOutput<PackedVertex, uint16_t>>(const VoxelWorld&, const VoxelChunk&, const MeshingMode, 
+	MappedMeshOutput<PackedVertex, uint16_t>&);
@@ -0,0 +1,110 @@
+#ifndef CHUNK_MESHER_H
+#define CHUNK_MESHER_H
+
+#include <glm/glm.hpp>
+#include <vector>
+#include <cstdint>
+#include "MyStructs.h"
+#include "VoxelWorld.h"
+
+const int FACE_COUNT = 6;
+const int VERTEX_COUNT_PER_FACE = 4;
+const int INDICES_COUNT_PER_FACE = 6;
+
+enum class MeshingMode
+{
+	NAIVE,		// 8 vertices and 36 indices for every voxel
+	CULLED,		// only faces bordering empty space, 4 vertices per face
+	GREEDY		// visible coplanar faces of the same colour merged into maximal rectangles
+};
+
+// Meshes one chunk either into world space Vertex data or into chunk local PackedVertex data
+// The Output decides where the data goes, see CountMeshOutput, VectorMeshOutput and MappedMeshOutput below
+class ChunkMesher
+{
+public:
+	template<typename Output>
+	static void MeshChunk(const VoxelWorld& a_world, const VoxelChunk& a_chunk, const MeshingMode a_mode, Output& a_output);
+
+	static void MeshChunk(const VoxelWorld& a_world, const VoxelChunk& a_chunk, const MeshingMode a_mode, 
+		std::vector<Vertex>& a_vertices, std::vector<uint32_t>& a_indices);
+	static void MeshChunk(const VoxelWorld& a_world, const VoxelChunk& a_chunk, const MeshingMode a_mode, 
+		std::vector<PackedVertex>& a_vertices, std::vector<uint32_t>& a_indices);
+
+	static const char* GetModeName(const MeshingMode a_mode);
+
+	// Face order: +X, -X, +Y, -Y, +Z, -Z
+	static glm::ivec3 GetFaceNormal(const int a_face);
+	static bool IsFaceVisible(const VoxelWorld& a_world, const VoxelChunk& a_chunk, const glm::ivec3& a_local, const int a_face);
+
+	// The meshers only know chunk local cells and corner sides, MakeVertex turns them into the vertex format
+	static void MakeVertex(const VoxelChunk& a_chunk, const float a_voxelSize, const glm::ivec3& a_cell, const glm::ivec3& a_side, 
+		const int a_face, const uint32_t a_material, Vertex& a_vertex);
+	static void MakeVertex(const VoxelChunk& a_chunk, const float a_voxelSize, const glm::ivec3& a_cell, const glm::ivec3& a_side, 
+		const int a_face, const uint32_t a_material, PackedVertex& a_vertex);
+
+private:
+	template<typename Output>
+	static void MeshChunkNaive(const VoxelWorld& a_world, const VoxelChunk& a_chunk, Output& a_output);
+	template<typename Output>
+	static void MeshChunkCulled(const VoxelWorld& a_world, const VoxelChunk& a_chunk, Output& a_output);
+	template<typename Output>
+	static void MeshChunkGreedy(const VoxelWorld& a_world, const VoxelChunk& a_chunk, Output& a_output);
+
+	template<typename Output>
+	static void AddQuad(const VoxelChunk& a_chunk, const float a_voxelSize, const int a_face, const glm::ivec3& a_firstCell, const glm::ivec3& a_lastCell, 
+		const uint32_t a_material, Output& a_output);
+};
+
+// Only counts, used for the first pass of the two pass meshing
+struct CountMeshOutput
+{
+	uint32_t vertexCount = 0;
+	uint32_t indexCount = 0;
+
+	uint32_t VertexCount() const { return vertexCount; }
+	void AddVertex(const VoxelChunk&, const float, const glm::ivec3&, const glm::ivec3&, const int, const uint32_t) { vertexCount++; }
+	void AddIndex(const uint32_t) { indexCount++; }
+};
+
+// Appends to std::vectors, indices count from the start of the vertex vector
+template<typename VertexType>
+struct VectorMeshOutput
+{
+	std::vector<VertexType>& vertices;
+	std::vector<uint32_t>& indices;
+
+	VectorMeshOutput(std::vector<VertexType>& a_vertices, std::vector<uint32_t>& a_indices) : vertices(a_vertices), indices(a_indices) {}
+
+	uint32_t VertexCount() const { return static_cast<uint32_t>(vertices.size()); }
+
+	void AddVertex(const VoxelChunk& a_chunk, const float a_voxelSize, const glm::ivec3& a_cell, const glm::ivec3& a_side, const int a_face, const uint32_t a_material) 
+	{
+		vertices.emplace_back();
+		ChunkMesher::MakeVertex(a_chunk, a_voxelSize, a_cell, a_side, a_face, a_material, vertices.back());
+	}
+
+	void AddIndex(const uint32_t a_index) { indices.push_back(a_index); }
+};
+
+// Writes to preallocated memory (e.g. a mapped staging buffer) that a CountMeshOutput pass sized.
+// Indices start at baseVertex, 0 gives chunk local indices which fit 16 bit for chunks below 65536 vertices
+template<typename VertexType, typename IndexType = uint32_t>
+struct MappedMeshOutput
+{
+	VertexType* vertices = nullptr;
+	IndexType* indices = nullptr;
+	uint32_t baseVertex = 0;
+	uint32_t vertexCount = 0;
+	uint32_t indexCount = 0;
+
+	uint32_t VertexCount() const { return baseVertex + vertexCount; }
+
+	void AddVertex(const VoxelChunk& a_chunk, const float a_voxelSize, const glm::ivec3& a_cell, const glm::ivec3& a_side, const int a_face, const uint32_t a_material) 
+	{
+		ChunkMesher::MakeVertex(a_chunk, a_voxelSize, a_cell, a_side, a_face, a_material, vertices[vertexCount++]);
+	}
+
+	void AddIndex(const uint32_t a_index) { indices[indexCount++] = static_cast<IndexType>(a_index); }
+};
+#endif // !CHUNK_MESHER_H
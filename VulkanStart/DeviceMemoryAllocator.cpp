@@ -0,0 +1,494 @@
+#include "DeviceMemoryAllocator.h"
+
+#include <iostream>
+#include <stdexcept>
+#include <algorithm>
+#include <iterator>
+
+void DeviceMemoryAllocator::Init(VkPhysicalDevice a_physicalDevice, VkDevice a_logicalDevice)
+{
+	m_physicalDevice = a_physicalDevice;
+	m_logicalDevice = a_logicalDevice;
+
+	vkGetPhysicalDeviceMemoryProperties(m_physicalDevice, &m_memoryProperties);
+
+	std::cout << "" << std::endl;
+	std::cout << "Memory Type Count: " << m_memoryProperties.memoryTypeCount << std::endl;
+	std::cout << "Memory Heap Count: " << m_memoryProperties.memoryHeapCount << std::endl;
+
+	VkDeviceSize directWriteHeapSize = 0;
+	for (uint32_t i = 0; i < m_memoryProperties.memoryTypeCount; i++) {
+		const VkMemoryType& type = m_memoryProperties.memoryTypes[i];
+		VkDeviceSize heapSize = m_memoryProperties.memoryHeaps[type.heapIndex].size;
+
+		if ((type.propertyFlags & DIRECT_WRITE_MEMORY_PROPERTIES) == DIRECT_WRITE_MEMORY_PROPERTIES && heapSize >= DIRECT_WRITE_MIN_HEAP_SIZE 
+			&& heapSize > directWriteHeapSize)
+		{
+			m_directWriteMemoryType = static_cast<int>(i);
+			directWriteHeapSize = heapSize;
+		}
+	}
+
+	if (m_directWriteMemoryType >= 0)
+	{
+		std::cout << "Device local host visible memory: type " << m_directWriteMemoryType << " on a " << directWriteHeapSize / (1024 * 1024) 
+			<< " MB heap, buffers can be written directly" << std::endl;
+	}
+	else 
+	{
+		std::cout << "No big enough device local host visible memory, buffers are uploaded through staging" << std::endl;
+	}
+}
+
+void DeviceMemoryAllocator::Destroy()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	//freeing memory unmaps it as well
+	for (MemoryBlock& block : m_blocks) {
+		vkFreeMemory(m_logicalDevice, block.memory, nullptr);
+	}
+
+	for (StagingRing& ring : m_rings) {
+		vkFreeMemory(m_logicalDevice, ring.memory, nullptr);
+	}
+
+	if (m_dedicatedCount > 0)
+	{
+		std::cout << "" << std::endl;
+		std::cout << "Fail: " << m_dedicatedCount << " dedicated allocations were not freed before the allocator" << std::endl;
+	}
+
+	m_blocks.clear();
+	m_rings.clear();
+}
+
+MemoryAllocation DeviceMemoryAllocator::Allocate(const VkMemoryRequirements& a_requirements, const VkMemoryPropertyFlags a_properties,
+	const AllocationKind a_kind, const AllocationLifetime a_lifetime)
+{
+	uint32_t memoryType = FindMemoryType(a_requirements.memoryTypeBits, a_properties);
+
+	MemoryAllocation allocation;
+	allocation.size = a_requirements.size;
+	allocation.lifetime = a_lifetime;
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	if (a_lifetime == AllocationLifetime::TRANSIENT && a_kind == AllocationKind::BUFFER)
+	{
+		int ringIndex = -1;
+		for (size_t i = 0; i < m_rings.size(); i++) {
+			if (m_rings[i].memoryType == memoryType)
+			{
+				ringIndex = static_cast<int>(i);
+			}
+		}
+
+		if (ringIndex < 0)
+		{
+			StagingRing ring;
+			ring.memoryType = memoryType;
+			ring.memory = AllocateDeviceMemory(STAGING_RING_SIZE, memoryType, &ring.mapped);
+			m_rings.emplace_back(ring);
+			ringIndex = static_cast<int>(m_rings.size() - 1);
+
+			std::cout << "" << std::endl;
+			std::cout << "Success: allocated " << STAGING_RING_SIZE / (1024 * 1024) << " MB staging ring (memory type " << memoryType << ")" << std::endl;
+		}
+
+		StagingRing& ring = m_rings[ringIndex];
+
+		if (AllocateFromRing(ring, a_requirements, allocation.offset))
+		{
+			allocation.memory = ring.memory;
+			allocation.mapped = ring.mapped ? static_cast<char*>(ring.mapped) + allocation.offset : nullptr;
+			allocation.pool = ringIndex;
+			return allocation;
+		}
+
+		//the ring is full or the request too big, it still works as a dedicated allocation
+		ring.overflowCount++;
+	}
+	else if (a_requirements.size <= MEMORY_BLOCK_SIZE / 2)
+	{
+		allocation.lifetime = AllocationLifetime::PERSISTENT;
+
+		for (size_t i = 0; i < m_blocks.size(); i++) {
+			MemoryBlock& block = m_blocks[i];
+			if (block.memory == VK_NULL_HANDLE || block.memoryType != memoryType || block.kind != a_kind)
+			{
+				continue;
+			}
+
+			if (AllocateFromBlock(block, a_requirements, allocation.offset))
+			{
+				allocation.memory = block.memory;
+				allocation.mapped = block.mapped ? static_cast<char*>(block.mapped) + allocation.offset : nullptr;
+				allocation.pool = static_cast<int>(i);
+				return allocation;
+			}
+		}
+
+		//reuse the slot of a released block, allocations hold the index
+		size_t blockIndex = 0;
+		while (blockIndex < m_blocks.size() && m_blocks[blockIndex].memory != VK_NULL_HANDLE)
+		{
+			blockIndex++;
+		}
+
+		if (blockIndex == m_blocks.size())
+		{
+			m_blocks.emplace_back();
+		}
+
+		MemoryBlock& block = m_blocks[blockIndex];
+		block.memoryType = memoryType;
+		block.kind = a_kind;
+		block.memory = AllocateDeviceMemory(MEMORY_BLOCK_SIZE, memoryType, &block.mapped);
+		block.freeRanges[0] = MEMORY_BLOCK_SIZE;
+
+		std::cout << "" << std::endl;
+		std::cout << "Success: allocated " << MEMORY_BLOCK_SIZE / (1024 * 1024) << " MB memory block " << blockIndex
+			<< " (memory type " << memoryType << ", " << (a_kind == AllocationKind::IMAGE ? "images" : "buffers") << ")" << std::endl;
+
+		AllocateFromBlock(block, a_requirements, allocation.offset);
+
+		allocation.memory = block.memory;
+		allocation.mapped = block.mapped ? static_cast<char*>(block.mapped) + allocation.offset : nullptr;
+		allocation.pool = static_cast<int>(blockIndex);
+		return allocation;
+	}
+
+	allocation.lifetime = AllocationLifetime::PERSISTENT;
+	allocation.offset = 0;
+	allocation.pool = -1;
+	allocation.memory = AllocateDeviceMemory(a_requirements.size, memoryType, &allocation.mapped);
+
+	m_dedicatedCount++;
+	m_dedicatedBytes += a_requirements.size;
+
+	return allocation;
+}
+
+void DeviceMemoryAllocator::Free(MemoryAllocation& a_allocation)
+{
+	if (a_allocation.memory == VK_NULL_HANDLE)
+	{
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		if (a_allocation.pool < 0)
+		{
+			vkFreeMemory(m_logicalDevice, a_allocation.memory, nullptr);
+
+			m_dedicatedCount--;
+			m_dedicatedBytes -= a_allocation.size;
+		}
+		else if (a_allocation.lifetime == AllocationLifetime::TRANSIENT)
+		{
+			FreeFromRing(m_rings[a_allocation.pool], a_allocation.offset);
+		}
+		else
+		{
+			FreeFromBlock(m_blocks[a_allocation.pool], a_allocation.offset, a_allocation.size);
+			ReleaseSpareBlock(m_blocks[a_allocation.pool]);
+		}
+	}
+
+	a_allocation = MemoryAllocation();
+}
+
+uint32_t DeviceMemoryAllocator::FindMemoryType(const uint32_t a_typeFilter, const VkMemoryPropertyFlags a_properties) const
+{
+	//the first match could be the small BAR window
+	if (a_properties == DIRECT_WRITE_MEMORY_PROPERTIES && m_directWriteMemoryType >= 0 && (a_typeFilter & (1 << m_directWriteMemoryType)))
+	{
+		return static_cast<uint32_t>(m_directWriteMemoryType);
+	}
+
+	for (uint32_t i = 0; i < m_memoryProperties.memoryTypeCount; i++) {
+		if (a_typeFilter & (1 << i) && (m_memoryProperties.memoryTypes[i].propertyFlags & a_properties) == a_properties) {
+			return i;
+		}
+	}
+
+	throw std::runtime_error("failed to find suitable memory type!");
+}
+
+bool DeviceMemoryAllocator::HasDirectWriteMemory() const
+{
+	return m_directWriteMemoryType >= 0;
+}
+
+MemoryStats DeviceMemoryAllocator::GetStats() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	MemoryStats stats;
+	stats.dedicatedCount = m_dedicatedCount;
+	stats.allocationCount = m_dedicatedCount;
+	stats.reservedBytes = STAGING_RING_SIZE * m_rings.size() + m_dedicatedBytes;
+	stats.usedBytes = m_dedicatedBytes;
+
+	VkDeviceSize largestFreeRangeSum = 0;
+
+	for (const MemoryBlock& block : m_blocks) {
+		if (block.memory == VK_NULL_HANDLE)
+		{
+			continue;
+		}
+
+		stats.blockCount++;
+		stats.reservedBytes += MEMORY_BLOCK_SIZE;
+		stats.allocationCount += block.allocationCount;
+		stats.usedBytes += block.usedBytes;
+		stats.freeRangeCount += static_cast<uint32_t>(block.freeRanges.size());
+
+		VkDeviceSize largestFreeRange = 0;
+		for (const auto& range : block.freeRanges) {
+			stats.freeBytes += range.second;
+			largestFreeRange = std::max(largestFreeRange, range.second);
+		}
+
+		largestFreeRangeSum += largestFreeRange;
+		stats.largestFreeRange = std::max(stats.largestFreeRange, largestFreeRange);
+	}
+
+	stats.deviceAllocationCount = stats.blockCount + static_cast<uint32_t>(m_rings.size()) + m_dedicatedCount;
+
+	for (const StagingRing& ring : m_rings) {
+		stats.allocationCount += static_cast<uint32_t>(ring.entries.size());
+		stats.usedBytes += ring.usedBytes;
+	}
+
+	if (stats.freeBytes > 0)
+	{
+		stats.fragmentation = 1.0f - static_cast<float>(largestFreeRangeSum) / static_cast<float>(stats.freeBytes);
+	}
+
+	return stats;
+}
+
+void DeviceMemoryAllocator::PrintStats() const
+{
+	MemoryStats stats = GetStats();
+	const float mb = 1024.0f * 1024.0f;
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	std::cout << "" << std::endl;
+	std::cout << "Device memory: " << stats.allocationCount << " allocations in " << stats.deviceAllocationCount << " vkAllocateMemory blocks ("
+		<< stats.blockCount << " shared, " << m_rings.size() << " staging rings, " << stats.dedicatedCount << " dedicated), "
+		<< stats.usedBytes / mb << " of " << stats.reservedBytes / mb << " MB used, fragmentation " << stats.fragmentation * 100.0f << " %" << std::endl;
+
+	for (size_t i = 0; i < m_blocks.size(); i++) {
+		const MemoryBlock& block = m_blocks[i];
+		if (block.memory == VK_NULL_HANDLE)
+		{
+			continue;
+		}
+
+		VkDeviceSize largestFreeRange = 0;
+		for (const auto& range : block.freeRanges) {
+			largestFreeRange = std::max(largestFreeRange, range.second);
+		}
+
+		std::cout << "  block " << i << " (memory type " << block.memoryType << ", " << (block.kind == AllocationKind::IMAGE ? "images" : "buffers") << "): "
+			<< block.allocationCount << " allocations, " << block.usedBytes / mb << " MB used, " << block.freeRanges.size() << " free ranges, largest "
+			<< largestFreeRange / mb << " MB" << std::endl;
+	}
+
+	for (const StagingRing& ring : m_rings) {
+		std::cout << "  staging ring (memory type " << ring.memoryType << "): " << ring.entries.size() << " allocations, " << ring.usedBytes / mb
+			<< " MB used, peak " << ring.peakBytes / mb << " MB, " << ring.overflowCount << " went dedicated" << std::endl;
+	}
+
+	if (m_dedicatedCount > 0)
+	{
+		std::cout << "  dedicated: " << m_dedicatedCount << " allocations, " << m_dedicatedBytes / mb << " MB" << std::endl;
+	}
+}
+
+VkDeviceMemory DeviceMemoryAllocator::AllocateDeviceMemory(const VkDeviceSize a_size, const uint32_t a_memoryType, void** a_mapped)
+{
+	VkMemoryAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	allocInfo.allocationSize = a_size;
+	allocInfo.memoryTypeIndex = a_memoryType;
+
+	VkDeviceMemory memory;
+	if (vkAllocateMemory(m_logicalDevice, &allocInfo, nullptr, &memory) != VK_SUCCESS) {
+		throw std::runtime_error("failed to allocate device memory!");
+	}
+
+	//host visible memory is mapped once for its whole life, a memory object can not be mapped twice
+	*a_mapped = nullptr;
+	if (m_memoryProperties.memoryTypes[a_memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+	{
+		vkMapMemory(m_logicalDevice, memory, 0, a_size, 0, a_mapped);
+	}
+
+	return memory;
+}
+
+bool DeviceMemoryAllocator::AllocateFromBlock(MemoryBlock& a_block, const VkMemoryRequirements& a_requirements, VkDeviceSize& a_offset)
+{
+	for (auto it = a_block.freeRanges.begin(); it != a_block.freeRanges.end(); ++it) {
+		VkDeviceSize rangeOffset = it->first;
+		VkDeviceSize rangeSize = it->second;
+		VkDeviceSize offset = AlignUp(rangeOffset, a_requirements.alignment);
+
+		if (offset + a_requirements.size > rangeOffset + rangeSize)
+		{
+			continue;
+		}
+
+		//the alignment padding in front and the rest behind stay free
+		a_block.freeRanges.erase(it);
+
+		if (offset > rangeOffset)
+		{
+			a_block.freeRanges[rangeOffset] = offset - rangeOffset;
+		}
+
+		VkDeviceSize end = offset + a_requirements.size;
+		if (end < rangeOffset + rangeSize)
+		{
+			a_block.freeRanges[end] = rangeOffset + rangeSize - end;
+		}
+
+		a_block.usedBytes += a_requirements.size;
+		a_block.allocationCount++;
+
+		a_offset = offset;
+		return true;
+	}
+
+	return false;
+}
+
+void DeviceMemoryAllocator::FreeFromBlock(MemoryBlock& a_block, const VkDeviceSize a_offset, const VkDeviceSize a_size)
+{
+	a_block.usedBytes -= a_size;
+	a_block.allocationCount--;
+
+	VkDeviceSize offset = a_offset;
+	VkDeviceSize size = a_size;
+
+	//merge with the free neighbours on both sides
+	auto next = a_block.freeRanges.lower_bound(offset);
+
+	if (next != a_block.freeRanges.begin())
+	{
+		auto previous = std::prev(next);
+		if (previous->first + previous->second == offset)
+		{
+			offset = previous->first;
+			size += previous->second;
+			a_block.freeRanges.erase(previous);
+		}
+	}
+
+	if (next != a_block.freeRanges.end() && a_offset + a_size == next->first)
+	{
+		size += next->second;
+		a_block.freeRanges.erase(next);
+	}
+
+	a_block.freeRanges[offset] = size;
+}
+
+void DeviceMemoryAllocator::ReleaseSpareBlock(MemoryBlock& a_block)
+{
+	if (a_block.allocationCount > 0)
+	{
+		return;
+	}
+
+	//one empty block per memory type and kind is kept, so a rebuild that frees and allocates everything does not churn blocks
+	for (const MemoryBlock& block : m_blocks) {
+		if (&block != &a_block && block.memory != VK_NULL_HANDLE && block.allocationCount == 0 && block.memoryType == a_block.memoryType && block.kind == a_block.kind)
+		{
+			vkFreeMemory(m_logicalDevice, a_block.memory, nullptr);
+
+			a_block.memory = VK_NULL_HANDLE;
+			a_block.mapped = nullptr;
+			a_block.freeRanges.clear();
+			a_block.usedBytes = 0;
+			return;
+		}
+	}
+}
+
+bool DeviceMemoryAllocator::AllocateFromRing(StagingRing& a_ring, const VkMemoryRequirements& a_requirements, VkDeviceSize& a_offset)
+{
+	VkDeviceSize size = a_requirements.size;
+	VkDeviceSize offset = 0;
+
+	if (size > STAGING_RING_SIZE / 2)
+	{
+		return false;
+	}
+
+	if (!a_ring.entries.empty())
+	{
+		const RingEntry& oldest = a_ring.entries.front();
+		const RingEntry& newest = a_ring.entries.back();
+		offset = AlignUp(newest.offset + newest.size, a_requirements.alignment);
+
+		if (newest.offset >= oldest.offset)
+		{
+			//not wrapped, use the end of the ring or wrap around to the start
+			if (offset + size > STAGING_RING_SIZE)
+			{
+				offset = 0;
+				if (size > oldest.offset)
+				{
+					return false;
+				}
+			}
+		}
+		else if (offset + size > oldest.offset)
+		{
+			return false;
+		}
+	}
+
+	a_ring.entries.push_back({ offset, size, false });
+	a_ring.usedBytes += size;
+	a_ring.peakBytes = std::max(a_ring.peakBytes, a_ring.usedBytes);
+
+	a_offset = offset;
+	return true;
+}
+
+void DeviceMemoryAllocator::FreeFromRing(StagingRing& a_ring, const VkDeviceSize a_offset)
+{
+	for (RingEntry& entry : a_ring.entries) {
+		if (entry.offset == a_offset && !entry.freed)
+		{
+			entry.freed = true;
+			a_ring.usedBytes -= entry.size;
+			break;
+		}
+	}
+
+	//space only comes back once everything allocated before it is freed too
+	while (!a_ring.entries.empty() && a_ring.entries.front().freed)
+	{
+		a_ring.entries.pop_front();
+	}
+}
+
+VkDeviceSize DeviceMemoryAllocator::AlignUp(const VkDeviceSize a_value, const VkDeviceSize a_alignment)
+{
+	if (a_alignment <= 1)
+	{
+		return a_value;
+	}
+
+	return (a_value + a_alignment - 1) / a_alignment * a_alignment;
+}
@@ -0,0 +1,129 @@
+#ifndef DEVICE_MEMORY_ALLOCATOR_H
+#define DEVICE_MEMORY_ALLOCATOR_H
+
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <deque>
+#include <map>
+#include <mutex>
+
+// Long lived buffers and images share blocks of this size, requests bigger than half a block get a vkAllocateMemory of their own
+const VkDeviceSize MEMORY_BLOCK_SIZE = 64ull * 1024 * 1024;
+// Transient (staging) allocations are taken from a ring of this size per memory type
+const VkDeviceSize STAGING_RING_SIZE = 64ull * 1024 * 1024;
+// Memory the cpu can write final buffers in directly (resizable BAR, integrated GPUs, software rasterizers)
+const VkMemoryPropertyFlags DIRECT_WRITE_MEMORY_PROPERTIES = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | 
+	VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+// Smaller device local host visible heaps are the 256 MB BAR window without resizable BAR, the driver needs it itself
+const VkDeviceSize DIRECT_WRITE_MIN_HEAP_SIZE = 512ull * 1024 * 1024;
+
+enum class AllocationLifetime
+{
+	PERSISTENT,		// free list block, freed in any order
+	TRANSIENT		// staging ring, freed soon and mostly in allocation order
+};
+
+enum class AllocationKind
+{
+	BUFFER,
+	IMAGE			// images never share a block with buffers, so bufferImageGranularity does not matter
+};
+
+struct MemoryAllocation
+{
+	VkDeviceMemory memory = VK_NULL_HANDLE;
+	VkDeviceSize offset = 0;
+	VkDeviceSize size = 0;
+	void* mapped = nullptr;			// host visible memory stays mapped, points at offset
+	AllocationLifetime lifetime = AllocationLifetime::PERSISTENT;
+	int pool = -1;					// block or ring index, -1 for a dedicated allocation
+};
+
+struct MemoryStats
+{
+	uint32_t deviceAllocationCount = 0;		// live vkAllocateMemory calls
+	uint32_t blockCount = 0;
+	uint32_t dedicatedCount = 0;
+	uint32_t allocationCount = 0;			// live sub allocations
+	VkDeviceSize reservedBytes = 0;
+	VkDeviceSize usedBytes = 0;
+	VkDeviceSize freeBytes = 0;				// free in the blocks
+	VkDeviceSize largestFreeRange = 0;
+	uint32_t freeRangeCount = 0;
+	float fragmentation = 0.0f;				// share of the free bytes outside the largest free range of their block
+};
+
+// Sub allocates buffer and image memory out of big per memory type blocks (free list, first fit with coalescing)
+// and staging memory out of per memory type rings. Thread safe, the mesh rebuild job allocates from a worker.
+class DeviceMemoryAllocator
+{
+public:
+	void Init(VkPhysicalDevice a_physicalDevice, VkDevice a_logicalDevice);
+	void Destroy();
+
+	MemoryAllocation Allocate(const VkMemoryRequirements& a_requirements, const VkMemoryPropertyFlags a_properties,
+		const AllocationKind a_kind, const AllocationLifetime a_lifetime = AllocationLifetime::PERSISTENT);
+	// Resets a_allocation, freeing an empty allocation does nothing
+	void Free(MemoryAllocation& a_allocation);
+
+	// Requests for DIRECT_WRITE_MEMORY_PROPERTIES get the direct write type found in Init if a_typeFilter allows it
+	uint32_t FindMemoryType(const uint32_t a_typeFilter, const VkMemoryPropertyFlags a_properties) const;
+	bool HasDirectWriteMemory() const;
+
+	MemoryStats GetStats() const;
+	void PrintStats() const;
+
+private:
+	struct MemoryBlock
+	{
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		void* mapped = nullptr;
+		uint32_t memoryType = 0;
+		AllocationKind kind = AllocationKind::BUFFER;
+		std::map<VkDeviceSize, VkDeviceSize> freeRanges;	// offset -> size, neighbours are always merged
+		VkDeviceSize usedBytes = 0;
+		uint32_t allocationCount = 0;
+	};
+
+	struct RingEntry
+	{
+		VkDeviceSize offset;
+		VkDeviceSize size;
+		bool freed;
+	};
+
+	struct StagingRing
+	{
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		void* mapped = nullptr;
+		uint32_t memoryType = 0;
+		std::deque<RingEntry> entries;		// oldest first, the space up to the oldest live entry is reused
+		VkDeviceSize usedBytes = 0;
+		VkDeviceSize peakBytes = 0;
+		uint32_t overflowCount = 0;			// requests that did not fit and went dedicated
+	};
+
+	VkDeviceMemory AllocateDeviceMemory(const VkDeviceSize a_size, const uint32_t a_memoryType, void** a_mapped);
+
+	bool AllocateFromBlock(MemoryBlock& a_block, const VkMemoryRequirements& a_requirements, VkDeviceSize& a_offset);
+	void FreeFromBlock(MemoryBlock& a_block, const VkDeviceSize a_offset, const VkDeviceSize a_size);
+	void ReleaseSpareBlock(MemoryBlock& a_block);
+	bool AllocateFromRing(StagingRing& a_ring, const VkMemoryRequirements& a_requirements, VkDeviceSize& a_offset);
+	void FreeFromRing(StagingRing& a_ring, const VkDeviceSize a_offset);
+
+	static VkDeviceSize AlignUp(const VkDeviceSize a_value, const VkDeviceSize a_alignment);
+
+	VkPhysicalDevice m_physicalDevice = VK_NULL_HANDLE;
+	VkDevice m_logicalDevice = VK_NULL_HANDLE;
+	VkPhysicalDeviceMemoryProperties m_memoryProperties{};
+	int m_directWriteMemoryType = -1;		// DIRECT_WRITE_MEMORY_PROPERTIES on the biggest heap, -1 if there is none big enough
+
+	std::vector<MemoryBlock> m_blocks;		// never erased, MemoryAllocation::pool indexes into it, released blocks have no memory
+	std::vector<StagingRing> m_rings;
+
+	uint32_t m_dedicatedCount = 0;
+	VkDeviceSize m_dedicatedBytes = 0;
+
+	mutable std::mutex m_mutex;
+};
+#endif // !DEVICE_MEMORY_ALLOCATOR_H
@@ -0,0 +1,184 @@
+#include "FrustumCuller.h"
+
+#include <immintrin.h>
+#include <iostream>
+#include <chrono>
+
+//one register of FRUSTUM_CULL_WIDTH floats, the kernel is written once against these
+#if defined(__AVX__)
+typedef __m256 Lanes;
+static inline Lanes LoadLanes(const float* a_pValues) { return _mm256_loadu_ps(a_pValues); }
+static inline Lanes SetLanes(const float a_value) { return _mm256_set1_ps(a_value); }
+static inline Lanes AddLanes(const Lanes a_a, const Lanes a_b) { return _mm256_add_ps(a_a, a_b); }
+static inline Lanes MulLanes(const Lanes a_a, const Lanes a_b) { return _mm256_mul_ps(a_a, a_b); }
+static inline Lanes MaxLanes(const Lanes a_a, const Lanes a_b) { return _mm256_max_ps(a_a, a_b); }
+static inline Lanes OrLanes(const Lanes a_a, const Lanes a_b) { return _mm256_or_ps(a_a, a_b); }
+static inline Lanes LessThanZero(const Lanes a_a) { return _mm256_cmp_ps(a_a, _mm256_setzero_ps(), _CMP_LT_OQ); }
+static inline int MaskLanes(const Lanes a_a) { return _mm256_movemask_ps(a_a); }
+#else
+typedef __m128 Lanes;
+static inline Lanes LoadLanes(const float* a_pValues) { return _mm_loadu_ps(a_pValues); }
+static inline Lanes SetLanes(const float a_value) { return _mm_set1_ps(a_value); }
+static inline Lanes AddLanes(const Lanes a_a, const Lanes a_b) { return _mm_add_ps(a_a, a_b); }
+static inline Lanes MulLanes(const Lanes a_a, const Lanes a_b) { return _mm_mul_ps(a_a, a_b); }
+static inline Lanes MaxLanes(const Lanes a_a, const Lanes a_b) { return _mm_max_ps(a_a, a_b); }
+static inline Lanes OrLanes(const Lanes a_a, const Lanes a_b) { return _mm_or_ps(a_a, a_b); }
+static inline Lanes LessThanZero(const Lanes a_a) { return _mm_cmplt_ps(a_a, _mm_setzero_ps()); }
+static inline int MaskLanes(const Lanes a_a) { return _mm_movemask_ps(a_a); }
+#endif
+
+uint32_t FrustumCuller::Add(const glm::vec3& a_min, const glm::vec3& a_max)
+{
+	Reserve(m_count + 1);
+	Set(m_count, a_min, a_max);
+
+	return m_count++;
+}
+
+void FrustumCuller::Set(const uint32_t a_index, const glm::vec3& a_min, const glm::vec3& a_max)
+{
+	m_minX[a_index] = a_min.x;
+	m_minY[a_index] = a_min.y;
+	m_minZ[a_index] = a_min.z;
+	m_maxX[a_index] = a_max.x;
+	m_maxY[a_index] = a_max.y;
+	m_maxZ[a_index] = a_max.z;
+}
+
+void FrustumCuller::Remove(const uint32_t a_index)
+{
+	uint32_t last = m_count - 1;
+
+	m_minX[a_index] = m_minX[last];
+	m_minY[a_index] = m_minY[last];
+	m_minZ[a_index] = m_minZ[last];
+	m_maxX[a_index] = m_maxX[last];
+	m_maxY[a_index] = m_maxY[last];
+	m_maxZ[a_index] = m_maxZ[last];
+
+	m_count--;
+}
+
+void FrustumCuller::Clear()
+{
+	m_count = 0;
+}
+
+uint32_t FrustumCuller::GetCount() const
+{
+	return m_count;
+}
+
+void FrustumCuller::SetViewProjection(const glm::mat4& a_viewProjection)
+{
+	//rows of the matrix (glm is column major), Gribb and Hartmann
+	glm::vec4 rows[4];
+	for (int r = 0; r < 4; r++) {
+		rows[r] = glm::vec4(a_viewProjection[0][r], a_viewProjection[1][r], a_viewProjection[2][r], a_viewProjection[3][r]);
+	}
+
+	m_planes[0] = rows[3] + rows[0];	//left
+	m_planes[1] = rows[3] - rows[0];	//right
+	m_planes[2] = rows[3] + rows[1];	//bottom (top with the flipped y of vulkan, the set stays the same)
+	m_planes[3] = rows[3] - rows[1];	//top
+	m_planes[4] = rows[2];				//near, depth 0..1
+	m_planes[5] = rows[3] - rows[2];	//far
+
+	for (glm::vec4& plane : m_planes) {
+		plane /= glm::length(glm::vec3(plane));
+	}
+}
+
+void FrustumCuller::Cull(std::vector<uint32_t>& a_visible)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	a_visible.clear();
+
+	//the planes are broadcast once, x y z w of plane p at 4 * p
+	Lanes planes[24];
+	for (int p = 0; p < 6; p++) {
+		for (int c = 0; c < 4; c++) {
+			planes[4 * p + c] = SetLanes(m_planes[p][c]);
+		}
+	}
+
+	for (uint32_t first = 0; first < m_count; first += FRUSTUM_CULL_WIDTH) {
+		Lanes minX = LoadLanes(&m_minX[first]);
+		Lanes minY = LoadLanes(&m_minY[first]);
+		Lanes minZ = LoadLanes(&m_minZ[first]);
+		Lanes maxX = LoadLanes(&m_maxX[first]);
+		Lanes maxY = LoadLanes(&m_maxY[first]);
+		Lanes maxZ = LoadLanes(&m_maxZ[first]);
+		Lanes outside = SetLanes(0.0f);
+
+		for (int p = 0; p < 6; p++) {
+			const Lanes* plane = &planes[4 * p];
+
+			//the larger product of each axis is the corner furthest along the normal
+			Lanes distance = plane[3];
+			distance = AddLanes(distance, MaxLanes(MulLanes(plane[0], minX), MulLanes(plane[0], maxX)));
+			distance = AddLanes(distance, MaxLanes(MulLanes(plane[1], minY), MulLanes(plane[1], maxY)));
+			distance = AddLanes(distance, MaxLanes(MulLanes(plane[2], minZ), MulLanes(plane[2], maxZ)));
+
+			outside = OrLanes(outside, LessThanZero(distance));
+		}
+
+		int outsideMask = MaskLanes(outside);
+
+		//whole batches out of view are the common case
+		if (outsideMask == (1 << FRUSTUM_CULL_WIDTH) - 1)
+		{
+			continue;
+		}
+
+		uint32_t lanes = m_count - first < FRUSTUM_CULL_WIDTH ? m_count - first : FRUSTUM_CULL_WIDTH;
+		for (uint32_t lane = 0; lane < lanes; lane++) {
+			if (!(outsideMask & (1 << lane)))
+			{
+				a_visible.push_back(first + lane);
+			}
+		}
+	}
+
+	double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+	m_cullCount++;
+	m_testedBoxes += m_count;
+	m_visibleBoxes += a_visible.size();
+	m_cullSeconds += seconds;
+	m_maxCullSeconds = seconds > m_maxCullSeconds ? seconds : m_maxCullSeconds;
+}
+
+void FrustumCuller::PrintStats() const
+{
+	if (m_cullCount == 0)
+	{
+		return;
+	}
+
+	std::cout << "" << std::endl;
+	std::cout << "Frustum culling (" << (FRUSTUM_CULL_WIDTH == 8 ? "AVX" : "SSE") << "): " << m_count << " boxes, "
+		<< m_testedBoxes / m_cullCount << " tested and " << m_visibleBoxes / m_cullCount << " visible per cull on average, "
+		<< m_cullSeconds / m_cullCount * 1000.0 << " ms average and " << m_maxCullSeconds * 1000.0 << " ms max over " << m_cullCount << " culls" << std::endl;
+}
+
+void FrustumCuller::Reserve(const uint32_t a_count)
+{
+	if (a_count <= m_minX.size())
+	{
+		return;
+	}
+
+	//doubling, padded to whole batches so the loads of the last batch stay inside
+	size_t size = m_minX.size() * 2;
+	size = size < a_count ? a_count : size;
+	size = (size + FRUSTUM_CULL_WIDTH - 1) / FRUSTUM_CULL_WIDTH * FRUSTUM_CULL_WIDTH;
+
+	m_minX.resize(size, 0.0f);
+	m_minY.resize(size, 0.0f);
+	m_minZ.resize(size, 0.0f);
+	m_maxX.resize(size, 0.0f);
+	m_maxY.resize(size, 0.0f);
+	m_maxZ.resize(size, 0.0f);
+}
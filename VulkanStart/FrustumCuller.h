@@ -0,0 +1,55 @@
+#ifndef FRUSTUM_CULLER_H
+#define FRUSTUM_CULLER_H
+
+#include <glm/glm.hpp>
+#include <vector>
+#include <cstdint>
+
+// Boxes tested at once, 8 with AVX (/arch:AVX or higher), 4 with SSE2
+#if defined(__AVX__)
+const uint32_t FRUSTUM_CULL_WIDTH = 8;
+#else
+const uint32_t FRUSTUM_CULL_WIDTH = 4;
+#endif
+
+// Tests axis aligned boxes against the six planes of a view projection (vulkan depth range 0..1).
+// The boxes are kept as structure of arrays (min x, min y, ... each in an array of its own) so one SIMD register holds
+// the same coordinate of FRUSTUM_CULL_WIDTH boxes, a box is outside once its corner furthest along the normal of a plane is behind it.
+// Box indices are dense, Remove moves the last box into the hole like a swap and pop, callers mirror that in their own arrays.
+class FrustumCuller
+{
+public:
+	// Returns the index of the box
+	uint32_t Add(const glm::vec3& a_min, const glm::vec3& a_max);
+	void Set(const uint32_t a_index, const glm::vec3& a_min, const glm::vec3& a_max);
+	void Remove(const uint32_t a_index);
+	void Clear();
+	uint32_t GetCount() const;
+
+	void SetViewProjection(const glm::mat4& a_viewProjection);
+	// Overwrites a_visible with the indices of the boxes inside or intersecting the frustum, in ascending order
+	void Cull(std::vector<uint32_t>& a_visible);
+
+	void PrintStats() const;
+
+private:
+	// Keeps every array a multiple of FRUSTUM_CULL_WIDTH long, the lanes past m_count are masked out
+	void Reserve(const uint32_t a_count);
+
+	std::vector<float> m_minX;
+	std::vector<float> m_minY;
+	std::vector<float> m_minZ;
+	std::vector<float> m_maxX;
+	std::vector<float> m_maxY;
+	std::vector<float> m_maxZ;
+	uint32_t m_count = 0;
+
+	glm::vec4 m_planes[6];		// xyz = normal pointing inside, w = distance, normalized
+
+	uint64_t m_cullCount = 0;
+	uint64_t m_testedBoxes = 0;
+	uint64_t m_visibleBoxes = 0;
+	double m_cullSeconds = 0.0;
+	double m_maxCullSeconds = 0.0;
+};
+#endif // !FRUSTUM_CULLER_H
@@ -0,0 +1,278 @@
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <cstdint>
+
+//index of the worker running on this thread, threads outside the job system have none
+static thread_local size_t s_workerIndex = SIZE_MAX;
+
+#pragma region TaskGroup
+
+TaskGroup::TaskGroup()
+{
+	m_pendingTasks = 0;
+	m_finishingTasks = 0;
+}
+
+TaskGroup::~TaskGroup()
+{
+	//tasks still reference the group
+	Wait();
+}
+
+void TaskGroup::Run(const std::function<void()>& a_task)
+{
+	JobSystem::GetInstance().Submit(a_task, this);
+}
+
+void TaskGroup::Wait()
+{
+	JobSystem& jobSystem = JobSystem::GetInstance();
+
+	while (!IsDone())
+	{
+		//help instead of blocking, the tasks of this group may sit in any queue.
+		//only with them, a frame waiting for a few draw tasks must not pick up a whole mesh rebuild
+		if (!jobSystem.RunPendingJob(this))
+		{
+			std::this_thread::yield();
+		}
+	}
+}
+
+bool TaskGroup::IsDone() const
+{
+	//the last task counts as finishing before it stops being pending, so the group outlives its FinishTask
+	return m_pendingTasks.load() == 0 && m_finishingTasks.load() == 0;
+}
+
+void TaskGroup::ContinueWith(const std::function<void()>& a_continuation)
+{
+	std::lock_guard<std::mutex> lock(m_continuationMutex);
+
+	//FinishTask of the last task takes the lock after the pending count hit zero, it starts whatever is stored by then
+	if (m_pendingTasks.load() == 0)
+	{
+		JobSystem::GetInstance().Submit(a_continuation);
+		return;
+	}
+
+	m_continuation = a_continuation;
+}
+
+void TaskGroup::FinishTask()
+{
+	m_finishingTasks++;
+
+	//only the last task of the group pays for the lock
+	if (m_pendingTasks.fetch_sub(1) == 1)
+	{
+		std::function<void()> continuation;
+
+		{
+			std::lock_guard<std::mutex> lock(m_continuationMutex);
+			continuation.swap(m_continuation);
+		}
+
+		if (continuation)
+		{
+			JobSystem::GetInstance().Submit(continuation);
+		}
+	}
+
+	//the last access to the group, Wait may return and destroy it right after
+	m_finishingTasks--;
+}
+
+#pragma endregion
+
+#pragma region JobSystem
+
+JobSystem& JobSystem::GetInstance()
+{
+	static JobSystem instance;
+	return instance;
+}
+
+JobSystem::JobSystem()
+{
+	//the thread calling Wait helps out, so one core is left for it
+	unsigned int hardwareThreads = std::thread::hardware_concurrency();
+	size_t workerCount = std::max(1u, hardwareThreads > 1 ? hardwareThreads - 1 : 1u);
+
+	m_running = true;
+	m_queuedJobs = 0;
+	m_nextQueue = 0;
+
+	for (size_t i = 0; i < workerCount; i++)
+	{
+		m_queues.emplace_back(new WorkerQueue());
+	}
+
+	for (size_t i = 0; i < workerCount; i++)
+	{
+		m_workers.emplace_back(&JobSystem::WorkerLoop, this, i);
+	}
+}
+
+JobSystem::~JobSystem()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_wakeMutex);
+		m_running = false;
+	}
+	m_wakeCondition.notify_all();
+
+	for (std::thread& worker : m_workers)
+	{
+		worker.join();
+	}
+}
+
+size_t JobSystem::GetWorkerCount() const
+{
+	return m_workers.size();
+}
+
+void JobSystem::Submit(const std::function<void()>& a_task, TaskGroup* a_group)
+{
+	if (a_group)
+	{
+		a_group->m_pendingTasks++;
+	}
+
+	//workers keep their own jobs local, everybody else spreads them round robin
+	size_t queueIndex = s_workerIndex;
+	if (queueIndex >= m_queues.size())
+	{
+		queueIndex = m_nextQueue++ % m_queues.size();
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_queues[queueIndex]->mutex);
+		m_queues[queueIndex]->jobs.push_back({ a_task, a_group });
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_wakeMutex);
+		m_queuedJobs++;
+	}
+	m_wakeCondition.notify_one();
+}
+
+void JobSystem::ParallelFor(TaskGroup& a_group, const int a_count, const int a_grainSize, const std::function<void(int, int)>& a_task)
+{
+	int grainSize = std::max(1, a_grainSize);
+
+	for (int begin = 0; begin < a_count; begin += grainSize)
+	{
+		int end = std::min(a_count, begin + grainSize);
+		a_group.Run([a_task, begin, end]() { a_task(begin, end); });
+	}
+}
+
+bool JobSystem::RunPendingJob(const TaskGroup* a_group)
+{
+	Job job;
+	size_t ownQueue = s_workerIndex;
+
+	if ((ownQueue < m_queues.size() && PopJob(ownQueue, a_group, job)) || StealJob(ownQueue, a_group, job))
+	{
+		Execute(job);
+		return true;
+	}
+
+	return false;
+}
+
+void JobSystem::WorkerLoop(const size_t a_workerIndex)
+{
+	s_workerIndex = a_workerIndex;
+
+	while (true)
+	{
+		Job job;
+
+		if (PopJob(a_workerIndex, nullptr, job) || StealJob(a_workerIndex, nullptr, job))
+		{
+			Execute(job);
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(m_wakeMutex);
+		m_wakeCondition.wait(lock, [this]() { return m_queuedJobs > 0 || !m_running; });
+
+		if (!m_running)
+		{
+			return;
+		}
+	}
+}
+
+bool JobSystem::PopJob(const size_t a_queueIndex, const TaskGroup* a_group, Job& a_job)
+{
+	WorkerQueue& queue = *m_queues[a_queueIndex];
+	std::lock_guard<std::mutex> lock(queue.mutex);
+
+	//newest first, its data is most likely still in the cache
+	for (auto job = queue.jobs.rbegin(); job != queue.jobs.rend(); ++job)
+	{
+		if (a_group && job->group != a_group)
+		{
+			continue;
+		}
+
+		a_job = std::move(*job);
+		queue.jobs.erase(std::next(job).base());
+		m_queuedJobs--;
+		return true;
+	}
+
+	return false;
+}
+
+bool JobSystem::StealJob(const size_t a_thiefIndex, const TaskGroup* a_group, Job& a_job)
+{
+	size_t queueCount = m_queues.size();
+	size_t start = a_thiefIndex < queueCount ? a_thiefIndex + 1 : m_nextQueue.load();
+
+	for (size_t i = 0; i < queueCount; i++)
+	{
+		size_t victim = (start + i) % queueCount;
+		if (victim == a_thiefIndex)
+		{
+			continue;
+		}
+
+		WorkerQueue& queue = *m_queues[victim];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+
+		//oldest first, those are usually the biggest pieces of work left
+		for (auto job = queue.jobs.begin(); job != queue.jobs.end(); ++job)
+		{
+			if (a_group && job->group != a_group)
+			{
+				continue;
+			}
+
+			a_job = std::move(*job);
+			queue.jobs.erase(job);
+			m_queuedJobs--;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void JobSystem::Execute(Job& a_job)
+{
+	a_job.task();
+
+	if (a_job.group)
+	{
+		a_job.group->FinishTask();
+	}
+}
+
+#pragma endregion
@@ -0,0 +1,98 @@
+#ifndef JOB_SYSTEM_H
+#define JOB_SYSTEM_H
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <memory>
+
+class JobSystem;
+
+// Counts the unfinished tasks of one batch of work, Wait helps executing the jobs of this group until all of them are done
+class TaskGroup
+{
+public:
+	TaskGroup();
+	~TaskGroup();
+
+	TaskGroup(const TaskGroup&) = delete;
+	TaskGroup& operator=(const TaskGroup&) = delete;
+
+	void Run(const std::function<void()>& a_task);
+	void Wait();
+	bool IsDone() const;
+
+	// Submitted as a new job once the last running task of the group finished (or right away if nothing is running)
+	// Wait does not wait for the continuation, it belongs to no group
+	void ContinueWith(const std::function<void()>& a_continuation);
+
+private:
+	friend class JobSystem;
+
+	void FinishTask();
+
+	std::atomic<int> m_pendingTasks;
+	// FinishTask calls still touching the group, it is not done before they left
+	std::atomic<int> m_finishingTasks;
+	// only locked by ContinueWith and the FinishTask of the last task
+	std::mutex m_continuationMutex;
+	std::function<void()> m_continuation;
+};
+
+// Persistent worker threads, one job deque per worker.
+// Workers take jobs from the back of their own deque and steal from the front of the others when it runs dry.
+class JobSystem
+{
+public:
+	static JobSystem& GetInstance();
+
+	~JobSystem();
+
+	JobSystem(const JobSystem&) = delete;
+	JobSystem& operator=(const JobSystem&) = delete;
+
+	size_t GetWorkerCount() const;
+
+	void Submit(const std::function<void()>& a_task, TaskGroup* a_group = nullptr);
+
+	// Splits [0, a_count) into ranges of a_grainSize and runs a_task(begin, end) for every range in a_group
+	void ParallelFor(TaskGroup& a_group, const int a_count, const int a_grainSize, const std::function<void(int, int)>& a_task);
+
+	// Runs one queued job of a_group on the calling thread (any job without a group given), returns false if there was nothing to do
+	bool RunPendingJob(const TaskGroup* a_group = nullptr);
+
+private:
+	struct Job
+	{
+		std::function<void()> task;
+		TaskGroup* group = nullptr;
+	};
+
+	struct WorkerQueue
+	{
+		std::mutex mutex;
+		std::deque<Job> jobs;
+	};
+
+	JobSystem();
+
+	void WorkerLoop(const size_t a_workerIndex);
+	bool PopJob(const size_t a_queueIndex, const TaskGroup* a_group, Job& a_job);
+	bool StealJob(const size_t a_thiefIndex, const TaskGroup* a_group, Job& a_job);
+	void Execute(Job& a_job);
+
+	std::vector<std::thread> m_workers;
+	std::vector<std::unique_ptr<WorkerQueue>> m_queues;
+
+	std::atomic<bool> m_running;
+	std::atomic<int> m_queuedJobs;
+	std::atomic<size_t> m_nextQueue;
+
+	std::mutex m_wakeMutex;
+	std::condition_variable m_wakeCondition;
+};
+#endif // !JOB_SYSTEM_H
@@ -6,6 +6,7 @@
 #include <array>
 #include <vector>
 #include <optional>
+#include "DeviceMemoryAllocator.h"
 
 struct Vertex {
 	glm::vec3 pos;
@@ -36,6 +37,171 @@ struct Vertex {
 	}
 };
 
+// Per voxel instance data for the instanced renderer, the shared cube is scaled by size and moved to position
+struct VoxelInstance {
+	glm::vec3 position;
+	float size;
+	uint32_t color;		// RGBA8, same packing as VoxelWorld materials
+
+	static VkVertexInputBindingDescription getBindingDescription() {
+		VkVertexInputBindingDescription bindingDescription{};
+		bindingDescription.binding = 1;
+		bindingDescription.stride = sizeof(VoxelInstance);
+		bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+
+		return bindingDescription;
+	}
+
+	static std::array<VkVertexInputAttributeDescription, 2> getAttributeDescriptions() {
+		std::array<VkVertexInputAttributeDescription, 2> attributeDescriptions{};
+		//position and size are read together as one vec4
+		attributeDescriptions[0].binding = 1;
+		attributeDescriptions[0].location = 1;
+		attributeDescriptions[0].format = VK_FORMAT_R32G32B32A32_SFLOAT;
+		attributeDescriptions[0].offset = offsetof(VoxelInstance, position);
+
+		attributeDescriptions[1].binding = 1;
+		attributeDescriptions[1].location = 2;
+		attributeDescriptions[1].format = VK_FORMAT_R8G8B8A8_UNORM;
+		attributeDescriptions[1].offset = offsetof(VoxelInstance, color);
+
+		return attributeDescriptions;
+	}
+};
+
+// Compact 8 byte vertex for chunk meshes, the chunk origin and voxel size come from ChunkDrawData
+// position = origin + cell + (corner ? +size : -size) per axis
+struct PackedVertex {
+	uint8_t cell[3];	// chunk local cell 0 - CHUNK_SIZE-1
+	uint8_t bits;		// bit 0-2 corner side per axis (1 = positive), bit 3-5 face index (PACKED_SHARED_FACE if shared)
+	uint32_t color;		// RGBA8, same packing as VoxelWorld materials
+
+	static VkVertexInputBindingDescription getBindingDescription() {
+		VkVertexInputBindingDescription bindingDescription{};
+		bindingDescription.binding = 0;
+		bindingDescription.stride = sizeof(PackedVertex);
+		bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+		return bindingDescription;
+	}
+
+	static std::array<VkVertexInputAttributeDescription, 2> getAttributeDescriptions() {
+		std::array<VkVertexInputAttributeDescription, 2> attributeDescriptions{};
+		//cell and bits are read together as one uvec4
+		attributeDescriptions[0].binding = 0;
+		attributeDescriptions[0].location = 0;
+		attributeDescriptions[0].format = VK_FORMAT_R8G8B8A8_UINT;
+		attributeDescriptions[0].offset = offsetof(PackedVertex, cell);
+
+		attributeDescriptions[1].binding = 0;
+		attributeDescriptions[1].location = 1;
+		attributeDescriptions[1].format = VK_FORMAT_R8G8B8A8_UNORM;
+		attributeDescriptions[1].offset = offsetof(PackedVertex, color);
+
+		return attributeDescriptions;
+	}
+};
+
+const uint8_t PACKED_SHARED_FACE = 6;
+
+// Part of the chunk mesh buffers that belongs to one chunk, indices are local to the chunk vertices
+struct ChunkDrawRange {
+	glm::ivec3 coord;
+	uint32_t firstIndex;
+	uint32_t indexCount;
+	int32_t vertexOffset;
+};
+
+// Device local buffers of a mesh built by a mesh rebuild of the expanded mode
+struct ChunkGpuMesh {
+	VkBuffer vertexBuffer = VK_NULL_HANDLE;
+	MemoryAllocation vertexBufferMemory;
+	VkBuffer indexBuffer = VK_NULL_HANDLE;
+	MemoryAllocation indexBufferMemory;
+	uint32_t indexCount = 0;
+};
+
+// Per chunk record of the chunk mesh arena, packed.vert reads it at gl_InstanceIndex (the firstInstance of the chunk draw)
+struct ChunkDrawData {
+	glm::vec4 originSize;	// xyz = chunk origin, w = voxel half extent
+};
+
+// Per chunk input of cull.comp, std430 layout. The records are grouped by arena page, a visible chunk gets the command
+// outputBase + (visible chunks of its page before it), or its own index without drawIndirectCount
+struct ChunkCullRecord {
+	glm::vec4 boundsMin;
+	glm::vec4 boundsMax;
+	glm::vec4 originSize;	// ChunkDrawData of the chunk
+	uint32_t indexCount;
+	uint32_t firstIndex;
+	int32_t vertexOffset;
+	uint32_t page;
+	uint32_t outputBase;	// first command of the page
+	uint32_t padding[3];
+};
+
+struct ChunkCullPushConstants {
+	uint32_t recordCount;
+	uint32_t compact;		// 1 = visible chunks are packed per page and counted, 0 = culled chunks keep their command with instanceCount 0
+};
+
+// Start of the trace grid buffer shader.comp traverses, std430 layout. The uints after it hold the chunk slots (from 0),
+// then per non empty chunk its occupancy bits, the colour index of the first solid cell of every occupancy word, and the colours of all solid cells
+struct TraceGridHeader {
+	glm::ivec4 minCell;			// xyz = first cell of the grid, the origin of its first chunk
+	glm::ivec4 chunkCounts;		// xyz = chunks per axis, w = non empty chunks
+	glm::uvec4 sections;		// x = occupancy, y = colour offsets, z = colours, in uints after the header
+	glm::vec4 voxelSize;		// x = voxel half extent
+};
+
+// 32 byte bvh node, std430 layout. Nodes are stored depth first, the left child of an inner node directly follows it
+struct BvhNode {
+	glm::vec3 boundsMin;
+	uint32_t leftOrFirst;		// inner node: index of the right child, leaf: first primitive
+	glm::vec3 boundsMax;
+	uint32_t count;				// 0 for inner nodes, primitives of the leaf otherwise
+};
+
+// Voxel as the bvh leaves reference it, in leaf order
+struct BvhPrimitive {
+	glm::vec3 center;
+	float halfSize;
+	uint32_t color;				// RGBA8 like VoxelWorld::PackColor
+	uint32_t padding[3];
+};
+
+// Start of the sparse voxel octree buffer shader.comp traverses, std430 layout. The uints after it hold the nodes (two uints each, the root first)
+// and then the colours of all stored voxels
+struct SvoHeader {
+	glm::ivec4 origin;			// xyz = first cell of the root cube, w = levels, the root covers 1 << w cells per axis
+	glm::uvec4 sections;		// x = nodes, y = colours in uints after the header, z = stored voxels
+	glm::vec4 voxelSize;		// x = voxel half extent
+};
+
+// Octree node, the existing children of a node are stored next to each other in octant order (x | y << 1 | z << 2)
+struct SvoNode {
+	uint32_t childMask;			// bit n = octant n has a child, SVO_LEAF_PARENT if the children are voxels
+	uint32_t firstChild;		// node index of the first child, or colour index of the first voxel for leaf parents
+};
+
+// Start of the sparse voxel dag buffer shader.comp traverses, std430 layout. The uints after it hold the nodes and then the colours,
+// a node is its child mask (like SvoNode), the node index of every child and the voxels before every child but the first.
+// Leaf parents are only the mask, their voxels follow each other in octant order
+struct DagHeader {
+	glm::ivec4 origin;			// xyz = first cell of the root cube, w = levels, the root covers 1 << w cells per axis
+	glm::uvec4 sections;		// x = root node, y = colours in uints after the header, z = voxels, w = node uints (0 for an empty dag)
+	glm::vec4 voxelSize;		// x = voxel half extent
+};
+
+// Start of the brick map grid buffer shader.comp traverses, std430 layout. The uints after it are the brick slots of the coarse grid,
+// the bricks themselves live in the brick pool buffer
+struct BrickMapHeader {
+	glm::ivec4 minCell;			// xyz = first cell of the grid, the origin of its first brick
+	glm::ivec4 brickCounts;		// xyz = bricks per axis, w = bricks in use
+	glm::uvec4 pool;			// x = brick slots of the pool, y = uints per brick
+	glm::vec4 voxelSize;		// x = voxel half extent
+};
+
 struct Vertex2D {
 	glm::vec2 pos;
 	glm::vec3 color;
@@ -74,6 +240,7 @@ struct SwapChainSupportDetails {
 struct QueueFamilyIndices {
 	std::optional<uint32_t> graphicsAndComputeFamily;
 	std::optional<uint32_t> presentFamily;
+	std::optional<uint32_t> transferFamily;		//only set for a family without graphics, uploads fall back to the graphics queue otherwise
 
 	bool isComplete() {
 		return graphicsAndComputeFamily.has_value() && presentFamily.has_value();
@@ -0,0 +1,156 @@
+#include "PipelineCache.h"
+
+#include <fstream>
+#include <filesystem>
+#include <iostream>
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+
+//VK_PIPELINE_CACHE_HEADER_VERSION_ONE: header size, header version, vendor id, device id, pipeline cache uuid
+const size_t PIPELINE_CACHE_HEADER_SIZE = 4 * sizeof(uint32_t) + VK_UUID_SIZE;
+
+void PipelineCache::Create(VkDevice a_logicalDevice, const VkPhysicalDeviceProperties& a_properties, const std::string& a_path)
+{
+	m_logicalDevice = a_logicalDevice;
+	m_properties = a_properties;
+	m_path = a_path;
+
+	std::vector<char> data;
+
+	std::ifstream file(m_path, std::ios::ate | std::ios::binary);
+	if (file.is_open())
+	{
+		data.resize(static_cast<size_t>(file.tellg()));
+		file.seekg(0);
+		file.read(data.data(), data.size());
+		file.close();
+	}
+
+	//the driver would reject a foreign cache as well, but checking first tells why the cache was dropped
+	if (!data.empty() && !IsCompatible(data))
+	{
+		std::cout << "" << std::endl;
+		std::cout << "Pipeline cache " << m_path << " was written by another device or driver, starting empty" << std::endl;
+		data.clear();
+	}
+
+	VkPipelineCacheCreateInfo cacheInfo{};
+	cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+	cacheInfo.initialDataSize = data.size();
+	cacheInfo.pInitialData = data.empty() ? nullptr : data.data();
+
+	if (vkCreatePipelineCache(m_logicalDevice, &cacheInfo, nullptr, &m_cache) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create pipeline cache!");
+	}
+
+	m_loadedSize = data.size();
+	m_savedSize = data.size();
+
+	std::cout << "" << std::endl;
+	std::cout << "Success: created pipeline cache (" << (m_loadedSize > 0 ? "loaded " + std::to_string(m_loadedSize / 1024) + " KB" : "empty") << ")" << std::endl;
+}
+
+void PipelineCache::Save()
+{
+	size_t size = GetDataSize();
+	if (size == 0 || size == m_savedSize)
+	{
+		return;
+	}
+
+	std::vector<char> data(size);
+	if (vkGetPipelineCacheData(m_logicalDevice, m_cache, &size, data.data()) != VK_SUCCESS) {
+		throw std::runtime_error("failed to get pipeline cache data!");
+	}
+
+	//written next to the old file and renamed, a run that is killed meanwhile leaves the old cache intact
+	std::string tempPath = m_path + ".tmp";
+
+	std::ofstream file(tempPath, std::ios::out | std::ios::binary | std::ios::trunc);
+	if (!file.is_open())
+	{
+		std::cout << "" << std::endl;
+		std::cout << "Could not write the pipeline cache to " << tempPath << std::endl;
+		return;
+	}
+
+	file.write(data.data(), size);
+	file.close();
+
+	std::error_code error;
+	std::filesystem::rename(tempPath, m_path, error);
+	if (error)
+	{
+		std::cout << "" << std::endl;
+		std::cout << "Could not write the pipeline cache to " << m_path << ": " << error.message() << std::endl;
+		return;
+	}
+
+	m_savedSize = size;
+
+	std::cout << "" << std::endl;
+	std::cout << "Success: saved pipeline cache (" << size / 1024 << " KB)" << std::endl;
+}
+
+void PipelineCache::Destroy()
+{
+	vkDestroyPipelineCache(m_logicalDevice, m_cache, nullptr);
+	m_cache = VK_NULL_HANDLE;
+}
+
+VkResult PipelineCache::CreateGraphicsPipeline(const VkGraphicsPipelineCreateInfo& a_createInfo, VkPipeline& a_pipeline)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	VkResult result = vkCreateGraphicsPipelines(m_logicalDevice, m_cache, 1, &a_createInfo, nullptr, &a_pipeline);
+
+	m_pipelineSeconds += std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+	m_pipelineCount++;
+
+	return result;
+}
+
+VkResult PipelineCache::CreateComputePipeline(const VkComputePipelineCreateInfo& a_createInfo, VkPipeline& a_pipeline)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	VkResult result = vkCreateComputePipelines(m_logicalDevice, m_cache, 1, &a_createInfo, nullptr, &a_pipeline);
+
+	m_pipelineSeconds += std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+	m_pipelineCount++;
+
+	return result;
+}
+
+void PipelineCache::PrintStats() const
+{
+	std::cout << "" << std::endl;
+	std::cout << "Pipelines: " << m_pipelineCount << " created in " << m_pipelineSeconds * 1000.0 << " ms, cache "
+		<< (m_loadedSize > 0 ? "loaded with " + std::to_string(m_loadedSize / 1024) + " KB" : "started empty") << std::endl;
+}
+
+bool PipelineCache::IsCompatible(const std::vector<char>& a_data) const
+{
+	if (a_data.size() < PIPELINE_CACHE_HEADER_SIZE)
+	{
+		return false;
+	}
+
+	uint32_t header[4];
+	std::memcpy(header, a_data.data(), sizeof(header));
+
+	return header[0] >= PIPELINE_CACHE_HEADER_SIZE && header[1] == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+		header[2] == m_properties.vendorID && header[3] == m_properties.deviceID &&
+		std::memcmp(a_data.data() + sizeof(header), m_properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
+
+size_t PipelineCache::GetDataSize() const
+{
+	size_t size = 0;
+	if (vkGetPipelineCacheData(m_logicalDevice, m_cache, &size, nullptr) != VK_SUCCESS) {
+		throw std::runtime_error("failed to get pipeline cache size!");
+	}
+
+	return size;
+}
@@ -0,0 +1,42 @@
+#ifndef PIPELINE_CACHE_H
+#define PIPELINE_CACHE_H
+
+#include <vulkan/vulkan.h>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+// Where the cache is kept between runs, next to the shaders
+const char* const PIPELINE_CACHE_PATH = "shaders/pipeline_cache.bin";
+
+// VkPipelineCache that survives the run.
+// The file is only loaded if its header (VK_PIPELINE_CACHE_HEADER_VERSION_ONE) names the same vendor, device and pipelineCacheUUID,
+// a new driver or another gpu starts with an empty cache. The pipelines are created through the cache, which also times them.
+class PipelineCache
+{
+public:
+	void Create(VkDevice a_logicalDevice, const VkPhysicalDeviceProperties& a_properties, const std::string& a_path);
+	// Writes the cache back to the file if pipelines were added since it was loaded or saved
+	void Save();
+	void Destroy();
+
+	VkResult CreateGraphicsPipeline(const VkGraphicsPipelineCreateInfo& a_createInfo, VkPipeline& a_pipeline);
+	VkResult CreateComputePipeline(const VkComputePipelineCreateInfo& a_createInfo, VkPipeline& a_pipeline);
+
+	void PrintStats() const;
+
+private:
+	bool IsCompatible(const std::vector<char>& a_data) const;
+	size_t GetDataSize() const;
+
+	VkDevice m_logicalDevice = VK_NULL_HANDLE;
+	VkPipelineCache m_cache = VK_NULL_HANDLE;
+	VkPhysicalDeviceProperties m_properties{};
+	std::string m_path;
+
+	size_t m_loadedSize = 0;		// 0 if the cache started empty
+	size_t m_savedSize = 0;
+	uint32_t m_pipelineCount = 0;
+	double m_pipelineSeconds = 0.0;
+};
+#endif // !PIPELINE_CACHE_H
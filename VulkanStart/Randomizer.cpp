@@ -14,3 +14,18 @@ float Randomizer::RandomFloatBetween01()
 	float rnd = (double)rand() / RAND_MAX;
 	return rnd;
 }
+
+float Randomizer::RandomIntAsFloatBetween(std::minstd_rand& a_generator, const int& start, const int& end)
+{
+	float rnd = a_generator() % (end - start);
+
+	rnd += start;
+
+	return rnd;
+}
+
+float Randomizer::RandomFloatBetween01(std::minstd_rand& a_generator)
+{
+	float rnd = (double)(a_generator() - a_generator.min()) / (a_generator.max() - a_generator.min());
+	return rnd;
+}
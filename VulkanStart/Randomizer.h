@@ -3,11 +3,16 @@
 #define RANDOMIZER_H
 
 #include <cstdlib>
+#include <random>
 
 static class Randomizer 
 {
 public:
 	static float RandomIntAsFloatBetween(const int& start, const int& end);
 	static float RandomFloatBetween01();
+
+	// Same as above but drawing from a_generator instead of rand(), so every thread can own one
+	static float RandomIntAsFloatBetween(std::minstd_rand& a_generator, const int& start, const int& end);
+	static float RandomFloatBetween01(std::minstd_rand& a_generator);
 };
 #endif // !RANDOMIZER_H
@@ -8,7 +8,7 @@ Scene::Scene()
 Scene::Scene(Camera& a_camera)
 {
 	m_Camera = a_camera;
-	m_voxel = {};
+	m_world = VoxelWorld();
 }
 
 Camera& Scene::GetCamera()
@@ -16,147 +16,323 @@ Camera& Scene::GetCamera()
 	return m_Camera;
 }
 
+VoxelWorld& Scene::GetWorld()
+{
+	return m_world;
+}
+
 std::vector<Voxel> Scene::GetVoxel()
 {
-	return m_voxel;
+	return m_world.ExportVoxel();
+}
+
+size_t Scene::GetVoxelCount()
+{
+	return m_world.GetVoxelCount();
 }
 
 void Scene::SetVoxel(const std::vector<Voxel>& a_voxel)
 {
-	m_voxel = a_voxel;
+	m_world.Clear();
+	m_world.ImportVoxel(a_voxel);
 }
 
 void Scene::AddVoxel(const Voxel& a_voxel)
 {
-	m_voxel.push_back(a_voxel);
+	m_world.SetVoxel(VoxelWorld::CellFromPosition(a_voxel.GetPosition()), VoxelWorld::PackColor(a_voxel.GetColor()));
+	m_world.SetVoxelSize(a_voxel.GetSize());
 }
 
 void Scene::AddVoxel(const std::vector<Voxel>& a_voxel)
 {
-	int voxelCount = a_voxel.size();
-
-	for (int i = 0; i < voxelCount; i++) {
-		m_voxel.push_back(a_voxel.at(i)); 
-	}
+	m_world.ImportVoxel(a_voxel);
 }
 
-void Scene::OverwriteVertsAndIndices(std::vector<Vertex>& a_vertices, std::vector<uint32_t>& a_indices)
+void Scene::OverwriteVertsAndIndices(std::vector<Vertex>& a_vertices, std::vector<uint32_t>& a_indices, const MeshingMode a_mode)
 {
 	a_vertices.clear();
 	a_indices.clear();
-	int voxelCount = m_voxel.size();
 	
-	for (int i = 0; i < voxelCount; i++) {
-		uint32_t vertexOffset = a_vertices.size();
+	AddVertsAndIndices(a_vertices, a_indices, a_mode);
+}
 
-		std::vector<Vertex> vertices = m_voxel.at(i).GetVertices();
-		std::vector<uint32_t> indices = Voxel::GetIndices();
-		for (int j = 0; j < VERTEX_COUNT_PER_VOXEL; j++) {
-			a_vertices.emplace_back(vertices.at(j));
-		}
-		for (int k = 0; k < INDICES_COUNT_PER_VOXEL; k++) {
-			a_indices.emplace_back(indices.at(k) + vertexOffset);
-		}
+void Scene::OverwriteVertsAndIndicesMT(std::vector<Vertex>& a_vertices, std::vector<uint32_t>& a_indices, const MeshingMode a_mode)
+{
+	MeshLayout layout = PrepareMesh(a_mode);
+
+	a_vertices.resize(layout.vertexCount);
+	a_indices.resize(layout.indexCount);
+
+	WriteMesh(layout, a_vertices.data(), a_indices.data());
+}
+
+void Scene::AddVertsAndIndices(std::vector<Vertex>& a_vertices, std::vector<uint32_t>& a_indices, const MeshingMode a_mode)
+{
+	for (const auto& chunk : m_world.GetChunks()) {
+		ChunkMesher::MeshChunk(m_world, chunk.second, a_mode, a_vertices, a_indices);
 	}
 }
 
-void Scene::OverwriteVertsAndIndicesMT(std::vector<Vertex>& a_vertices, std::vector<uint32_t>& a_indices)
+void Scene::OverwriteChunkMeshesMT(std::vector<PackedVertex>& a_vertices, std::vector<uint32_t>& a_indices, std::vector<ChunkDrawRange>& a_ranges, const MeshingMode a_mode)
 {
-	a_vertices.clear();
-	a_indices.clear();
-	float voxelCount = m_voxel.size();
+	MeshLayout layout = PrepareMesh(a_mode);
 
-	int voxelPerThreadGroup = std::ceil(voxelCount / NUMBER_OF_THREADS);
-	
-	std::vector<std::thread> threads;
-	std::vector<std::vector<Vertex>*> vertexValues;
-	std::vector<std::vector<uint32_t>*> indicesValues;
-
-
-	for (int i = 0; i < NUMBER_OF_THREADS; i++)
-	{
-		int start = i * voxelPerThreadGroup;
-		int end;
-
-		if (voxelCount - start > voxelPerThreadGroup) 
-		{ 
-			end = start + voxelPerThreadGroup - 1; 
-		} 
-		else
-		{ 
-			end = voxelCount - 1;
-		}
+	a_vertices.resize(layout.vertexCount);
+	a_indices.resize(layout.indexCount);
 
-		vertexValues.emplace_back(new std::vector<Vertex>);
-		indicesValues.emplace_back(new std::vector<uint32_t>);
-		threads.emplace_back(DoWork, vertexValues.at(i), indicesValues.at(i), start, end, m_voxel);
-	}
+	WriteMesh(layout, a_vertices.data(), a_indices.data());
+	a_ranges = GetDrawRanges(layout);
+}
 
-	for (int j = 0; j < NUMBER_OF_THREADS; j++) 
-	{
-		threads.at(j).join();
-		a_vertices.insert(a_vertices.end(), vertexValues.at(j)->begin(), vertexValues.at(j)->end());
-		a_indices.insert(a_indices.end(), indicesValues.at(j)->begin(), indicesValues.at(j)->end());
-	}
-	
+MeshLayout Scene::PrepareMesh(const MeshingMode a_mode)
+{
+	return PrepareMesh(a_mode, m_world.GetChunkCoords());
 }
 
-void Scene::AddVertsAndIndices(std::vector<Vertex>& a_vertices, std::vector<uint32_t>& a_indices)
+MeshLayout Scene::PrepareMesh(const MeshingMode a_mode, const std::vector<glm::ivec3>& a_chunkCoords)
 {
-	int voxelCount = m_voxel.size();
+	MeshLayout layout;
+	layout.mode = a_mode;
+	layout.chunkCoords = a_chunkCoords;
+	layout.ranges.resize(layout.chunkCoords.size());
+	layout.vertexCounts.resize(layout.chunkCoords.size());
 
-	for (int i = 0; i < voxelCount; i++) {
-		uint32_t vertexOffset = a_vertices.size();
+	//first pass, every task only counts what its chunks will write
+	TaskGroup group;
+	JobSystem::GetInstance().ParallelFor(group, static_cast<int>(layout.chunkCoords.size()), CHUNKS_PER_MESH_TASK, [&](int a_begin, int a_end)
+		{
+			for (int c = a_begin; c < a_end; c++) {
+				CountMeshOutput count;
 
-		std::vector<Vertex> vertices = m_voxel.at(i).GetVertices();
-		std::vector<uint32_t> indices = Voxel::GetIndices();
-		for (int j = 0; j < VERTEX_COUNT_PER_VOXEL; j++) {
-			a_vertices.emplace_back(vertices.at(j));
-		}
-		for (int k = 0; k < INDICES_COUNT_PER_VOXEL; k++) {
-			a_indices.emplace_back(indices.at(k) + vertexOffset);
-		}
+				const VoxelChunk* chunk = m_world.FindChunk(layout.chunkCoords[c]);
+				if (chunk)
+				{
+					ChunkMesher::MeshChunk(m_world, *chunk, a_mode, count);
+				}
+
+				layout.ranges[c].coord = layout.chunkCoords[c];
+				layout.ranges[c].indexCount = count.indexCount;
+				layout.vertexCounts[c] = count.vertexCount;
+			}
+		});
+	group.Wait();
+
+	//exclusive prefix sum, every chunk gets the place right behind the previous one
+	for (size_t c = 0; c < layout.ranges.size(); c++) {
+		layout.ranges[c].firstIndex = layout.indexCount;
+		layout.ranges[c].vertexOffset = layout.vertexCount;
+
+		layout.indexCount += layout.ranges[c].indexCount;
+		layout.vertexCount += layout.vertexCounts[c];
 	}
+
+	return layout;
 }
 
+void Scene::WriteMesh(const MeshLayout& a_layout, Vertex* a_vertices, uint32_t* a_indices)
+{
+	//second pass, the tasks write straight into their own part of the destination
+	TaskGroup group;
+	JobSystem::GetInstance().ParallelFor(group, static_cast<int>(a_layout.chunkCoords.size()), CHUNKS_PER_MESH_TASK, [&](int a_begin, int a_end)
+		{
+			for (int c = a_begin; c < a_end; c++) {
+				const ChunkDrawRange& range = a_layout.ranges[c];
+
+				const VoxelChunk* chunk = m_world.FindChunk(a_layout.chunkCoords[c]);
+				if (!chunk)
+				{
+					continue;
+				}
 
-void Scene::GenerateRandomVoxelMass(int a_voxelCount, const glm::vec3& a_start, const glm::vec3& a_end, const float& a_size)
+				MappedMeshOutput<Vertex> output;
+				output.vertices = a_vertices + range.vertexOffset;
+				output.indices = a_indices + range.firstIndex;
+				output.baseVertex = range.vertexOffset;
+
+				ChunkMesher::MeshChunk(m_world, *chunk, a_layout.mode, output);
+			}
+		});
+	group.Wait();
+}
+
+void Scene::WriteMesh(const MeshLayout& a_layout, PackedVertex* a_vertices, uint32_t* a_indices)
 {
-	srand(std::time(nullptr));
+	TaskGroup group;
+	JobSystem::GetInstance().ParallelFor(group, static_cast<int>(a_layout.chunkCoords.size()), CHUNKS_PER_MESH_TASK, [&](int a_begin, int a_end)
+		{
+			for (int c = a_begin; c < a_end; c++) {
+				const ChunkDrawRange& range = a_layout.ranges[c];
 
-	for (a_voxelCount; a_voxelCount > 0; a_voxelCount--) {
-		glm::vec3 pos;
-		pos.x = Randomizer::RandomIntAsFloatBetween(a_start.x, a_end.x);
-		pos.y = Randomizer::RandomIntAsFloatBetween(a_start.y, a_end.y);
-		pos.z = Randomizer::RandomIntAsFloatBetween(a_start.z, a_end.z);
+				const VoxelChunk* chunk = m_world.FindChunk(a_layout.chunkCoords[c]);
+				if (!chunk)
+				{
+					continue;
+				}
 
-		glm::vec3 col;
-		col.x = Randomizer::RandomFloatBetween01();
-		col.y =	Randomizer::RandomFloatBetween01();
-		col.z = Randomizer::RandomFloatBetween01();
+				//packed indices stay local to the chunk, the draw adds vertexOffset
+				MappedMeshOutput<PackedVertex> output;
+				output.vertices = a_vertices + range.vertexOffset;
+				output.indices = a_indices + range.firstIndex;
+				output.baseVertex = 0;
 
-		AddVoxel(Voxel(pos, col, a_size)); 
-	}
+				ChunkMesher::MeshChunk(m_world, *chunk, a_layout.mode, output);
+			}
+		});
+	group.Wait();
 }
 
-void DoWork(std::vector<Vertex>* a_vertices, std::vector<uint32_t>* a_indices, const int& a_start, const int& a_end, std::vector<Voxel>&& a_voxel)
+void Scene::WriteMesh(const MeshLayout& a_layout, const std::vector<ChunkMeshTarget>& a_targets)
 {
+	TaskGroup group;
+	JobSystem::GetInstance().ParallelFor(group, static_cast<int>(a_layout.chunkCoords.size()), CHUNKS_PER_MESH_TASK, [&](int a_begin, int a_end)
+		{
+			for (int c = a_begin; c < a_end; c++) {
+				const ChunkMeshTarget& target = a_targets[c];
+
+				const VoxelChunk* chunk = m_world.FindChunk(a_layout.chunkCoords[c]);
+				if (!chunk || !target.vertices)
+				{
+					continue;
+				}
+
+				//every chunk starts at the beginning of its own memory
+				if (target.shortIndices)
+				{
+					MappedMeshOutput<PackedVertex, uint16_t> output;
+					output.vertices = target.vertices;
+					output.indices = target.shortIndices;
+					output.baseVertex = 0;
 
-	for (int i = a_start; i <= a_end; i++)
-	{
-		uint32_t verticesVoxelOffset = i * VERTEX_COUNT_PER_VOXEL;
-		uint32_t indicesVoxelOffset = i * INDICES_COUNT_PER_VOXEL;
+					ChunkMesher::MeshChunk(m_world, *chunk, a_layout.mode, output);
+					continue;
+				}
 
-		std::vector<Vertex> vertices = a_voxel.at(i).GetVertices();
-		std::vector<uint32_t> indices = Voxel::GetIndices();
+				MappedMeshOutput<PackedVertex> output;
+				output.vertices = target.vertices;
+				output.indices = target.indices;
+				output.baseVertex = 0;
 
-		for (int j = 0; j < VERTEX_COUNT_PER_VOXEL; j++)
+				ChunkMesher::MeshChunk(m_world, *chunk, a_layout.mode, output);
+			}
+		});
+	group.Wait();
+}
+
+std::vector<ChunkDrawRange> Scene::GetDrawRanges(const MeshLayout& a_layout)
+{
+	std::vector<ChunkDrawRange> ranges;
+
+	for (const ChunkDrawRange& range : a_layout.ranges) {
+		if (range.indexCount > 0) 
 		{
-			a_vertices->emplace_back(vertices.at(j));
+			ranges.emplace_back(range);
 		}
-		for (int k = 0; k < INDICES_COUNT_PER_VOXEL; k++)
+	}
+
+	return ranges;
+}
+
+void Scene::OverwriteInstances(std::vector<VoxelInstance>& a_instances)
+{
+	//every chunk knows its solid count, so each task can write straight to its own part of the output
+	std::vector<const VoxelChunk*> chunks;
+	std::vector<size_t> firstInstance;
+	size_t instanceCount = 0;
+
+	for (const auto& entry : m_world.GetChunks()) {
+		chunks.emplace_back(&entry.second);
+		firstInstance.emplace_back(instanceCount);
+		instanceCount += entry.second.GetSolidCount();
+	}
+
+	a_instances.resize(instanceCount);
+
+	float voxelSize = m_world.GetVoxelSize();
+
+	TaskGroup group;
+	JobSystem::GetInstance().ParallelFor(group, static_cast<int>(chunks.size()), CHUNKS_PER_MESH_TASK, [&](int a_begin, int a_end)
 		{
-			a_indices->emplace_back(indices.at(k) + verticesVoxelOffset);
+			for (int c = a_begin; c < a_end; c++) {
+				glm::ivec3 origin = chunks[c]->GetOrigin();
+				const std::vector<uint32_t>& materials = chunks[c]->GetMaterials();
+				size_t next = firstInstance[c];
+
+				for (int i = 0; i < CHUNK_VOLUME; i++) {
+					if (materials[i] == EMPTY_MATERIAL) 
+					{
+						continue;
+					}
+
+					glm::ivec3 cell = origin + glm::ivec3(i % CHUNK_SIZE, (i / CHUNK_SIZE) % CHUNK_SIZE, i / CHUNK_AREA);
+					a_instances[next++] = { glm::vec3(cell), voxelSize, materials[i] };
+				}
+			}
+		});
+	group.Wait();
+}
+
+void Scene::EditSphere(const glm::vec3& a_center, const float a_radius, const uint32_t a_material)
+{
+	glm::ivec3 minCell = VoxelWorld::CellFromPosition(a_center - glm::vec3(a_radius));
+	glm::ivec3 maxCell = VoxelWorld::CellFromPosition(a_center + glm::vec3(a_radius));
+
+	for (int z = minCell.z; z <= maxCell.z; z++) {
+		for (int y = minCell.y; y <= maxCell.y; y++) {
+			for (int x = minCell.x; x <= maxCell.x; x++) {
+				glm::ivec3 cell(x, y, z);
+
+				if (glm::length(glm::vec3(cell) - a_center) > a_radius) 
+				{
+					continue;
+				}
+
+				if (a_material == EMPTY_MATERIAL) 
+				{
+					m_world.RemoveVoxel(cell);
+				}
+				else
+				{
+					m_world.SetVoxel(cell, a_material);
+				}
+			}
 		}
 	}
 }
+
+void Scene::GenerateRandomVoxelMass(int a_voxelCount, const glm::vec3& a_start, const glm::vec3& a_end, const float& a_size)
+{
+	//rand() is shared state, so every task draws its voxel range from its own generator 
+	//only the insertion into the world stays serial
+	unsigned int seed = std::time(nullptr);
+
+	std::vector<glm::ivec3> cells(std::max(a_voxelCount, 0));
+	std::vector<uint32_t> materials(cells.size());
+
+	TaskGroup group;
+	JobSystem::GetInstance().ParallelFor(group, static_cast<int>(cells.size()), VOXELS_PER_GENERATION_TASK, [&](int a_first, int a_last)
+		{
+			std::minstd_rand generator(seed + a_first);
+
+			for (int i = a_first; i < a_last; i++) {
+				glm::vec3 pos;
+				pos.x = Randomizer::RandomIntAsFloatBetween(generator, a_start.x, a_end.x);
+				pos.y = Randomizer::RandomIntAsFloatBetween(generator, a_start.y, a_end.y);
+				pos.z = Randomizer::RandomIntAsFloatBetween(generator, a_start.z, a_end.z);
+
+				glm::vec3 col;
+				col.x = Randomizer::RandomFloatBetween01(generator);
+				col.y = Randomizer::RandomFloatBetween01(generator);
+				col.z = Randomizer::RandomFloatBetween01(generator);
+
+				cells[i] = VoxelWorld::CellFromPosition(pos);
+				materials[i] = VoxelWorld::PackColor(col);
+			}
+		});
+	group.Wait();
+
+	for (size_t i = 0; i < cells.size(); i++) {
+		m_world.SetVoxel(cells[i], materials[i]);
+	}
+
+	m_world.SetVoxelSize(a_size);
+}
@@ -3,38 +3,77 @@
 
 #include "MyStructs.h"
 #include "Voxel.h"
+#include "VoxelWorld.h"
+#include "ChunkMesher.h"
 #include "Camera.h"
 #include <ctime>
 #include "Randomizer.h"
-#include <thread>
+#include "JobSystem.h"
+#include <functional>
 
-const int NUMBER_OF_THREADS = 3;
+// Granularity of the tasks handed to the JobSystem
+const int CHUNKS_PER_MESH_TASK = 1;
+const int VOXELS_PER_GENERATION_TASK = 65536;
+
+// Sizes and offsets of a two pass mesh, filled by Scene::PrepareMesh and consumed by Scene::WriteMesh
+struct MeshLayout
+{
+	MeshingMode mode = MeshingMode::NAIVE;
+	std::vector<glm::ivec3> chunkCoords;
+	std::vector<ChunkDrawRange> ranges;		// one per chunk coord, vertexOffset is the first vertex of the chunk
+	std::vector<uint32_t> vertexCounts;		// one per chunk coord, chunks that do not exist anymore count zero
+	uint32_t vertexCount = 0;
+	uint32_t indexCount = 0;
+};
+
+// Where WriteMesh puts one chunk when every chunk has memory of its own, e.g. its range of the chunk mesh arena
+struct ChunkMeshTarget
+{
+	PackedVertex* vertices = nullptr;		// chunks without a target are skipped
+	uint32_t* indices = nullptr;
+	uint16_t* shortIndices = nullptr;		// used instead of indices if set
+};
 
 
 class Scene
 {
 private:
 	Camera m_Camera;
-	std::vector<Voxel> m_voxel;
+	VoxelWorld m_world;
 
 public:
 	Scene();
 	Scene(Camera& a_camera);
 
 	Camera& GetCamera();
+	VoxelWorld& GetWorld();
 	std::vector<Voxel> GetVoxel();
+	size_t GetVoxelCount();
 
 	void SetVoxel(const std::vector<Voxel>& a_voxel);
 	void AddVoxel(const Voxel& a_voxel);
 	void AddVoxel(const std::vector<Voxel>& a_voxel);
 
-	void OverwriteVertsAndIndices(std::vector<Vertex>& a_vertices, std::vector<uint32_t>& a_indices);
-	void OverwriteVertsAndIndicesMT(std::vector<Vertex>& a_vertices, std::vector<uint32_t>& a_indices);
-	void AddVertsAndIndices(std::vector<Vertex>& a_vertices, std::vector<uint32_t>& a_indices);
+	void OverwriteVertsAndIndices(std::vector<Vertex>& a_vertices, std::vector<uint32_t>& a_indices, const MeshingMode a_mode = MeshingMode::NAIVE);
+	void OverwriteVertsAndIndicesMT(std::vector<Vertex>& a_vertices, std::vector<uint32_t>& a_indices, const MeshingMode a_mode = MeshingMode::NAIVE);
+	void AddVertsAndIndices(std::vector<Vertex>& a_vertices, std::vector<uint32_t>& a_indices, const MeshingMode a_mode = MeshingMode::NAIVE);
+	void OverwriteChunkMeshesMT(std::vector<PackedVertex>& a_vertices, std::vector<uint32_t>& a_indices, std::vector<ChunkDrawRange>& a_ranges, const MeshingMode a_mode = MeshingMode::NAIVE);
+	void OverwriteInstances(std::vector<VoxelInstance>& a_instances);
+
+	// Two pass meshing: count every chunk, prefix sum the offsets, then write in parallel 
+	// into memory of layout.vertexCount vertices and layout.indexCount indices (e.g. a mapped staging buffer)
+	MeshLayout PrepareMesh(const MeshingMode a_mode);
+	MeshLayout PrepareMesh(const MeshingMode a_mode, const std::vector<glm::ivec3>& a_chunkCoords);
+	void WriteMesh(const MeshLayout& a_layout, Vertex* a_vertices, uint32_t* a_indices);
+	void WriteMesh(const MeshLayout& a_layout, PackedVertex* a_vertices, uint32_t* a_indices);
+	// One target per chunk coord of a_layout
+	void WriteMesh(const MeshLayout& a_layout, const std::vector<ChunkMeshTarget>& a_targets);
+	static std::vector<ChunkDrawRange> GetDrawRanges(const MeshLayout& a_layout);
+
+	// Fills (or with EMPTY_MATERIAL carves) every cell whose center lies inside the sphere, the touched chunks become dirty
+	void EditSphere(const glm::vec3& a_center, const float a_radius, const uint32_t a_material);
 
 	void GenerateRandomVoxelMass(int a_voxelCount, const glm::vec3& a_start, const glm::vec3& a_end, const float& a_size);
 	
 };
-void DoWork(std::vector<Vertex>* a_vertices, std::vector<uint32_t>* a_indices, const int& a_start, const int& a_end, std::vector<Voxel>&& a_voxel);
 #endif // !SCENE_H
-
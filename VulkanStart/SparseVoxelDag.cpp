@@ -0,0 +1,138 @@
+#include "SparseVoxelDag.h"
+
+#include <iostream>
+#include <chrono>
+#include <cstring>
+
+//the headers are read as the first uints of the same buffer
+const size_t DAG_OCTREE_HEADER_WORDS = sizeof(SvoHeader) / sizeof(uint32_t);
+const size_t DAG_HEADER_WORDS = sizeof(DagHeader) / sizeof(uint32_t);
+
+static uint32_t CountChildren(const uint32_t a_childMask)
+{
+	uint32_t count = 0;
+	for (int octant = 0; octant < 8; octant++) {
+		count += (a_childMask >> octant) & 1u;
+	}
+	return count;
+}
+
+size_t SparseVoxelDag::NodeHash::operator()(const std::vector<uint32_t>& a_words) const
+{
+	//FNV-1a over the words
+	uint64_t hash = 14695981039346656037ull;
+	for (uint32_t word : a_words) {
+		hash ^= word;
+		hash *= 1099511628211ull;
+	}
+	return static_cast<size_t>(hash);
+}
+
+void SparseVoxelDag::Build(const SparseVoxelOctree& a_octree)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	const SvoHeader& octreeHeader = a_octree.GetHeader();
+	const uint32_t* octreeNodes = a_octree.GetData().data() + DAG_OCTREE_HEADER_WORDS;
+	const uint32_t* octreeColors = octreeNodes + octreeHeader.sections.y;
+
+	m_nodes.clear();
+	m_uniqueNodes.clear();
+	m_mergedNodeCount = 0;
+	m_octreeNodeCount = octreeHeader.sections.x;
+	m_octreeNodeBytes = octreeHeader.sections.x * sizeof(SvoNode);
+
+	uint32_t root = 0;
+	uint32_t voxelCount = 0;
+	if (octreeHeader.sections.x > 0)
+	{
+		root = MergeNode(octreeNodes, 0, voxelCount);
+	}
+
+	//only needed while merging
+	m_uniqueNodes.clear();
+
+	m_header = DagHeader{};
+	m_header.origin = octreeHeader.origin;
+	m_header.sections = glm::uvec4(root, static_cast<uint32_t>(m_nodes.size()), octreeHeader.sections.z, static_cast<uint32_t>(m_nodes.size()));
+	m_header.voxelSize = octreeHeader.voxelSize;
+
+	//the octree already stores its colours in the depth first order of its voxels
+	m_data.assign(DAG_HEADER_WORDS + m_nodes.size() + octreeHeader.sections.z, 0);
+	std::memcpy(m_data.data(), &m_header, sizeof(DagHeader));
+	std::memcpy(m_data.data() + DAG_HEADER_WORDS, m_nodes.data(), m_nodes.size() * sizeof(uint32_t));
+	std::memcpy(m_data.data() + DAG_HEADER_WORDS + m_nodes.size(), octreeColors, octreeHeader.sections.z * sizeof(uint32_t));
+
+	m_buildTime = std::chrono::duration<float, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+const std::vector<uint32_t>& SparseVoxelDag::GetData() const
+{
+	return m_data;
+}
+
+const DagHeader& SparseVoxelDag::GetHeader() const
+{
+	return m_header;
+}
+
+void SparseVoxelDag::PrintStats() const
+{
+	size_t nodeBytes = m_nodes.size() * sizeof(uint32_t);
+
+	std::cout << "" << std::endl;
+	std::cout << "Sparse voxel dag built: " << m_octreeNodeCount << " octree nodes merged into " << m_octreeNodeCount - m_mergedNodeCount << ", geometry "
+		<< m_octreeNodeBytes / 1024 << " KB -> " << nodeBytes / 1024 << " KB";
+
+	if (nodeBytes > 0)
+	{
+		std::cout << " (" << static_cast<float>(m_octreeNodeBytes) / nodeBytes << "x)";
+	}
+
+	std::cout << ", colours " << m_header.sections.z * sizeof(uint32_t) / 1024 << " KB, took " << m_buildTime << " ms" << std::endl;
+}
+
+uint32_t SparseVoxelDag::MergeNode(const uint32_t* a_octreeNodes, const uint32_t a_node, uint32_t& a_voxelCount)
+{
+	uint32_t childMask = a_octreeNodes[a_node * 2];
+	uint32_t firstChild = a_octreeNodes[a_node * 2 + 1];
+	uint32_t childCount = CountChildren(childMask);
+
+	//mask, children, voxels before the second to last child
+	std::vector<uint32_t> words(1, childMask);
+
+	if (childMask & SVO_LEAF_PARENT)
+	{
+		a_voxelCount = childCount;
+	}
+	else
+	{
+		words.resize(2 * childCount);
+		a_voxelCount = 0;
+
+		//children first, a node can only be merged once its children are
+		for (uint32_t c = 0; c < childCount; c++) {
+			if (c > 0)
+			{
+				words[1 + childCount + c - 1] = a_voxelCount;
+			}
+
+			uint32_t childVoxelCount = 0;
+			words[1 + c] = MergeNode(a_octreeNodes, firstChild + c, childVoxelCount);
+			a_voxelCount += childVoxelCount;
+		}
+	}
+
+	auto unique = m_uniqueNodes.find(words);
+	if (unique != m_uniqueNodes.end())
+	{
+		m_mergedNodeCount++;
+		return unique->second;
+	}
+
+	uint32_t node = static_cast<uint32_t>(m_nodes.size());
+	m_nodes.insert(m_nodes.end(), words.begin(), words.end());
+	m_uniqueNodes.emplace(std::move(words), node);
+
+	return node;
+}
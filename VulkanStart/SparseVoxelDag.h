@@ -0,0 +1,46 @@
+#ifndef SPARSE_VOXEL_DAG_H
+#define SPARSE_VOXEL_DAG_H
+
+#include "SparseVoxelOctree.h"
+#include "MyStructs.h"
+
+#include <unordered_map>
+#include <vector>
+#include <cstdint>
+
+// Sparse voxel octree with identical subtrees merged into one (a directed acyclic graph) for the compute ray tracer.
+// The nodes only describe the geometry, the colours are a separate stream in the depth first order of the voxels in the octree.
+// A node stores how many voxels come before each of its children, so a ray finds the colour of a voxel by adding these up
+// on its way down and subtrees of the same shape are shared no matter their colours.
+class SparseVoxelDag
+{
+public:
+	// Merges the subtrees of a_octree bottom up, a_octree is not needed afterwards
+	void Build(const SparseVoxelOctree& a_octree);
+
+	const std::vector<uint32_t>& GetData() const;
+	const DagHeader& GetHeader() const;
+
+	void PrintStats() const;
+
+private:
+	struct NodeHash
+	{
+		size_t operator()(const std::vector<uint32_t>& a_words) const;
+	};
+
+	// Returns the dag node of the octree node a_node and the voxels below it
+	uint32_t MergeNode(const uint32_t* a_octreeNodes, const uint32_t a_node, uint32_t& a_voxelCount);
+
+	std::vector<uint32_t> m_nodes;
+	std::unordered_map<std::vector<uint32_t>, uint32_t, NodeHash> m_uniqueNodes;
+
+	DagHeader m_header{};
+	std::vector<uint32_t> m_data;
+
+	size_t m_octreeNodeCount = 0;
+	size_t m_octreeNodeBytes = 0;
+	size_t m_mergedNodeCount = 0;
+	float m_buildTime = 0.0f;		// ms
+};
+#endif // !SPARSE_VOXEL_DAG_H
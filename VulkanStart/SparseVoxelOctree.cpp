@@ -0,0 +1,327 @@
+#include "SparseVoxelOctree.h"
+#include "JobSystem.h"
+
+#include <iostream>
+#include <chrono>
+#include <cstring>
+#include <algorithm>
+#include <unordered_set>
+
+//the header is read as the first uints of the same buffer
+const size_t SVO_HEADER_WORDS = sizeof(SvoHeader) / sizeof(uint32_t);
+
+//neighbours of a chunk in the order -x, +x, -y, +y, -z, +z
+const glm::ivec3 SVO_NEIGHBOUR_OFFSETS[6] = {
+	glm::ivec3(-1, 0, 0), glm::ivec3(1, 0, 0),
+	glm::ivec3(0, -1, 0), glm::ivec3(0, 1, 0),
+	glm::ivec3(0, 0, -1), glm::ivec3(0, 0, 1)
+};
+
+static glm::ivec3 OctantOffset(const int a_octant)
+{
+	return glm::ivec3(a_octant & 1, (a_octant >> 1) & 1, (a_octant >> 2) & 1);
+}
+
+// Writes a_node at a_level (cube of 1 << a_level cells at a_position in units of that cube) and below it,
+// a_levels[l] flags the cubes of 1 << l cells that hold a surface voxel
+static void WriteChunkNode(const std::vector<uint8_t>* a_levels, const std::vector<uint32_t>& a_materials, const uint32_t a_node, const int a_level,
+	const glm::ivec3& a_position, std::vector<SvoNode>& a_nodes, std::vector<uint32_t>& a_colors)
+{
+	int childLevel = a_level - 1;
+	int childDim = CHUNK_SIZE >> childLevel;
+
+	uint32_t childMask = 0;
+	int childCount = 0;
+	for (int octant = 0; octant < 8; octant++) {
+		glm::ivec3 child = a_position * 2 + OctantOffset(octant);
+		if (a_levels[childLevel][child.x + child.y * childDim + child.z * childDim * childDim] != 0)
+		{
+			childMask |= 1u << octant;
+			childCount++;
+		}
+	}
+
+	if (childLevel == 0)
+	{
+		a_nodes[a_node].childMask = childMask | SVO_LEAF_PARENT;
+		a_nodes[a_node].firstChild = static_cast<uint32_t>(a_colors.size());
+
+		for (int octant = 0; octant < 8; octant++) {
+			if (childMask & (1u << octant))
+			{
+				glm::ivec3 cell = a_position * 2 + OctantOffset(octant);
+				a_colors.push_back(a_materials[VoxelChunk::ToIndex(cell.x, cell.y, cell.z)]);
+			}
+		}
+		return;
+	}
+
+	//the children are placed next to each other before any of them is filled
+	uint32_t firstChild = static_cast<uint32_t>(a_nodes.size());
+	a_nodes.resize(a_nodes.size() + childCount);
+	a_nodes[a_node].childMask = childMask;
+	a_nodes[a_node].firstChild = firstChild;
+
+	uint32_t child = firstChild;
+	for (int octant = 0; octant < 8; octant++) {
+		if (childMask & (1u << octant))
+		{
+			WriteChunkNode(a_levels, a_materials, child++, childLevel, a_position * 2 + OctantOffset(octant), a_nodes, a_colors);
+		}
+	}
+}
+
+void SparseVoxelOctree::Build(const VoxelWorld& a_world)
+{
+	m_subtrees.clear();
+
+	BuildChunks(a_world, a_world.GetChunkCoords());
+	m_worldVoxelCount = a_world.GetVoxelCount();
+	Serialise(a_world.GetVoxelSize());
+}
+
+void SparseVoxelOctree::Update(const VoxelWorld& a_world, const std::vector<glm::ivec3>& a_changedChunks)
+{
+	std::unordered_set<glm::ivec3, ChunkCoordHash> chunks;
+	for (const glm::ivec3& coord : a_changedChunks) {
+		chunks.insert(coord);
+		for (const glm::ivec3& offset : SVO_NEIGHBOUR_OFFSETS) {
+			chunks.insert(coord + offset);
+		}
+	}
+
+	BuildChunks(a_world, std::vector<glm::ivec3>(chunks.begin(), chunks.end()));
+	m_worldVoxelCount = a_world.GetVoxelCount();
+	Serialise(a_world.GetVoxelSize());
+}
+
+const std::vector<uint32_t>& SparseVoxelOctree::GetData() const
+{
+	return m_data;
+}
+
+const SvoHeader& SparseVoxelOctree::GetHeader() const
+{
+	return m_header;
+}
+
+void SparseVoxelOctree::PrintStats() const
+{
+	std::cout << "" << std::endl;
+	std::cout << "Sparse voxel octree built: " << m_header.sections.x << " nodes, " << m_header.origin.w << " levels, " << m_header.sections.z << " of "
+		<< m_worldVoxelCount << " voxels on the surface, " << m_data.size() * sizeof(uint32_t) / 1024 << " KB, " << m_rebuiltChunks << " chunks rebuilt in "
+		<< m_buildTime << " ms, serialised in " << m_serialiseTime << " ms" << std::endl;
+}
+
+void SparseVoxelOctree::BuildChunks(const VoxelWorld& a_world, const std::vector<glm::ivec3>& a_chunks)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	//the map is only changed here, the tasks below fill subtrees that already exist
+	std::vector<std::pair<const VoxelChunk*, ChunkSubtree*>> work;
+	for (const glm::ivec3& coord : a_chunks) {
+		const VoxelChunk* chunk = a_world.FindChunk(coord);
+		if (!chunk || chunk->IsEmpty())
+		{
+			m_subtrees.erase(coord);
+			continue;
+		}
+
+		work.emplace_back(chunk, &m_subtrees[coord]);
+	}
+
+	TaskGroup group;
+	JobSystem::GetInstance().ParallelFor(group, static_cast<int>(work.size()), CHUNKS_PER_SVO_TASK, [&](int a_begin, int a_end)
+		{
+			for (int c = a_begin; c < a_end; c++) {
+				BuildChunk(a_world, *work[c].first, *work[c].second);
+			}
+		});
+	group.Wait();
+
+	m_rebuiltChunks = work.size();
+	m_buildTime = std::chrono::duration<float, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+void SparseVoxelOctree::BuildChunk(const VoxelWorld& a_world, const VoxelChunk& a_chunk, ChunkSubtree& a_subtree) const
+{
+	a_subtree.nodes.clear();
+	a_subtree.colors.clear();
+
+	const std::vector<uint32_t>& materials = a_chunk.GetMaterials();
+
+	const VoxelChunk* neighbours[6];
+	for (int n = 0; n < 6; n++) {
+		neighbours[n] = a_world.FindChunk(a_chunk.GetCoord() + SVO_NEIGHBOUR_OFFSETS[n]);
+	}
+
+	//cells one step outside the chunk are looked up in the neighbour chunk, a missing neighbour is empty
+	auto isSolid = [&](const int a_x, const int a_y, const int a_z)
+		{
+			if (a_x >= 0 && a_x < CHUNK_SIZE && a_y >= 0 && a_y < CHUNK_SIZE && a_z >= 0 && a_z < CHUNK_SIZE)
+			{
+				return materials[VoxelChunk::ToIndex(a_x, a_y, a_z)] != EMPTY_MATERIAL;
+			}
+
+			int neighbour = a_x < 0 ? 0 : a_x >= CHUNK_SIZE ? 1 : a_y < 0 ? 2 : a_y >= CHUNK_SIZE ? 3 : a_z < 0 ? 4 : 5;
+
+			return neighbours[neighbour] != nullptr &&
+				neighbours[neighbour]->IsSolid((a_x + CHUNK_SIZE) % CHUNK_SIZE, (a_y + CHUNK_SIZE) % CHUNK_SIZE, (a_z + CHUNK_SIZE) % CHUNK_SIZE);
+		};
+
+	//level 0 flags the surface voxels, level l whether a cube of 1 << l cells holds any of them
+	std::vector<uint8_t> levels[SVO_CHUNK_LEVELS + 1];
+	levels[0].assign(CHUNK_VOLUME, 0);
+
+	for (int z = 0; z < CHUNK_SIZE; z++) {
+		for (int y = 0; y < CHUNK_SIZE; y++) {
+			for (int x = 0; x < CHUNK_SIZE; x++) {
+				if (materials[VoxelChunk::ToIndex(x, y, z)] == EMPTY_MATERIAL)
+				{
+					continue;
+				}
+
+				bool hidden = isSolid(x - 1, y, z) && isSolid(x + 1, y, z) && isSolid(x, y - 1, z) &&
+					isSolid(x, y + 1, z) && isSolid(x, y, z - 1) && isSolid(x, y, z + 1);
+				levels[0][VoxelChunk::ToIndex(x, y, z)] = hidden ? 0 : 1;
+			}
+		}
+	}
+
+	for (int l = 1; l <= SVO_CHUNK_LEVELS; l++) {
+		int dim = CHUNK_SIZE >> l;
+		int childDim = dim * 2;
+		levels[l].assign(static_cast<size_t>(dim) * dim * dim, 0);
+
+		for (int z = 0; z < dim; z++) {
+			for (int y = 0; y < dim; y++) {
+				for (int x = 0; x < dim; x++) {
+					uint8_t any = 0;
+					for (int octant = 0; octant < 8; octant++) {
+						glm::ivec3 child = glm::ivec3(x, y, z) * 2 + OctantOffset(octant);
+						any |= levels[l - 1][child.x + child.y * childDim + child.z * childDim * childDim];
+					}
+					levels[l][x + y * dim + z * dim * dim] = any;
+				}
+			}
+		}
+	}
+
+	//a chunk of hidden voxels only has no subtree
+	if (levels[SVO_CHUNK_LEVELS][0] == 0)
+	{
+		return;
+	}
+
+	a_subtree.nodes.resize(1);
+	WriteChunkNode(levels, materials, 0, SVO_CHUNK_LEVELS, glm::ivec3(0), a_subtree.nodes, a_subtree.colors);
+}
+
+void SparseVoxelOctree::Serialise(const float a_voxelSize)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	std::vector<const glm::ivec3*> chunks;
+	for (const auto& entry : m_subtrees) {
+		if (!entry.second.nodes.empty())
+		{
+			chunks.push_back(&entry.first);
+		}
+	}
+
+	//the root is the smallest power of two of chunks that covers all of them
+	glm::ivec3 minChunk(0);
+	int sizeChunks = 1;
+	int levels = SVO_CHUNK_LEVELS;
+	if (!chunks.empty())
+	{
+		minChunk = *chunks.front();
+		glm::ivec3 maxChunk = minChunk;
+		for (const glm::ivec3* coord : chunks) {
+			minChunk = glm::min(minChunk, *coord);
+			maxChunk = glm::max(maxChunk, *coord);
+		}
+
+		glm::ivec3 extent = maxChunk - minChunk + glm::ivec3(1);
+		while (sizeChunks < std::max(std::max(extent.x, extent.y), extent.z)) {
+			sizeChunks *= 2;
+			levels++;
+		}
+	}
+
+	std::vector<SvoNode> nodes;
+	std::vector<uint32_t> colors;
+	if (!chunks.empty())
+	{
+		nodes.resize(1);
+		WriteTopNode(0, minChunk, sizeChunks, chunks, nodes, colors);
+	}
+
+	m_header = SvoHeader{};
+	m_header.origin = glm::ivec4(minChunk * CHUNK_SIZE, levels);
+	m_header.sections = glm::uvec4(static_cast<uint32_t>(nodes.size()), static_cast<uint32_t>(nodes.size() * 2), static_cast<uint32_t>(colors.size()), 0);
+	m_header.voxelSize = glm::vec4(a_voxelSize, 0.0f, 0.0f, 0.0f);
+
+	m_data.assign(SVO_HEADER_WORDS + nodes.size() * 2 + colors.size(), 0);
+	std::memcpy(m_data.data(), &m_header, sizeof(SvoHeader));
+	std::memcpy(m_data.data() + SVO_HEADER_WORDS, nodes.data(), nodes.size() * sizeof(SvoNode));
+	std::memcpy(m_data.data() + SVO_HEADER_WORDS + nodes.size() * 2, colors.data(), colors.size() * sizeof(uint32_t));
+
+	m_serialiseTime = std::chrono::duration<float, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+void SparseVoxelOctree::WriteTopNode(const uint32_t a_node, const glm::ivec3& a_originChunk, const int a_sizeChunks,
+	const std::vector<const glm::ivec3*>& a_chunks, std::vector<SvoNode>& a_nodes, std::vector<uint32_t>& a_colors) const
+{
+	if (a_sizeChunks == 1)
+	{
+		//the chunk root takes the slot of a_node, the rest of the subtree is appended and moved to its new indices
+		const ChunkSubtree& subtree = m_subtrees.at(*a_chunks.front());
+		uint32_t nodeBase = static_cast<uint32_t>(a_nodes.size());
+		uint32_t colorBase = static_cast<uint32_t>(a_colors.size());
+
+		auto relocate = [&](SvoNode a_subtreeNode)
+			{
+				a_subtreeNode.firstChild += (a_subtreeNode.childMask & SVO_LEAF_PARENT) ? colorBase : nodeBase - 1;
+				return a_subtreeNode;
+			};
+
+		for (size_t n = 1; n < subtree.nodes.size(); n++) {
+			a_nodes.push_back(relocate(subtree.nodes[n]));
+		}
+		a_nodes[a_node] = relocate(subtree.nodes[0]);
+		a_colors.insert(a_colors.end(), subtree.colors.begin(), subtree.colors.end());
+		return;
+	}
+
+	int halfSize = a_sizeChunks / 2;
+
+	std::vector<const glm::ivec3*> octants[8];
+	for (const glm::ivec3* coord : a_chunks) {
+		glm::ivec3 offset = *coord - a_originChunk;
+		octants[(offset.x >= halfSize ? 1 : 0) | (offset.y >= halfSize ? 2 : 0) | (offset.z >= halfSize ? 4 : 0)].push_back(coord);
+	}
+
+	uint32_t childMask = 0;
+	int childCount = 0;
+	for (int octant = 0; octant < 8; octant++) {
+		if (!octants[octant].empty())
+		{
+			childMask |= 1u << octant;
+			childCount++;
+		}
+	}
+
+	uint32_t firstChild = static_cast<uint32_t>(a_nodes.size());
+	a_nodes.resize(a_nodes.size() + childCount);
+	a_nodes[a_node].childMask = childMask;
+	a_nodes[a_node].firstChild = firstChild;
+
+	uint32_t child = firstChild;
+	for (int octant = 0; octant < 8; octant++) {
+		if (!octants[octant].empty())
+		{
+			WriteTopNode(child++, a_originChunk + OctantOffset(octant) * halfSize, halfSize, octants[octant], a_nodes, a_colors);
+		}
+	}
+}
@@ -0,0 +1,59 @@
+#ifndef SPARSE_VOXEL_OCTREE_H
+#define SPARSE_VOXEL_OCTREE_H
+
+#include "VoxelWorld.h"
+#include "MyStructs.h"
+
+#include <unordered_map>
+#include <vector>
+#include <cstdint>
+
+// Set in SvoNode::childMask of the nodes one level above the voxels, their firstChild indexes the colours
+const uint32_t SVO_LEAF_PARENT = 0x100;
+// A chunk is one subtree of log2(CHUNK_SIZE) levels below its root
+const int SVO_CHUNK_LEVELS = 5;
+const int CHUNKS_PER_SVO_TASK = 4;
+
+// Sparse voxel octree over the VoxelWorld for the compute ray tracer. Nodes hold an 8 bit child mask and the index of
+// their first child, only existing children are stored, the leaves are the colours of the voxels.
+// Voxels without an empty neighbour can never be seen and are left out, so the memory follows the surface of the world, not its volume.
+// Every chunk is a subtree of its own, built in parallel and kept between builds, so an Update only rebuilds the changed chunks
+// and the few levels above the chunks before the tree is serialised into one uint array that starts with the SvoHeader.
+class SparseVoxelOctree
+{
+public:
+	// Rebuilds every chunk subtree
+	void Build(const VoxelWorld& a_world);
+	// Rebuilds the subtrees of a_changedChunks and their neighbours (their surface may have changed) and serialises the tree again
+	void Update(const VoxelWorld& a_world, const std::vector<glm::ivec3>& a_changedChunks);
+
+	const std::vector<uint32_t>& GetData() const;
+	const SvoHeader& GetHeader() const;
+
+	void PrintStats() const;
+
+private:
+	// Nodes of one chunk, the root first and with chunk local indices
+	struct ChunkSubtree
+	{
+		std::vector<SvoNode> nodes;
+		std::vector<uint32_t> colors;
+	};
+
+	void BuildChunks(const VoxelWorld& a_world, const std::vector<glm::ivec3>& a_chunks);
+	void BuildChunk(const VoxelWorld& a_world, const VoxelChunk& a_chunk, ChunkSubtree& a_subtree) const;
+	void Serialise(const float a_voxelSize);
+	void WriteTopNode(const uint32_t a_node, const glm::ivec3& a_originChunk, const int a_sizeChunks, const std::vector<const glm::ivec3*>& a_chunks,
+		std::vector<SvoNode>& a_nodes, std::vector<uint32_t>& a_colors) const;
+
+	std::unordered_map<glm::ivec3, ChunkSubtree, ChunkCoordHash> m_subtrees;
+
+	SvoHeader m_header{};
+	std::vector<uint32_t> m_data;
+
+	size_t m_worldVoxelCount = 0;
+	float m_buildTime = 0.0f;		// ms, chunk subtrees of the last Build or Update
+	float m_serialiseTime = 0.0f;	// ms
+	size_t m_rebuiltChunks = 0;
+};
+#endif // !SPARSE_VOXEL_OCTREE_H
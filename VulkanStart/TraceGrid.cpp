@@ -0,0 +1,116 @@
+#include "TraceGrid.h"
+#include "JobSystem.h"
+
+#include <iostream>
+#include <chrono>
+#include <cstring>
+#include <algorithm>
+
+//the header is read as the first uints of the same buffer
+const size_t TRACE_GRID_HEADER_WORDS = sizeof(TraceGridHeader) / sizeof(uint32_t);
+
+void TraceGrid::Build(const VoxelWorld& a_world)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	m_header = TraceGridHeader{};
+	m_header.voxelSize = glm::vec4(a_world.GetVoxelSize(), 0.0f, 0.0f, 0.0f);
+
+	std::vector<const VoxelChunk*> chunks;
+	for (const auto& entry : a_world.GetChunks()) {
+		if (!entry.second.IsEmpty())
+		{
+			chunks.push_back(&entry.second);
+		}
+	}
+
+	glm::ivec3 minChunk(0);
+	glm::ivec3 maxChunk(-1);
+	if (!chunks.empty())
+	{
+		minChunk = chunks.front()->GetCoord();
+		maxChunk = minChunk;
+		for (const VoxelChunk* chunk : chunks) {
+			minChunk = glm::min(minChunk, chunk->GetCoord());
+			maxChunk = glm::max(maxChunk, chunk->GetCoord());
+		}
+	}
+
+	glm::ivec3 chunkCounts = maxChunk - minChunk + glm::ivec3(1);
+	size_t slotCount = static_cast<size_t>(chunkCounts.x) * chunkCounts.y * chunkCounts.z;
+
+	//colours of every chunk start where the ones of the chunk before end
+	std::vector<uint32_t> colorBases(chunks.size());
+	uint32_t colorCount = 0;
+	for (size_t c = 0; c < chunks.size(); c++) {
+		colorBases[c] = colorCount;
+		colorCount += static_cast<uint32_t>(chunks[c]->GetSolidCount());
+	}
+
+	m_header.minCell = glm::ivec4(minChunk * CHUNK_SIZE, 0);
+	m_header.chunkCounts = glm::ivec4(chunkCounts, static_cast<int>(chunks.size()));
+	m_header.sections.x = static_cast<uint32_t>(slotCount);
+	m_header.sections.y = m_header.sections.x + static_cast<uint32_t>(chunks.size() * TRACE_CHUNK_WORDS);
+	m_header.sections.z = m_header.sections.y + static_cast<uint32_t>(chunks.size() * TRACE_CHUNK_WORDS);
+
+	m_data.assign(TRACE_GRID_HEADER_WORDS + m_header.sections.z + colorCount, 0);
+	std::memcpy(m_data.data(), &m_header, sizeof(TraceGridHeader));
+
+	uint32_t* slots = m_data.data() + TRACE_GRID_HEADER_WORDS;
+	uint32_t* occupancy = slots + m_header.sections.x;
+	uint32_t* colorOffsets = slots + m_header.sections.y;
+	uint32_t* colors = slots + m_header.sections.z;
+
+	std::fill(slots, slots + slotCount, TRACE_GRID_EMPTY_CHUNK);
+
+	//every task writes the slot, bits and colours of its own chunks only
+	TaskGroup group;
+	JobSystem::GetInstance().ParallelFor(group, static_cast<int>(chunks.size()), CHUNKS_PER_TRACE_TASK, [&](int a_begin, int a_end)
+		{
+			for (int c = a_begin; c < a_end; c++) {
+				const VoxelChunk& chunk = *chunks[c];
+				const std::vector<uint32_t>& materials = chunk.GetMaterials();
+
+				glm::ivec3 slot = chunk.GetCoord() - minChunk;
+				slots[slot.x + slot.y * chunkCounts.x + static_cast<size_t>(slot.z) * chunkCounts.x * chunkCounts.y] = static_cast<uint32_t>(c);
+
+				uint32_t* chunkOccupancy = occupancy + static_cast<size_t>(c) * TRACE_CHUNK_WORDS;
+				uint32_t* chunkColorOffsets = colorOffsets + static_cast<size_t>(c) * TRACE_CHUNK_WORDS;
+				uint32_t colorIndex = colorBases[c];
+
+				//cell index x + y * CHUNK_SIZE + z * CHUNK_AREA, so word w holds the cells w * 32 to w * 32 + 31 and bit x is cell x of the row
+				for (int w = 0; w < TRACE_CHUNK_WORDS; w++) {
+					chunkColorOffsets[w] = colorIndex;
+
+					uint32_t bits = 0;
+					for (int x = 0; x < 32; x++) {
+						uint32_t material = materials[w * 32 + x];
+						if (material != EMPTY_MATERIAL)
+						{
+							bits |= 1u << x;
+							colors[colorIndex++] = material;
+						}
+					}
+					chunkOccupancy[w] = bits;
+				}
+			}
+		});
+	group.Wait();
+
+	auto end = std::chrono::high_resolution_clock::now();
+
+	std::cout << "" << std::endl;
+	std::cout << "Trace grid built: " << chunks.size() << " of " << slotCount << " chunks filled, " << colorCount << " voxels, "
+		<< m_data.size() * sizeof(uint32_t) / (1024 * 1024) << " MB, took " 
+		<< std::chrono::duration<float, std::chrono::milliseconds::period>(end - start).count() << " ms" << std::endl;
+}
+
+const std::vector<uint32_t>& TraceGrid::GetData() const
+{
+	return m_data;
+}
+
+const TraceGridHeader& TraceGrid::GetHeader() const
+{
+	return m_header;
+}
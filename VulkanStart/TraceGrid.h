@@ -0,0 +1,33 @@
+#ifndef TRACE_GRID_H
+#define TRACE_GRID_H
+
+#include "VoxelWorld.h"
+#include "MyStructs.h"
+
+#include <vector>
+#include <cstdint>
+
+// Chunk slot of a chunk without solid cells, the traversal steps over it in one go
+const uint32_t TRACE_GRID_EMPTY_CHUNK = 0xFFFFFFFF;
+// One occupancy bit per cell, a word holds a row of CHUNK_SIZE cells along x
+const int TRACE_CHUNK_WORDS = CHUNK_VOLUME / 32;
+const int CHUNKS_PER_TRACE_TASK = 4;
+
+// Two level grid the compute ray tracer walks with a 3D DDA (Amanatides and Woo): a dense grid of chunk slots over the bounds
+// of the world, and 32^3 occupancy bits for each non empty chunk. Only solid cells store a colour, a cell finds its colour
+// from the offset of its occupancy word plus the solid cells before it in that word.
+// Everything lives in one uint array that starts with the TraceGridHeader and is uploaded as is.
+class TraceGrid
+{
+public:
+	// Rebuilds the grid from a_world, the chunks are filled in parallel on the JobSystem
+	void Build(const VoxelWorld& a_world);
+
+	const std::vector<uint32_t>& GetData() const;
+	const TraceGridHeader& GetHeader() const;
+
+private:
+	TraceGridHeader m_header{};
+	std::vector<uint32_t> m_data;
+};
+#endif // !TRACE_GRID_H
@@ -0,0 +1,664 @@
+#include "UploadRing.h"
+
+#include <iostream>
+#include <stdexcept>
+#include <algorithm>
+#include <cstring>
+
+void UploadRing::Init(VkDevice a_logicalDevice, DeviceMemoryAllocator* a_pAllocator, VkQueue a_transferQueue, const uint32_t a_transferFamily,
+	VkQueue a_graphicsQueue, const uint32_t a_graphicsFamily)
+{
+	m_logicalDevice = a_logicalDevice;
+	m_pAllocator = a_pAllocator;
+	m_transferQueue = a_transferQueue;
+	m_transferFamily = a_transferFamily;
+	m_graphicsQueue = a_graphicsQueue;
+	m_graphicsFamily = a_graphicsFamily;
+	m_ownershipTransfer = a_transferFamily != a_graphicsFamily;
+
+	//batches are recorded on the submitting thread and their command buffers are reused, so they are reset one by one
+	VkCommandPoolCreateInfo poolInfo{};
+	poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT | VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+	poolInfo.queueFamilyIndex = m_transferFamily;
+
+	if (vkCreateCommandPool(m_logicalDevice, &poolInfo, nullptr, &m_commandPool) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create upload command pool!");
+	}
+
+	if (m_ownershipTransfer)
+	{
+		poolInfo.queueFamilyIndex = m_graphicsFamily;
+
+		if (vkCreateCommandPool(m_logicalDevice, &poolInfo, nullptr, &m_acquireCommandPool) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create upload acquire command pool!");
+		}
+	}
+
+	m_slots.resize(UPLOAD_BATCH_COUNT);
+
+	for (BatchSlot& slot : m_slots) {
+		VkCommandBufferAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		allocInfo.commandPool = m_commandPool;
+		allocInfo.commandBufferCount = 1;
+
+		if (vkAllocateCommandBuffers(m_logicalDevice, &allocInfo, &slot.commandBuffer) != VK_SUCCESS) {
+			throw std::runtime_error("failed to allocate upload command buffer!");
+		}
+
+		VkFenceCreateInfo fenceInfo{};
+		fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+		if (vkCreateFence(m_logicalDevice, &fenceInfo, nullptr, &slot.copyFence) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create upload fence!");
+		}
+
+		if (!m_ownershipTransfer)
+		{
+			continue;
+		}
+
+		allocInfo.commandPool = m_acquireCommandPool;
+
+		if (vkAllocateCommandBuffers(m_logicalDevice, &allocInfo, &slot.acquireCommandBuffer) != VK_SUCCESS) {
+			throw std::runtime_error("failed to allocate upload acquire command buffer!");
+		}
+
+		VkSemaphoreCreateInfo semaphoreInfo{};
+		semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+		if (vkCreateFence(m_logicalDevice, &fenceInfo, nullptr, &slot.acquireFence) != VK_SUCCESS ||
+			vkCreateSemaphore(m_logicalDevice, &semaphoreInfo, nullptr, &slot.semaphore) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create upload acquire synchronization objects!");
+		}
+	}
+
+	VkBufferCreateInfo bufferInfo{};
+	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferInfo.size = UPLOAD_RING_SIZE;
+	bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+	bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+	if (vkCreateBuffer(m_logicalDevice, &bufferInfo, nullptr, &m_buffer) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create upload ring buffer!");
+	}
+
+	VkMemoryRequirements memRequirements;
+	vkGetBufferMemoryRequirements(m_logicalDevice, m_buffer, &memRequirements);
+
+	//bigger than half a block, so the ring gets memory of its own that stays mapped
+	m_bufferMemory = m_pAllocator->Allocate(memRequirements, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		AllocationKind::BUFFER);
+
+	vkBindBufferMemory(m_logicalDevice, m_buffer, m_bufferMemory.memory, m_bufferMemory.offset);
+
+	std::cout << "" << std::endl;
+	std::cout << "Success: created " << UPLOAD_RING_SIZE / (1024 * 1024) << " MB upload ring with " << UPLOAD_BATCH_COUNT << " batches on the "
+		<< (m_ownershipTransfer ? "transfer queue (family " : "graphics queue (family ") << m_transferFamily << ")" << std::endl;
+}
+
+void UploadRing::Destroy()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	//a copied batch whose acquire never got submitted only leaves a signaled semaphore behind
+	for (BatchSlot& slot : m_slots) {
+		if (slot.state == BatchState::COPYING)
+		{
+			vkWaitForFences(m_logicalDevice, 1, &slot.copyFence, VK_TRUE, UINT64_MAX);
+		}
+		else if (slot.state == BatchState::ACQUIRING)
+		{
+			vkWaitForFences(m_logicalDevice, 1, &slot.acquireFence, VK_TRUE, UINT64_MAX);
+		}
+	}
+
+	for (OverflowBuffer& overflowBuffer : m_overflowBuffers) {
+		vkDestroyBuffer(m_logicalDevice, overflowBuffer.buffer, nullptr);
+		m_pAllocator->Free(overflowBuffer.memory);
+	}
+	m_overflowBuffers.clear();
+	m_entries.clear();
+	m_pendingCopies.clear();
+	m_concurrentBuffers.clear();
+
+	vkDestroyBuffer(m_logicalDevice, m_buffer, nullptr);
+	m_pAllocator->Free(m_bufferMemory);
+	m_buffer = VK_NULL_HANDLE;
+
+	//destroying the pools frees the command buffers
+	for (BatchSlot& slot : m_slots) {
+		vkDestroyFence(m_logicalDevice, slot.copyFence, nullptr);
+		vkDestroyFence(m_logicalDevice, slot.acquireFence, nullptr);
+		vkDestroySemaphore(m_logicalDevice, slot.semaphore, nullptr);
+	}
+	m_slots.clear();
+
+	vkDestroyCommandPool(m_logicalDevice, m_commandPool, nullptr);
+	vkDestroyCommandPool(m_logicalDevice, m_acquireCommandPool, nullptr);
+	m_commandPool = VK_NULL_HANDLE;
+	m_acquireCommandPool = VK_NULL_HANDLE;
+}
+
+UploadRegion UploadRing::Reserve(const VkDeviceSize a_size)
+{
+	return ReserveRegion(a_size, false);
+}
+
+uint64_t UploadRing::Copy(const UploadRegion& a_region, const std::vector<UploadCopy>& a_copies)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	for (const UploadCopy& copy : a_copies) {
+		PendingCopy pendingCopy;
+		pendingCopy.srcBuffer = a_region.buffer;
+		pendingCopy.dstBuffer = copy.dstBuffer;
+		pendingCopy.region.srcOffset = a_region.offset + copy.srcOffset;
+		pendingCopy.region.dstOffset = copy.dstOffset;
+		pendingCopy.region.size = copy.size;
+
+		m_pendingCopies.push_back(pendingCopy);
+		m_uploadedBytes += copy.size;
+		m_copyCount++;
+	}
+
+	//the region is read by the open batch, it comes back once that batch is done
+	if (a_region.buffer == m_buffer)
+	{
+		for (auto it = m_entries.rbegin(); it != m_entries.rend(); ++it) {
+			if (it->offset == a_region.offset && it->batch == 0)
+			{
+				it->batch = m_openBatch;
+				break;
+			}
+		}
+	}
+	else
+	{
+		for (OverflowBuffer& overflowBuffer : m_overflowBuffers) {
+			if (overflowBuffer.buffer == a_region.buffer)
+			{
+				overflowBuffer.batch = m_openBatch;
+				break;
+			}
+		}
+	}
+
+	return m_openBatch;
+}
+
+uint64_t UploadRing::Upload(VkBuffer a_dstBuffer, const VkDeviceSize a_dstOffset, const void* a_data, const VkDeviceSize a_size)
+{
+	if (a_size == 0)
+	{
+		return 0;
+	}
+
+	UploadRegion region = ReserveRegion(a_size, true);
+	memcpy(region.mapped, a_data, static_cast<size_t>(a_size));
+
+	return Copy(region, { { a_dstBuffer, 0, a_dstOffset, a_size } });
+}
+
+void UploadRing::Flush()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	FlushLocked();
+}
+
+bool UploadRing::IsBatchDone(const uint64_t a_batch)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	RetireBatches();
+
+	return a_batch <= m_completedBatch;
+}
+
+void UploadRing::WaitForBatch(const uint64_t a_batch)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	if (a_batch >= m_openBatch)
+	{
+		FlushLocked();
+	}
+
+	WaitForBatchLocked(a_batch);
+}
+
+void UploadRing::WaitIdle()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	FlushLocked();
+	WaitForBatchLocked(m_openBatch - 1);
+}
+
+bool UploadRing::HasTransferQueue() const
+{
+	return m_ownershipTransfer;
+}
+
+std::vector<uint32_t> UploadRing::GetQueueFamilies() const
+{
+	if (m_ownershipTransfer)
+	{
+		return { m_graphicsFamily, m_transferFamily };
+	}
+
+	return { m_graphicsFamily };
+}
+
+void UploadRing::AddConcurrentBuffer(VkBuffer a_buffer)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_concurrentBuffers.insert(a_buffer);
+}
+
+void UploadRing::RemoveConcurrentBuffer(VkBuffer a_buffer)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_concurrentBuffers.erase(a_buffer);
+}
+
+void UploadRing::PrintStats() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	const float mb = 1024.0f * 1024.0f;
+
+	std::cout << "" << std::endl;
+	std::cout << "Upload ring: " << m_usedBytes / mb << " of " << UPLOAD_RING_SIZE / mb << " MB used, peak " << m_peakBytes / mb << " MB, "
+		<< m_copyCount << " copies (" << m_uploadedBytes / mb << " MB) in " << m_openBatch - 1 << " batches, "
+		<< m_overflowCount << " regions went to overflow buffers, waited for the gpu " << m_waitCount << " times" << std::endl;
+}
+
+UploadRegion UploadRing::ReserveRegion(const VkDeviceSize a_size, const bool a_canFlush)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	//waiting happens with the lock held, the transfer queue finishes submitted copies without help
+	while (a_size <= UPLOAD_RING_SIZE / 2)
+	{
+		RetireBatches();
+
+		VkDeviceSize offset = 0;
+		if (AllocateFromRing(a_size, offset))
+		{
+			UploadRegion region;
+			region.buffer = m_buffer;
+			region.offset = offset;
+			region.size = a_size;
+			region.mapped = static_cast<char*>(m_bufferMemory.mapped) + offset;
+			return region;
+		}
+
+		//the ring is full, only the front entry decides when space comes back
+		uint64_t oldestBatch = m_entries.front().batch;
+
+		if (oldestBatch != 0 && oldestBatch < m_openBatch)
+		{
+			m_waitCount++;
+			WaitForCopiesLocked(oldestBatch);
+		}
+		else if (oldestBatch == m_openBatch && a_canFlush)
+		{
+			FlushLocked();
+		}
+		else
+		{
+			//still being written or waiting for a flush that only the submitting thread can do
+			break;
+		}
+	}
+
+	m_overflowCount++;
+	return CreateOverflowRegion(a_size);
+}
+
+bool UploadRing::AllocateFromRing(const VkDeviceSize a_size, VkDeviceSize& a_offset)
+{
+	VkDeviceSize offset = 0;
+
+	if (!m_entries.empty())
+	{
+		const RingEntry& oldest = m_entries.front();
+		const RingEntry& newest = m_entries.back();
+		offset = (newest.offset + newest.size + UPLOAD_ALIGNMENT - 1) / UPLOAD_ALIGNMENT * UPLOAD_ALIGNMENT;
+
+		if (newest.offset >= oldest.offset)
+		{
+			//not wrapped, use the end of the ring or wrap around to the start
+			if (offset + a_size > UPLOAD_RING_SIZE)
+			{
+				offset = 0;
+				if (a_size > oldest.offset)
+				{
+					return false;
+				}
+			}
+		}
+		else if (offset + a_size > oldest.offset)
+		{
+			return false;
+		}
+	}
+
+	m_entries.push_back({ offset, a_size, 0 });
+	m_usedBytes += a_size;
+	m_peakBytes = std::max(m_peakBytes, m_usedBytes);
+
+	a_offset = offset;
+	return true;
+}
+
+UploadRegion UploadRing::CreateOverflowRegion(const VkDeviceSize a_size)
+{
+	OverflowBuffer overflowBuffer;
+	overflowBuffer.batch = 0;
+
+	VkBufferCreateInfo bufferInfo{};
+	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferInfo.size = a_size;
+	bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+	bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+	if (vkCreateBuffer(m_logicalDevice, &bufferInfo, nullptr, &overflowBuffer.buffer) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create upload overflow buffer!");
+	}
+
+	VkMemoryRequirements memRequirements;
+	vkGetBufferMemoryRequirements(m_logicalDevice, overflowBuffer.buffer, &memRequirements);
+
+	overflowBuffer.memory = m_pAllocator->Allocate(memRequirements, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		AllocationKind::BUFFER, AllocationLifetime::TRANSIENT);
+
+	vkBindBufferMemory(m_logicalDevice, overflowBuffer.buffer, overflowBuffer.memory.memory, overflowBuffer.memory.offset);
+
+	m_overflowBuffers.push_back(overflowBuffer);
+
+	UploadRegion region;
+	region.buffer = overflowBuffer.buffer;
+	region.offset = 0;
+	region.size = a_size;
+	region.mapped = overflowBuffer.memory.mapped;
+	return region;
+}
+
+void UploadRing::FlushLocked()
+{
+	RetireBatches();
+	SubmitAcquires();
+
+	if (m_pendingCopies.empty())
+	{
+		return;
+	}
+
+	BatchSlot* pSlot = FindOldestSlot(BatchState::FREE);
+
+	if (!pSlot)
+	{
+		//every slot is in flight, the oldest one is reused
+		pSlot = &m_slots.front();
+		for (BatchSlot& slot : m_slots) {
+			if (slot.batch < pSlot->batch)
+			{
+				pSlot = &slot;
+			}
+		}
+
+		m_waitCount++;
+		WaitForBatchLocked(pSlot->batch);
+	}
+
+	vkResetCommandBuffer(pSlot->commandBuffer, 0);
+
+	VkCommandBufferBeginInfo beginInfo{};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+	vkBeginCommandBuffer(pSlot->commandBuffer, &beginInfo);
+
+	//neighbouring copies between the same two buffers share one vkCmdCopyBuffer
+	std::vector<VkBufferCopy> regions;
+	pSlot->dstBuffers.clear();
+
+	for (size_t i = 0; i < m_pendingCopies.size(); i++) {
+		const PendingCopy& copy = m_pendingCopies[i];
+		regions.push_back(copy.region);
+
+		bool last = i + 1 == m_pendingCopies.size();
+		if (last || m_pendingCopies[i + 1].srcBuffer != copy.srcBuffer || m_pendingCopies[i + 1].dstBuffer != copy.dstBuffer)
+		{
+			vkCmdCopyBuffer(pSlot->commandBuffer, copy.srcBuffer, copy.dstBuffer, static_cast<uint32_t>(regions.size()), regions.data());
+			regions.clear();
+			pSlot->dstBuffers.push_back(copy.dstBuffer);
+		}
+	}
+
+	if (m_ownershipTransfer)
+	{
+		//the graphics family acquires the buffers once the copies are done, see SubmitAcquires
+		std::sort(pSlot->dstBuffers.begin(), pSlot->dstBuffers.end());
+		pSlot->dstBuffers.erase(std::unique(pSlot->dstBuffers.begin(), pSlot->dstBuffers.end()), pSlot->dstBuffers.end());
+		pSlot->dstBuffers.erase(std::remove_if(pSlot->dstBuffers.begin(), pSlot->dstBuffers.end(), 
+			[this](VkBuffer a_buffer) { return m_concurrentBuffers.count(a_buffer) > 0; }), pSlot->dstBuffers.end());
+
+		std::vector<VkBufferMemoryBarrier> releases(pSlot->dstBuffers.size());
+
+		for (size_t i = 0; i < releases.size(); i++) {
+			releases[i].sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+			releases[i].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			releases[i].dstAccessMask = 0;
+			releases[i].srcQueueFamilyIndex = m_transferFamily;
+			releases[i].dstQueueFamilyIndex = m_graphicsFamily;
+			releases[i].buffer = pSlot->dstBuffers[i];
+			releases[i].offset = 0;
+			releases[i].size = VK_WHOLE_SIZE;
+		}
+
+		if (!releases.empty())
+		{
+			vkCmdPipelineBarrier(pSlot->commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+				0, 0, nullptr, static_cast<uint32_t>(releases.size()), releases.data(), 0, nullptr);
+		}
+	}
+	else
+	{
+		//everything submitted to the queue afterwards sees the copies
+		VkMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = UPLOAD_DST_ACCESS;
+
+		vkCmdPipelineBarrier(pSlot->commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, UPLOAD_DST_STAGES, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+	}
+
+	if (vkEndCommandBuffer(pSlot->commandBuffer) != VK_SUCCESS) {
+		throw std::runtime_error("failed to record upload command buffer!");
+	}
+
+	vkResetFences(m_logicalDevice, 1, &pSlot->copyFence);
+
+	VkSubmitInfo submitInfo{};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &pSlot->commandBuffer;
+
+	if (m_ownershipTransfer)
+	{
+		submitInfo.signalSemaphoreCount = 1;
+		submitInfo.pSignalSemaphores = &pSlot->semaphore;
+	}
+
+	if (vkQueueSubmit(m_transferQueue, 1, &submitInfo, pSlot->copyFence) != VK_SUCCESS) {
+		throw std::runtime_error("failed to submit upload command buffer!");
+	}
+
+	pSlot->state = BatchState::COPYING;
+	pSlot->batch = m_openBatch;
+	m_openBatch++;
+	m_pendingCopies.clear();
+}
+
+void UploadRing::SubmitAcquires()
+{
+	//submitted only after the copies finished, so the semaphore wait never holds up the frames behind it
+	while (BatchSlot* pSlot = FindOldestSlot(BatchState::COPIED))
+	{
+		vkResetCommandBuffer(pSlot->acquireCommandBuffer, 0);
+
+		VkCommandBufferBeginInfo beginInfo{};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+		vkBeginCommandBuffer(pSlot->acquireCommandBuffer, &beginInfo);
+
+		//has to match the release recorded on the transfer queue
+		std::vector<VkBufferMemoryBarrier> acquires(pSlot->dstBuffers.size());
+
+		for (size_t i = 0; i < acquires.size(); i++) {
+			acquires[i].sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+			acquires[i].srcAccessMask = 0;
+			acquires[i].dstAccessMask = UPLOAD_DST_ACCESS;
+			acquires[i].srcQueueFamilyIndex = m_transferFamily;
+			acquires[i].dstQueueFamilyIndex = m_graphicsFamily;
+			acquires[i].buffer = pSlot->dstBuffers[i];
+			acquires[i].offset = 0;
+			acquires[i].size = VK_WHOLE_SIZE;
+		}
+
+		//the copies into concurrent buffers are visible to the wait stages, this carries them over to the frames behind
+		VkMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier.srcAccessMask = 0;
+		barrier.dstAccessMask = UPLOAD_DST_ACCESS;
+
+		vkCmdPipelineBarrier(pSlot->acquireCommandBuffer, UPLOAD_DST_STAGES, UPLOAD_DST_STAGES,
+			0, 1, &barrier, static_cast<uint32_t>(acquires.size()), acquires.data(), 0, nullptr);
+
+		if (vkEndCommandBuffer(pSlot->acquireCommandBuffer) != VK_SUCCESS) {
+			throw std::runtime_error("failed to record upload acquire command buffer!");
+		}
+
+		vkResetFences(m_logicalDevice, 1, &pSlot->acquireFence);
+
+		VkPipelineStageFlags waitStage = UPLOAD_DST_STAGES;
+
+		VkSubmitInfo submitInfo{};
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.waitSemaphoreCount = 1;
+		submitInfo.pWaitSemaphores = &pSlot->semaphore;
+		submitInfo.pWaitDstStageMask = &waitStage;
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &pSlot->acquireCommandBuffer;
+
+		if (vkQueueSubmit(m_graphicsQueue, 1, &submitInfo, pSlot->acquireFence) != VK_SUCCESS) {
+			throw std::runtime_error("failed to submit upload acquire command buffer!");
+		}
+
+		pSlot->state = BatchState::ACQUIRING;
+	}
+}
+
+UploadRing::BatchSlot* UploadRing::FindOldestSlot(const BatchState a_state)
+{
+	BatchSlot* pOldestSlot = nullptr;
+
+	for (BatchSlot& slot : m_slots) {
+		if (slot.state == a_state && (!pOldestSlot || slot.batch < pOldestSlot->batch))
+		{
+			pOldestSlot = &slot;
+		}
+	}
+
+	return pOldestSlot;
+}
+
+void UploadRing::WaitForCopiesLocked(const uint64_t a_batch)
+{
+	for (BatchSlot& slot : m_slots) {
+		if (slot.state == BatchState::COPYING && slot.batch <= a_batch)
+		{
+			vkWaitForFences(m_logicalDevice, 1, &slot.copyFence, VK_TRUE, UINT64_MAX);
+		}
+	}
+
+	RetireBatches();
+}
+
+void UploadRing::WaitForBatchLocked(const uint64_t a_batch)
+{
+	WaitForCopiesLocked(a_batch);
+
+	if (!m_ownershipTransfer)
+	{
+		return;
+	}
+
+	SubmitAcquires();
+
+	for (BatchSlot& slot : m_slots) {
+		if (slot.state == BatchState::ACQUIRING && slot.batch <= a_batch)
+		{
+			vkWaitForFences(m_logicalDevice, 1, &slot.acquireFence, VK_TRUE, UINT64_MAX);
+		}
+	}
+
+	RetireBatches();
+}
+
+void UploadRing::RetireBatches()
+{
+	//batches on one queue finish in submission order, the oldest one decides
+	while (BatchSlot* pSlot = FindOldestSlot(BatchState::COPYING))
+	{
+		if (vkGetFenceStatus(m_logicalDevice, pSlot->copyFence) != VK_SUCCESS)
+		{
+			break;
+		}
+
+		m_copiedBatch = pSlot->batch;
+
+		if (m_ownershipTransfer)
+		{
+			pSlot->state = BatchState::COPIED;
+		}
+		else
+		{
+			pSlot->state = BatchState::FREE;
+			m_completedBatch = pSlot->batch;
+		}
+	}
+
+	while (BatchSlot* pSlot = FindOldestSlot(BatchState::ACQUIRING))
+	{
+		if (vkGetFenceStatus(m_logicalDevice, pSlot->acquireFence) != VK_SUCCESS)
+		{
+			break;
+		}
+
+		pSlot->state = BatchState::FREE;
+		m_completedBatch = pSlot->batch;
+	}
+
+	//the ring is only read by the copies, its space comes back before the acquire
+	while (!m_entries.empty() && m_entries.front().batch != 0 && m_entries.front().batch <= m_copiedBatch)
+	{
+		m_usedBytes -= m_entries.front().size;
+		m_entries.pop_front();
+	}
+
+	for (OverflowBuffer& overflowBuffer : m_overflowBuffers) {
+		if (overflowBuffer.batch != 0 && overflowBuffer.batch <= m_copiedBatch)
+		{
+			vkDestroyBuffer(m_logicalDevice, overflowBuffer.buffer, nullptr);
+			m_pAllocator->Free(overflowBuffer.memory);
+		}
+	}
+
+	m_overflowBuffers.erase(std::remove_if(m_overflowBuffers.begin(), m_overflowBuffers.end(),
+		[](const OverflowBuffer& a_overflowBuffer) { return a_overflowBuffer.memory.memory == VK_NULL_HANDLE; }), m_overflowBuffers.end());
+}
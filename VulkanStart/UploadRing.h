@@ -0,0 +1,172 @@
+#ifndef UPLOAD_RING_H
+#define UPLOAD_RING_H
+
+#include "DeviceMemoryAllocator.h"
+
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <deque>
+#include <set>
+#include <mutex>
+
+// Size of the persistently mapped staging buffer all uploads go through
+const VkDeviceSize UPLOAD_RING_SIZE = 64ull * 1024 * 1024;
+// Submitted upload batches that can be in flight at once, a flush waits for the oldest one beyond that
+const uint32_t UPLOAD_BATCH_COUNT = 4;
+// Regions start at this alignment so the cpu can write any vertex or index type straight into them
+const VkDeviceSize UPLOAD_ALIGNMENT = 16;
+// Where uploaded buffers are read, the barrier (or acquire) at the end of a batch makes the copies visible there
+const VkPipelineStageFlags UPLOAD_DST_STAGES = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT |
+	VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+const VkAccessFlags UPLOAD_DST_ACCESS = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+
+// Staging space handed out by the ring, mapped points at offset
+struct UploadRegion
+{
+	VkBuffer buffer = VK_NULL_HANDLE;		// the ring buffer, or an overflow buffer for regions that did not fit
+	VkDeviceSize offset = 0;
+	VkDeviceSize size = 0;
+	void* mapped = nullptr;
+};
+
+// One copy out of a region, srcOffset is relative to the start of the region
+struct UploadCopy
+{
+	VkBuffer dstBuffer;
+	VkDeviceSize srcOffset;
+	VkDeviceSize dstOffset;
+	VkDeviceSize size;
+};
+
+// Streams uploads through one persistently mapped staging buffer.
+// The copies of all regions handed back between two Flush calls are recorded into one command buffer (a batch),
+// a region is reused once the copies of its batch are done. The cpu only waits when the ring is full.
+// With a transfer queue family of its own the batch runs on the transfer queue and overlaps rendering, the destination buffers
+// are released to the graphics family and acquired by a second submit that waits on the semaphore of the batch.
+// A batch counts as done once that acquire finished, only then the graphics queue may use its buffers.
+// Without a transfer family the batch runs on the graphics queue and ends with a memory barrier instead.
+// Reserve and Copy can be called from any thread, Flush, Upload and the waits only from the thread that submits to the graphics queue.
+class UploadRing
+{
+public:
+	// a_transferQueue may be the graphics queue
+	void Init(VkDevice a_logicalDevice, DeviceMemoryAllocator* a_pAllocator, VkQueue a_transferQueue, const uint32_t a_transferFamily,
+		VkQueue a_graphicsQueue, const uint32_t a_graphicsFamily);
+	void Destroy();
+
+	// Waits for submitted batches if they hold the space, space held by the open batch or by regions not handed back yet
+	// (and requests bigger than half the ring) is taken from an overflow buffer instead of blocking
+	UploadRegion Reserve(const VkDeviceSize a_size);
+	// Queues the copies out of a_region into the open batch and hands the region back, returns the batch.
+	// Destination buffers are exclusive to the graphics family afterwards, their previous content is not kept
+	uint64_t Copy(const UploadRegion& a_region, const std::vector<UploadCopy>& a_copies);
+	// Reserve, memcpy and Copy in one, flushes itself instead of overflowing when the open batch holds the ring
+	uint64_t Upload(VkBuffer a_dstBuffer, const VkDeviceSize a_dstOffset, const void* a_data, const VkDeviceSize a_size);
+
+	// Submits the acquires of batches whose copies are done, then records the queued copies into one command buffer
+	// and submits it, called once per frame
+	void Flush();
+
+	bool IsBatchDone(const uint64_t a_batch);
+	// Flushes the batch first if it is still open
+	void WaitForBatch(const uint64_t a_batch);
+	// Flushes and waits for everything, for uploads the next frame draws from right away
+	void WaitIdle();
+
+	bool HasTransferQueue() const;
+	// Families a buffer updated in place while it is drawn has to be shared between (VK_SHARING_MODE_CONCURRENT), 
+	// a single family without a transfer queue of its own
+	std::vector<uint32_t> GetQueueFamilies() const;
+	// Copies into concurrent buffers skip the ownership transfer, the semaphore wait of the acquire submit orders them
+	void AddConcurrentBuffer(VkBuffer a_buffer);
+	void RemoveConcurrentBuffer(VkBuffer a_buffer);
+
+	void PrintStats() const;
+
+private:
+	struct RingEntry
+	{
+		VkDeviceSize offset;
+		VkDeviceSize size;
+		uint64_t batch;			// 0 while the region is written, then the batch its copies went into
+	};
+
+	struct OverflowBuffer
+	{
+		VkBuffer buffer;
+		MemoryAllocation memory;
+		uint64_t batch;
+	};
+
+	struct PendingCopy
+	{
+		VkBuffer srcBuffer;
+		VkBuffer dstBuffer;
+		VkBufferCopy region;
+	};
+
+	enum class BatchState
+	{
+		FREE,
+		COPYING,		// submitted to the transfer queue
+		COPIED,			// copies done, the acquire still has to be submitted to the graphics queue
+		ACQUIRING		// acquire submitted to the graphics queue
+	};
+
+	struct BatchSlot
+	{
+		VkCommandBuffer commandBuffer = VK_NULL_HANDLE;			// copies (and releases), transfer queue
+		VkCommandBuffer acquireCommandBuffer = VK_NULL_HANDLE;	// acquires, graphics queue
+		VkFence copyFence = VK_NULL_HANDLE;
+		VkFence acquireFence = VK_NULL_HANDLE;
+		VkSemaphore semaphore = VK_NULL_HANDLE;					// copies -> acquire
+		std::vector<VkBuffer> dstBuffers;						// changing owner
+		BatchState state = BatchState::FREE;
+		uint64_t batch = 0;
+	};
+
+	UploadRegion ReserveRegion(const VkDeviceSize a_size, const bool a_canFlush);
+	bool AllocateFromRing(const VkDeviceSize a_size, VkDeviceSize& a_offset);
+	UploadRegion CreateOverflowRegion(const VkDeviceSize a_size);
+	// Callers hold m_mutex
+	void FlushLocked();
+	void SubmitAcquires();
+	BatchSlot* FindOldestSlot(const BatchState a_state);
+	// Only waits for the transfer queue, safe from any thread
+	void WaitForCopiesLocked(const uint64_t a_batch);
+	void WaitForBatchLocked(const uint64_t a_batch);
+	void RetireBatches();
+
+	VkDevice m_logicalDevice = VK_NULL_HANDLE;
+	DeviceMemoryAllocator* m_pAllocator = nullptr;
+
+	VkQueue m_transferQueue = VK_NULL_HANDLE;
+	VkQueue m_graphicsQueue = VK_NULL_HANDLE;
+	uint32_t m_transferFamily = 0;
+	uint32_t m_graphicsFamily = 0;
+	bool m_ownershipTransfer = false;		// transfer and graphics queue are of different families
+
+	VkBuffer m_buffer = VK_NULL_HANDLE;
+	MemoryAllocation m_bufferMemory;
+	std::deque<RingEntry> m_entries;		// oldest first, space comes back from the front
+	std::vector<OverflowBuffer> m_overflowBuffers;
+
+	VkCommandPool m_commandPool = VK_NULL_HANDLE;
+	VkCommandPool m_acquireCommandPool = VK_NULL_HANDLE;
+	std::vector<BatchSlot> m_slots;
+	std::vector<PendingCopy> m_pendingCopies;
+	std::set<VkBuffer> m_concurrentBuffers;
+	uint64_t m_openBatch = 1;
+	uint64_t m_copiedBatch = 0;			// ring space of batches up to here is free again
+	uint64_t m_completedBatch = 0;		// buffers of batches up to here can be used by the graphics queue
+
+	VkDeviceSize m_usedBytes = 0;
+	VkDeviceSize m_peakBytes = 0;
+	VkDeviceSize m_uploadedBytes = 0;
+	uint64_t m_copyCount = 0;
+	uint32_t m_overflowCount = 0;
+	uint32_t m_waitCount = 0;		// reserves and flushes that had to wait for the gpu
+
+	mutable std::mutex m_mutex;
+};
+#endif // !UPLOAD_RING_H
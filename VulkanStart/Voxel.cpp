@@ -7,17 +7,17 @@ Voxel::Voxel(const glm::vec3& a_position, const glm::vec3& a_color, const float&
 	m_size = a_size;
 }
 
-glm::vec3 Voxel::GetPosition()
+glm::vec3 Voxel::GetPosition() const
 {
 	return m_position;
 }
 
-glm::vec3 Voxel::GetColor()
+glm::vec3 Voxel::GetColor() const
 {
 	return m_color;
 }
 
-float Voxel::GetSize()
+float Voxel::GetSize() const
 {
 	return m_size;
 }
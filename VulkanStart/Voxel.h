@@ -25,9 +25,9 @@ public:
 
 	Voxel(const glm::vec3& a_position, const glm::vec3& a_color, const float& a_size);
 
-	glm::vec3 GetPosition();
-	glm::vec3 GetColor();
-	float GetSize();
+	glm::vec3 GetPosition() const;
+	glm::vec3 GetColor() const;
+	float GetSize() const;
 
 	std::vector<Vertex>GetVertices();
 	static std::vector<uint32_t>GetIndices();
@@ -0,0 +1,430 @@
+#include "VoxelBvh.h"
+#include "VoxelWorld.h"
+#include "JobSystem.h"
+
+#include <iostream>
+#include <chrono>
+#include <algorithm>
+
+void VoxelBvh::Bounds::Grow(const glm::vec3& a_point)
+{
+	min = glm::min(min, a_point);
+	max = glm::max(max, a_point);
+}
+
+void VoxelBvh::Bounds::Grow(const Bounds& a_bounds)
+{
+	min = glm::min(min, a_bounds.min);
+	max = glm::max(max, a_bounds.max);
+}
+
+float VoxelBvh::Bounds::GetArea() const
+{
+	glm::vec3 extent = max - min;
+	if (extent.x < 0.0f)
+	{
+		return 0.0f;
+	}
+
+	return 2.0f * (extent.x * extent.y + extent.y * extent.z + extent.z * extent.x);
+}
+
+void VoxelBvh::Build(const std::vector<Voxel>& a_voxel)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	uint32_t count = static_cast<uint32_t>(a_voxel.size());
+
+	m_buildPrimitives.resize(count);
+	m_primitiveIndices.resize(count);
+
+	TaskGroup group;
+	JobSystem::GetInstance().ParallelFor(group, static_cast<int>(count), BVH_PARALLEL_SUBTREE_SIZE, [&](int a_begin, int a_end)
+		{
+			for (int i = a_begin; i < a_end; i++) {
+				m_buildPrimitives[i].center = a_voxel[i].GetPosition();
+				m_buildPrimitives[i].halfSize = a_voxel[i].GetSize();
+				m_buildPrimitives[i].index = static_cast<uint32_t>(i);
+			}
+		});
+	group.Wait();
+
+	//a tree with leaves of at least one primitive has at most 2n - 1 nodes
+	m_buildNodes.resize(count > 0 ? 2 * static_cast<size_t>(count) - 1 : 1);
+	m_buildNodeCount = 0;
+
+	m_nodes.clear();
+	m_leafCount = 0;
+	m_depth = 0;
+	m_sahCost = 0.0f;
+
+	if (count > 0)
+	{
+		uint32_t root = BuildRange(0, count);
+
+		m_nodes.reserve(m_buildNodeCount);
+		Flatten(root, 1);
+	}
+	else
+	{
+		//inverted bounds, the root test of every ray fails
+		BvhNode empty{};
+		empty.boundsMin = glm::vec3(FLT_MAX);
+		empty.boundsMax = glm::vec3(-FLT_MAX);
+		empty.leftOrFirst = 0;
+		empty.count = 1;
+		m_nodes.push_back(empty);
+	}
+
+	//the leaves reference the primitives in the order the build partitioned them into
+	m_primitives.resize(std::max<size_t>(count, 1), BvhPrimitive{});
+
+	TaskGroup primitiveGroup;
+	JobSystem::GetInstance().ParallelFor(primitiveGroup, static_cast<int>(count), BVH_PARALLEL_SUBTREE_SIZE, [&](int a_begin, int a_end)
+		{
+			for (int i = a_begin; i < a_end; i++) {
+				m_primitiveIndices[i] = m_buildPrimitives[i].index;
+				m_primitives[i] = MakePrimitive(a_voxel[m_primitiveIndices[i]]);
+			}
+		});
+	primitiveGroup.Wait();
+
+	//only the leaf order is needed for Refit
+	m_buildNodes.clear();
+	m_buildNodes.shrink_to_fit();
+	m_buildPrimitives.clear();
+	m_buildPrimitives.shrink_to_fit();
+
+	m_buildTime = std::chrono::duration<float, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+void VoxelBvh::Refit(const std::vector<Voxel>& a_voxel)
+{
+	if (a_voxel.size() != m_primitiveIndices.size())
+	{
+		throw std::runtime_error("failed to refit bvh, the voxel count changed since the build!");
+	}
+
+	auto start = std::chrono::high_resolution_clock::now();
+
+	TaskGroup group;
+	JobSystem::GetInstance().ParallelFor(group, static_cast<int>(a_voxel.size()), BVH_PARALLEL_SUBTREE_SIZE, [&](int a_begin, int a_end)
+		{
+			for (int i = a_begin; i < a_end; i++) {
+				m_primitives[i] = MakePrimitive(a_voxel[m_primitiveIndices[i]]);
+			}
+		});
+	group.Wait();
+
+	//children come after their parent in depth first order, so going backwards every child is done before its parent
+	for (size_t n = a_voxel.empty() ? 0 : m_nodes.size(); n-- > 0;) {
+		BvhNode& node = m_nodes[n];
+
+		Bounds bounds;
+		if (node.count > 0)
+		{
+			for (uint32_t p = node.leftOrFirst; p < node.leftOrFirst + node.count; p++) {
+				bounds.Grow(m_primitives[p].center - m_primitives[p].halfSize);
+				bounds.Grow(m_primitives[p].center + m_primitives[p].halfSize);
+			}
+		}
+		else
+		{
+			const BvhNode& left = m_nodes[n + 1];
+			const BvhNode& right = m_nodes[node.leftOrFirst];
+
+			bounds.min = glm::min(left.boundsMin, right.boundsMin);
+			bounds.max = glm::max(left.boundsMax, right.boundsMax);
+		}
+
+		node.boundsMin = bounds.min;
+		node.boundsMax = bounds.max;
+	}
+
+	m_refitTime = std::chrono::duration<float, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+const std::vector<BvhNode>& VoxelBvh::GetNodes() const
+{
+	return m_nodes;
+}
+
+const std::vector<BvhPrimitive>& VoxelBvh::GetPrimitives() const
+{
+	return m_primitives;
+}
+
+void VoxelBvh::PrintStats() const
+{
+	std::cout << "" << std::endl;
+	std::cout << "BVH built: " << m_primitiveIndices.size() << " voxels, " << m_nodes.size() << " nodes, " << m_leafCount << " leaves, depth " << m_depth
+		<< ", SAH cost " << m_sahCost << ", " << (m_nodes.size() * sizeof(BvhNode) + m_primitives.size() * sizeof(BvhPrimitive)) / (1024 * 1024) << " MB, took "
+		<< m_buildTime << " ms on " << JobSystem::GetInstance().GetWorkerCount() + 1 << " threads";
+
+	if (m_refitTime > 0.0f)
+	{
+		std::cout << ", last refit took " << m_refitTime << " ms";
+	}
+	std::cout << std::endl;
+}
+
+uint32_t VoxelBvh::BuildRange(const uint32_t a_first, const uint32_t a_count)
+{
+	uint32_t nodeIndex = m_buildNodeCount++;
+	BuildNode& node = m_buildNodes[nodeIndex];
+	node.first = a_first;
+	node.count = a_count;
+	node.leaf = true;
+
+	Bounds centroidBounds;
+	ComputeBounds(a_first, a_count, node.bounds, centroidBounds);
+
+	if (a_count == 1)
+	{
+		return nodeIndex;
+	}
+
+	//best split over the bins of all three axes, split after bin splitBin of splitAxis
+	Bin bins[3 * BVH_BIN_COUNT];
+	ComputeBins(a_first, a_count, centroidBounds, bins);
+
+	float parentArea = node.bounds.GetArea();
+	float bestCost = FLT_MAX;
+	int splitAxis = -1;
+	uint32_t splitBin = 0;
+
+	for (int axis = 0; axis < 3; axis++) {
+		if (centroidBounds.max[axis] <= centroidBounds.min[axis])
+		{
+			continue;
+		}
+
+		const Bin* axisBins = &bins[axis * BVH_BIN_COUNT];
+
+		//right side summed from the back, the left side on the way forward
+		float rightCosts[BVH_BIN_COUNT];
+		Bounds rightBounds;
+		uint32_t rightCount = 0;
+		for (uint32_t b = BVH_BIN_COUNT - 1; b > 0; b--) {
+			rightBounds.Grow(axisBins[b].bounds);
+			rightCount += axisBins[b].count;
+			rightCosts[b - 1] = rightBounds.GetArea() * rightCount;
+		}
+
+		Bounds leftBounds;
+		uint32_t leftCount = 0;
+		for (uint32_t b = 0; b < BVH_BIN_COUNT - 1; b++) {
+			leftBounds.Grow(axisBins[b].bounds);
+			leftCount += axisBins[b].count;
+
+			if (leftCount == 0 || leftCount == a_count)
+			{
+				continue;
+			}
+
+			float cost = BVH_TRAVERSAL_COST + (leftBounds.GetArea() * leftCount + rightCosts[b]) / std::max(parentArea, FLT_MIN);
+			if (cost < bestCost)
+			{
+				bestCost = cost;
+				splitAxis = axis;
+				splitBin = b;
+			}
+		}
+	}
+
+	float leafCost = static_cast<float>(a_count);
+	if (a_count <= BVH_MAX_LEAF_SIZE && (splitAxis < 0 || leafCost <= bestCost))
+	{
+		return nodeIndex;
+	}
+
+	BuildPrimitive* first = m_buildPrimitives.data() + a_first;
+	BuildPrimitive* end = first + a_count;
+	BuildPrimitive* middle;
+
+	if (splitAxis >= 0)
+	{
+		float binScale = BVH_BIN_COUNT / (centroidBounds.max[splitAxis] - centroidBounds.min[splitAxis]);
+		float binMin = centroidBounds.min[splitAxis];
+
+		middle = std::partition(first, end, [&](const BuildPrimitive& a_primitive)
+			{
+				uint32_t bin = std::min(static_cast<uint32_t>((a_primitive.center[splitAxis] - binMin) * binScale), BVH_BIN_COUNT - 1);
+				return bin <= splitBin;
+			});
+	}
+	else
+	{
+		//every centroid is the same point, any split is as good as another
+		middle = first + a_count / 2;
+	}
+
+	uint32_t leftCount = static_cast<uint32_t>(middle - first);
+	uint32_t children[2];
+
+	if (a_count > BVH_PARALLEL_SUBTREE_SIZE)
+	{
+		//the left half runs as a task, Wait helps with other subtrees until it is done
+		TaskGroup group;
+		group.Run([&]() { children[0] = BuildRange(a_first, leftCount); });
+		children[1] = BuildRange(a_first + leftCount, a_count - leftCount);
+		group.Wait();
+	}
+	else
+	{
+		children[0] = BuildRange(a_first, leftCount);
+		children[1] = BuildRange(a_first + leftCount, a_count - leftCount);
+	}
+
+	//m_buildNodes never reallocates during the build, but look the node up again for clarity
+	BuildNode& innerNode = m_buildNodes[nodeIndex];
+	innerNode.leaf = false;
+	innerNode.children[0] = children[0];
+	innerNode.children[1] = children[1];
+
+	return nodeIndex;
+}
+
+void VoxelBvh::ComputeBounds(const uint32_t a_first, const uint32_t a_count, Bounds& a_bounds, Bounds& a_centroidBounds) const
+{
+	a_bounds = Bounds();
+	a_centroidBounds = Bounds();
+
+	if (a_count < BVH_PARALLEL_BINNING_SIZE)
+	{
+		for (uint32_t i = a_first; i < a_first + a_count; i++) {
+			const BuildPrimitive& primitive = m_buildPrimitives[i];
+			a_bounds.Grow(primitive.center - primitive.halfSize);
+			a_bounds.Grow(primitive.center + primitive.halfSize);
+			a_centroidBounds.Grow(primitive.center);
+		}
+		return;
+	}
+
+	//one partial result per range, merged afterwards
+	const int grainSize = static_cast<int>(BVH_PARALLEL_SUBTREE_SIZE);
+	std::vector<Bounds> partialBounds((a_count + grainSize - 1) / grainSize);
+	std::vector<Bounds> partialCentroidBounds(partialBounds.size());
+
+	TaskGroup group;
+	JobSystem::GetInstance().ParallelFor(group, static_cast<int>(a_count), grainSize, [&](int a_begin, int a_end)
+		{
+			Bounds bounds;
+			Bounds centroidBounds;
+			for (int i = a_begin; i < a_end; i++) {
+				const BuildPrimitive& primitive = m_buildPrimitives[a_first + i];
+				bounds.Grow(primitive.center - primitive.halfSize);
+				bounds.Grow(primitive.center + primitive.halfSize);
+				centroidBounds.Grow(primitive.center);
+			}
+
+			partialBounds[a_begin / grainSize] = bounds;
+			partialCentroidBounds[a_begin / grainSize] = centroidBounds;
+		});
+	group.Wait();
+
+	for (size_t p = 0; p < partialBounds.size(); p++) {
+		a_bounds.Grow(partialBounds[p]);
+		a_centroidBounds.Grow(partialCentroidBounds[p]);
+	}
+}
+
+void VoxelBvh::ComputeBins(const uint32_t a_first, const uint32_t a_count, const Bounds& a_centroidBounds, Bin* a_bins) const
+{
+	glm::vec3 extent = a_centroidBounds.max - a_centroidBounds.min;
+	glm::vec3 binScale;
+	for (int axis = 0; axis < 3; axis++) {
+		binScale[axis] = extent[axis] > 0.0f ? BVH_BIN_COUNT / extent[axis] : 0.0f;
+	}
+
+	auto binRange = [&](const uint32_t a_begin, const uint32_t a_end, Bin* a_rangeBins)
+		{
+			for (uint32_t i = a_begin; i < a_end; i++) {
+				const BuildPrimitive& primitive = m_buildPrimitives[i];
+				glm::vec3 offset = (primitive.center - a_centroidBounds.min) * binScale;
+				glm::vec3 primitiveMin = primitive.center - primitive.halfSize;
+				glm::vec3 primitiveMax = primitive.center + primitive.halfSize;
+
+				for (int axis = 0; axis < 3; axis++) {
+					Bin& bin = a_rangeBins[axis * BVH_BIN_COUNT + std::min(static_cast<uint32_t>(offset[axis]), BVH_BIN_COUNT - 1)];
+					bin.bounds.min = glm::min(bin.bounds.min, primitiveMin);
+					bin.bounds.max = glm::max(bin.bounds.max, primitiveMax);
+					bin.count++;
+				}
+			}
+		};
+
+	for (uint32_t b = 0; b < 3 * BVH_BIN_COUNT; b++) {
+		a_bins[b] = Bin();
+	}
+
+	if (a_count < BVH_PARALLEL_BINNING_SIZE)
+	{
+		binRange(a_first, a_first + a_count, a_bins);
+		return;
+	}
+
+	const int grainSize = static_cast<int>(BVH_PARALLEL_SUBTREE_SIZE);
+	std::vector<Bin> partialBins((a_count + grainSize - 1) / grainSize * 3 * BVH_BIN_COUNT);
+
+	TaskGroup group;
+	JobSystem::GetInstance().ParallelFor(group, static_cast<int>(a_count), grainSize, [&](int a_begin, int a_end)
+		{
+			binRange(a_first + a_begin, a_first + a_end, &partialBins[a_begin / grainSize * 3 * BVH_BIN_COUNT]);
+		});
+	group.Wait();
+
+	for (size_t p = 0; p < partialBins.size(); p++) {
+		Bin& bin = a_bins[p % (3 * BVH_BIN_COUNT)];
+		bin.bounds.Grow(partialBins[p].bounds);
+		bin.count += partialBins[p].count;
+	}
+}
+
+uint32_t VoxelBvh::Flatten(const uint32_t a_buildNode, const uint32_t a_depth)
+{
+	const BuildNode& buildNode = m_buildNodes[a_buildNode];
+
+	uint32_t nodeIndex = static_cast<uint32_t>(m_nodes.size());
+	m_nodes.emplace_back();
+
+	BvhNode node{};
+	node.boundsMin = buildNode.bounds.min;
+	node.boundsMax = buildNode.bounds.max;
+
+	//expected cost of a ray through the root, relative to the root area
+	float areaRatio = buildNode.bounds.GetArea() / std::max(m_buildNodes[0].bounds.GetArea(), FLT_MIN);
+	m_depth = std::max(m_depth, a_depth);
+
+	if (buildNode.leaf)
+	{
+		node.leftOrFirst = buildNode.first;
+		node.count = buildNode.count;
+
+		m_leafCount++;
+		m_sahCost += areaRatio * buildNode.count;
+	}
+	else
+	{
+		//the left child lands right behind this node
+		Flatten(buildNode.children[0], a_depth + 1);
+		node.leftOrFirst = Flatten(buildNode.children[1], a_depth + 1);
+		node.count = 0;
+
+		m_sahCost += areaRatio * BVH_TRAVERSAL_COST;
+	}
+
+	m_nodes[nodeIndex] = node;
+
+	return nodeIndex;
+}
+
+BvhPrimitive VoxelBvh::MakePrimitive(const Voxel& a_voxel) const
+{
+	BvhPrimitive primitive{};
+	primitive.center = a_voxel.GetPosition();
+	primitive.halfSize = a_voxel.GetSize();
+	primitive.color = VoxelWorld::PackColor(a_voxel.GetColor());
+
+	return primitive;
+}
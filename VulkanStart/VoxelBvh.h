@@ -0,0 +1,99 @@
+#ifndef VOXEL_BVH_H
+#define VOXEL_BVH_H
+
+#include "Voxel.h"
+#include "MyStructs.h"
+
+#include <glm/glm.hpp>
+#include <vector>
+#include <atomic>
+#include <cstdint>
+#include <cfloat>
+
+// Split candidates per axis of the binned SAH
+const uint32_t BVH_BIN_COUNT = 16;
+// Leaves with more primitives are always split, smaller ones only if the SAH says so
+const uint32_t BVH_MAX_LEAF_SIZE = 4;
+// Subtrees with more primitives are built as a task of their own
+const uint32_t BVH_PARALLEL_SUBTREE_SIZE = 4096;
+// Nodes with more primitives compute their bounds and bins on the JobSystem
+const uint32_t BVH_PARALLEL_BINNING_SIZE = 65536;
+// SAH cost of visiting a node relative to testing one voxel
+const float BVH_TRAVERSAL_COST = 1.0f;
+
+// Bounding volume hierarchy over voxels, it takes any size and position but the Scene currently hands it the voxels of its
+// VoxelWorld, one size on the integer grid like the other structures.
+// Built top down with the binned surface area heuristic, both children of large nodes are built in parallel on the JobSystem
+// and the tree is flattened depth first into 32 byte BvhNodes for shader.comp.
+// Refit keeps the topology and only recomputes the bounds, for voxels that moved a little.
+class VoxelBvh
+{
+public:
+	void Build(const std::vector<Voxel>& a_voxel);
+	// a_voxel has to be the voxels of the last Build in the same order, only their positions and sizes may have changed
+	void Refit(const std::vector<Voxel>& a_voxel);
+
+	// Never empty, an empty bvh is a root with inverted bounds no ray hits
+	const std::vector<BvhNode>& GetNodes() const;
+	const std::vector<BvhPrimitive>& GetPrimitives() const;
+
+	void PrintStats() const;
+
+private:
+	struct Bounds
+	{
+		glm::vec3 min = glm::vec3(FLT_MAX);
+		glm::vec3 max = glm::vec3(-FLT_MAX);
+
+		void Grow(const glm::vec3& a_point);
+		void Grow(const Bounds& a_bounds);
+		float GetArea() const;
+	};
+
+	struct Bin
+	{
+		Bounds bounds;
+		uint32_t count = 0;
+	};
+
+	// Voxel during the build, partitioned in place so every node reads a contiguous range. Voxels are cubes, center and half size are its bounds
+	struct BuildPrimitive
+	{
+		glm::vec3 center;
+		float halfSize;
+		uint32_t index;		// into the voxels of Build
+	};
+
+	// Node of the tree before it is flattened, children are indices into m_buildNodes
+	struct BuildNode
+	{
+		Bounds bounds;
+		uint32_t first = 0;
+		uint32_t count = 0;
+		uint32_t children[2] = { 0, 0 };
+		bool leaf = true;
+	};
+
+	uint32_t BuildRange(const uint32_t a_first, const uint32_t a_count);
+	void ComputeBounds(const uint32_t a_first, const uint32_t a_count, Bounds& a_bounds, Bounds& a_centroidBounds) const;
+	void ComputeBins(const uint32_t a_first, const uint32_t a_count, const Bounds& a_centroidBounds, Bin* a_bins) const;
+	uint32_t Flatten(const uint32_t a_buildNode, const uint32_t a_depth);
+	BvhPrimitive MakePrimitive(const Voxel& a_voxel) const;
+
+	//every node owns a contiguous range of it
+	std::vector<BuildPrimitive> m_buildPrimitives;
+	//voxel index of every primitive in leaf order, kept for Refit
+	std::vector<uint32_t> m_primitiveIndices;
+	std::vector<BuildNode> m_buildNodes;
+	std::atomic<uint32_t> m_buildNodeCount{ 0 };
+
+	std::vector<BvhNode> m_nodes;
+	std::vector<BvhPrimitive> m_primitives;
+
+	uint32_t m_leafCount = 0;
+	uint32_t m_depth = 0;
+	float m_sahCost = 0.0f;
+	float m_buildTime = 0.0f;		// ms
+	float m_refitTime = 0.0f;		// ms
+};
+#endif // !VOXEL_BVH_H
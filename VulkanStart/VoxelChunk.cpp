@@ -0,0 +1,65 @@
+#include "VoxelChunk.h"
+
+VoxelChunk::VoxelChunk()
+	: VoxelChunk(glm::ivec3(0, 0, 0))
+{
+
+}
+
+VoxelChunk::VoxelChunk(const glm::ivec3& a_coord)
+{
+	m_coord = a_coord;
+	m_material.assign(CHUNK_VOLUME, EMPTY_MATERIAL);
+	m_solidCount = 0;
+}
+
+glm::ivec3 VoxelChunk::GetCoord() const
+{
+	return m_coord;
+}
+
+glm::ivec3 VoxelChunk::GetOrigin() const
+{
+	return m_coord * CHUNK_SIZE;
+}
+
+int VoxelChunk::GetSolidCount() const
+{
+	return m_solidCount;
+}
+
+bool VoxelChunk::IsEmpty() const
+{
+	return m_solidCount == 0;
+}
+
+uint32_t VoxelChunk::GetMaterial(const int a_x, const int a_y, const int a_z) const
+{
+	return m_material[ToIndex(a_x, a_y, a_z)];
+}
+
+bool VoxelChunk::IsSolid(const int a_x, const int a_y, const int a_z) const
+{
+	return m_material[ToIndex(a_x, a_y, a_z)] != EMPTY_MATERIAL;
+}
+
+void VoxelChunk::SetMaterial(const int a_x, const int a_y, const int a_z, const uint32_t a_material)
+{
+	uint32_t& cell = m_material[ToIndex(a_x, a_y, a_z)];
+
+	if (cell == EMPTY_MATERIAL && a_material != EMPTY_MATERIAL) 
+	{
+		m_solidCount++;
+	}
+	else if (cell != EMPTY_MATERIAL && a_material == EMPTY_MATERIAL) 
+	{
+		m_solidCount--;
+	}
+
+	cell = a_material;
+}
+
+const std::vector<uint32_t>& VoxelChunk::GetMaterials() const
+{
+	return m_material;
+}
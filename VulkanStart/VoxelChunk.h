@@ -0,0 +1,39 @@
+#ifndef VOXEL_CHUNK_H
+#define VOXEL_CHUNK_H
+
+#include <glm/glm.hpp>
+#include <vector>
+#include <cstdint>
+
+const int CHUNK_SIZE = 32;
+const int CHUNK_AREA = CHUNK_SIZE * CHUNK_SIZE;
+const int CHUNK_VOLUME = CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE;
+
+// Material 0 marks an empty cell, every other value is a RGBA8 packed colour (alpha is always 255)
+const uint32_t EMPTY_MATERIAL = 0;
+
+class VoxelChunk
+{
+private:
+	glm::ivec3 m_coord;
+	std::vector<uint32_t> m_material;
+	int m_solidCount;
+
+public:
+	VoxelChunk();
+	VoxelChunk(const glm::ivec3& a_coord);
+
+	glm::ivec3 GetCoord() const;
+	glm::ivec3 GetOrigin() const;
+	int GetSolidCount() const;
+	bool IsEmpty() const;
+
+	uint32_t GetMaterial(const int a_x, const int a_y, const int a_z) const;
+	bool IsSolid(const int a_x, const int a_y, const int a_z) const;
+	void SetMaterial(const int a_x, const int a_y, const int a_z, const uint32_t a_material);
+
+	const std::vector<uint32_t>& GetMaterials() const;
+
+	static int ToIndex(const int a_x, const int a_y, const int a_z) { return a_x + a_y * CHUNK_SIZE + a_z * CHUNK_AREA; }
+};
+#endif // !VOXEL_CHUNK_H
@@ -35,12 +35,13 @@ void VoxelEngine::initWindow()
 
 void VoxelEngine::initVulkan()
 {
-	createAndExecuteShaderBat();
+	compileOutdatedShaders();
 	createInstance();
 	setupDebugMessenger();
 	createSurface();
 	pickPhysicalDevice();
 	createLogicalDevice();
+	createPipelineCache();
 	createSwapChain();
 	createImageViews();
 
@@ -49,25 +50,74 @@ void VoxelEngine::initVulkan()
 	createGraphicsPipeline();
 
 	createCommandPool();
+	createUploadResources();
 	createDepthResources();
 	createFramebuffers();
-	createVertexBuffer();
-	createIndexBuffer(); 
+	if (m_renderMode == RenderMode::INSTANCED) 
+	{
+		//every instance draws the same cube, its corners at +-1 are scaled by the instance size in instanced.vert
+		m_vertices = Voxel(glm::vec3(0.0f), glm::vec3(1.0f), 1.0f).GetVertices();
+		m_indices = Voxel::GetIndices();
+	}
+	if (m_renderMode == RenderMode::VERTEX_PULLING) 
+	{
+		//the cube corners are built in pulling.vert, nothing to put into vertex/index buffers
+		m_vertices.clear();
+		m_indices.clear();
+	}
+	else if (m_renderMode == RenderMode::CHUNKED_MESH) 
+	{
+		//every chunk of the freshly generated scene is dirty, the first frame waits for all of them
+		startMeshRebuild();
+		updateMeshRebuild(true);
+	}
+	else 
+	{
+		createVertexBuffer();
+		createIndexBuffer(); 
+	}
+	if (m_renderMode == RenderMode::INSTANCED || m_renderMode == RenderMode::VERTEX_PULLING) 
+	{
+		m_scenes.at(m_currentScene).OverwriteInstances(m_instances);
+		createInstanceBuffer();
+	}
 	createUniformBuffers();
 	createDescriptorPool();
 	createDescriptorSets();
+	if (m_gpuCulling) 
+	{
+		createChunkCullPipeline();
+		createChunkCullDescriptorSets();
+	}
 	createCommandBuffers();
+	if (m_renderMode == RenderMode::CHUNKED_MESH && !m_gpuCulling && !m_multiDrawIndirect) 
+	{
+		createSecondaryCommandBuffers();
+	}
+
+	//the cpu culled chunk draws change with the camera, every other mode only reads the camera from the uniform buffer
+	m_reuseCommandBuffers = m_commandRecording == CommandRecording::REUSED && (m_renderMode != RenderMode::CHUNKED_MESH || m_gpuCulling);
+	if (m_reuseCommandBuffers) 
+	{
+		createReusedCommandBuffers();
+	}
 	createSyncObjects();  
+
+	//the first frame draws from the startup uploads, they are the only ones waited for
+	m_uploadRing.WaitIdle();
+
+	printStartupStats();
 }
 
 void VoxelEngine::initVulkanCompute()
 {
-	createAndExecuteShaderBat();	//same
+	compileOutdatedShaders();		//same
 	createInstance();				//same
 	setupDebugMessenger();			//same
 	createSurface();				//same
 	pickPhysicalDevice();			//same
 	createLogicalDevice();			//same
+	createPipelineCache();			//same
 	createSwapChain();				//same
 	createImageViews();				//same
 
@@ -77,6 +127,7 @@ void VoxelEngine::initVulkanCompute()
 	createFramebuffersCompute();	
 
 	createCommandPool();			//same
+	createUploadResources();		//same
 
 	createShaderStorageBuffersCompute();
 
@@ -90,6 +141,10 @@ void VoxelEngine::initVulkanCompute()
 	createCommandBuffersCompute();
 
 	createSyncObjects();			//same
+
+	m_uploadRing.WaitIdle();		//same
+
+	printStartupStats();			//same
 }
 
 
@@ -130,33 +185,63 @@ void VoxelEngine::cleanup()
 
 	vkDestroyPipeline(m_logicalDevice, m_pipelineCompute, nullptr);
 	vkDestroyPipeline(m_logicalDevice, m_graphicsPipeline, nullptr); 
+	vkDestroyPipeline(m_logicalDevice, m_cullPipeline, nullptr);
+	m_pipelineCache.Destroy();
 
 	vkDestroyPipelineLayout(m_logicalDevice, m_pipelineLayout, nullptr); 
 	vkDestroyPipelineLayout(m_logicalDevice, m_pipelineLayoutCompute, nullptr);
+	vkDestroyPipelineLayout(m_logicalDevice, m_cullPipelineLayout, nullptr);
 
 	vkDestroyRenderPass(m_logicalDevice, m_renderPass, nullptr); 
 
 	for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
 		vkDestroyBuffer(m_logicalDevice, m_uniformBuffers[i], nullptr);
-		vkFreeMemory(m_logicalDevice, m_uniformBuffersMemory[i], nullptr);
+		m_allocator.Free(m_uniformBuffersMemory[i]);
 	}
 
 	vkDestroyDescriptorPool(m_logicalDevice, m_descriptorPool, nullptr); 
 
 	vkDestroyDescriptorSetLayout(m_logicalDevice, m_descriptorSetLayout, nullptr);
 	vkDestroyDescriptorSetLayout(m_logicalDevice, m_descriptorSetLayoutCompute, nullptr);
+	vkDestroyDescriptorPool(m_logicalDevice, m_cullDescriptorPool, nullptr);
+	vkDestroyDescriptorSetLayout(m_logicalDevice, m_cullDescriptorSetLayout, nullptr);
+
+	//a rebuild still in flight is finished first, it owns buffers as well and may swap in a new m_vertexBuffer
+	m_pendingEdits.clear();
+	updateMeshRebuild(true);
+	freeRetiredBuffers(true);
 
 	vkDestroyBuffer(m_logicalDevice, m_indexBuffer, nullptr);
-	vkFreeMemory(m_logicalDevice, m_indexBufferMemory, nullptr);
+	m_allocator.Free(m_indexBufferMemory);
 
 	vkDestroyBuffer(m_logicalDevice, m_vertexBuffer, nullptr);
-	vkFreeMemory(m_logicalDevice, m_vertexBufferMemory, nullptr);
+	m_allocator.Free(m_vertexBufferMemory);
+
+	vkDestroyBuffer(m_logicalDevice, m_instanceBuffer, nullptr);
+	m_allocator.Free(m_instanceBufferMemory);
+
+	if (!m_useCompute && m_renderMode == RenderMode::CHUNKED_MESH) 
+	{
+		m_chunkArena.PrintStats();
+		m_chunkArena.Destroy();
+	}
 
 	vkDestroyBuffer(m_logicalDevice, m_voxelBuffer, nullptr);
-	vkFreeMemory(m_logicalDevice, m_voxelBufferMemory, nullptr);
+	m_allocator.Free(m_voxelBufferMemory);
+	vkDestroyBuffer(m_logicalDevice, m_traceGridBuffer, nullptr);
+	m_allocator.Free(m_traceGridBufferMemory);
+	vkDestroyBuffer(m_logicalDevice, m_bvhNodeBuffer, nullptr);
+	m_allocator.Free(m_bvhNodeBufferMemory);
+	vkDestroyBuffer(m_logicalDevice, m_bvhPrimitiveBuffer, nullptr);
+	m_allocator.Free(m_bvhPrimitiveBufferMemory);
+	vkDestroyBuffer(m_logicalDevice, m_svoBuffer, nullptr);
+	m_allocator.Free(m_svoBufferMemory);
+	vkDestroyBuffer(m_logicalDevice, m_dagBuffer, nullptr);
+	m_allocator.Free(m_dagBufferMemory);
+	destroyBrickMapBuffers();
 
 	vkDestroyImage(m_logicalDevice, m_textureImage, nullptr);
-	vkFreeMemory(m_logicalDevice, m_textureImageMemory, nullptr);
+	m_allocator.Free(m_textureImageMemory);
 	vkDestroyImageView(m_logicalDevice, m_textureImageView, nullptr);
 	vkDestroySampler(m_logicalDevice, m_textureSampler, nullptr);
 
@@ -171,6 +256,16 @@ void VoxelEngine::cleanup()
 	}
 
 	vkDestroyCommandPool(m_logicalDevice, m_commandPool, nullptr);
+	for (RecordingSlot& slot : m_recordingSlots) {
+		vkDestroyCommandPool(m_logicalDevice, slot.commandPool, nullptr);
+	}
+	m_recordingSlots.clear();
+
+	m_uploadRing.PrintStats();
+	m_uploadRing.Destroy();
+
+	m_allocator.PrintStats();
+	m_allocator.Destroy();
 
 	vkDestroyDevice(m_logicalDevice, nullptr);
 
@@ -212,6 +307,60 @@ void VoxelEngine::processInput()
 		if (glfwGetKey(m_pWindow, GLFW_KEY_U) == GLFW_PRESS) {
 			updateBuffers();
 		}
+
+		bool memoryStatsKeyDown = glfwGetKey(m_pWindow, GLFW_KEY_M) == GLFW_PRESS;
+		if (memoryStatsKeyDown && !m_memoryStatsKeyDown) {
+			m_allocator.PrintStats();
+			m_uploadRing.PrintStats();
+
+			if (!m_useCompute && m_renderMode == RenderMode::CHUNKED_MESH) 
+			{
+				m_chunkArena.PrintStats();
+			}
+		}
+		m_memoryStatsKeyDown = memoryStatsKeyDown;
+
+		bool benchmarkKeyDown = glfwGetKey(m_pWindow, GLFW_KEY_B) == GLFW_PRESS;
+		if (benchmarkKeyDown && !m_benchmarkKeyDown) {
+			benchmarkMeshing();
+			benchmarkUploads();
+		}
+		m_benchmarkKeyDown = benchmarkKeyDown;
+
+		bool fillKeyDown = glfwGetKey(m_pWindow, GLFW_KEY_E) == GLFW_PRESS;
+		if (fillKeyDown && !m_fillKeyDown) {
+			editSceneAtCamera(VoxelWorld::PackColor(glm::vec3(1.0f, 0.5f, 0.0f)));
+		}
+		m_fillKeyDown = fillKeyDown;
+
+		bool carveKeyDown = glfwGetKey(m_pWindow, GLFW_KEY_R) == GLFW_PRESS;
+		if (carveKeyDown && !m_carveKeyDown) {
+			editSceneAtCamera(EMPTY_MATERIAL);
+		}
+		m_carveKeyDown = carveKeyDown;
+	}
+	else if (m_rayTracingStructure == RayTracingStructure::BRICK_MAP)
+	{
+		//the brick map is the one structure the compute path updates in place
+		bool fillKeyDown = glfwGetKey(m_pWindow, GLFW_KEY_E) == GLFW_PRESS;
+		if (fillKeyDown && !m_fillKeyDown) {
+			editSceneAtCamera(VoxelWorld::PackColor(glm::vec3(1.0f, 0.5f, 0.0f)));
+		}
+		m_fillKeyDown = fillKeyDown;
+
+		bool carveKeyDown = glfwGetKey(m_pWindow, GLFW_KEY_R) == GLFW_PRESS;
+		if (carveKeyDown && !m_carveKeyDown) {
+			editSceneAtCamera(EMPTY_MATERIAL);
+		}
+		m_carveKeyDown = carveKeyDown;
+	}
+	else if (m_rayTracingStructure == RayTracingStructure::BVH)
+	{
+		bool refitKeyDown = glfwGetKey(m_pWindow, GLFW_KEY_T) == GLFW_PRESS;
+		if (refitKeyDown && !m_refitKeyDown) {
+			moveBvhVoxels();
+		}
+		m_refitKeyDown = refitKeyDown;
 	}
 
 	//Mouse Input for Camera Movement
@@ -361,22 +510,75 @@ bool VoxelEngine::checkValidationLayerSupport()
 	return true;
 }
 
-void VoxelEngine::createAndExecuteShaderBat()
+void VoxelEngine::compileOutdatedShaders()
 {
-	std::ofstream batch; 
-	batch.open("shaderbatchfile.bat", std::ios::out);
+	auto start = std::chrono::high_resolution_clock::now();
+
+	//source and SPIR-V, the same pairs as the CustomBuild items of the project and shaders/manuelCompile.bat
+	const std::array<std::pair<const char*, const char*>, 9> shaders = { {
+		{ "shaders/shader.vert", "shaders/vert.spv" },
+		{ "shaders/shader.frag", "shaders/frag.spv" },
+		{ "shaders/instanced.vert", "shaders/instancedvert.spv" },
+		{ "shaders/pulling.vert", "shaders/pullingvert.spv" },
+		{ "shaders/packed.vert", "shaders/packedvert.spv" },
+		{ "shaders/cull.comp", "shaders/cullcomp.spv" },
+
+		{ "shaders/shader.comp", "shaders/comp.spv" },
+		{ "shaders/compshader.vert", "shaders/compvert.spv" },
+		{ "shaders/compshader.frag", "shaders/compfrag.spv" }
+	} };
+
+	std::vector<std::string> commands;
+	for (const auto& shader : shaders) {
+		//a missing source (started outside of the project) keeps the shipped .spv
+		std::error_code error;
+		auto sourceTime = std::filesystem::last_write_time(shader.first, error);
+		if (error)
+		{
+			continue;
+		}
+
+		auto spirvTime = std::filesystem::last_write_time(shader.second, error);
+		if (!error && spirvTime >= sourceTime)
+		{
+			continue;
+		}
+
+		commands.push_back(std::string("glslc.exe ") + shader.first + " -o " + shader.second);
+	}
 
-	batch << "glslc.exe shaders/shader.vert -o shaders/vert.spv\n";
-	batch << "glslc.exe shaders/shader.frag -o shaders/frag.spv\n";
+	//up to date after a build, no shell is started
+	if (!commands.empty()) 
+	{
+		std::ofstream batch; 
+		batch.open("shaderbatchfile.bat", std::ios::out);
 
-	batch << "glslc.exe shaders/shader.comp -o shaders/comp.spv\n";
-	batch << "glslc.exe shaders/compshader.vert -o shaders/compvert.spv\n";
-	batch << "glslc.exe shaders/compshader.frag -o shaders/compfrag.spv\n";
+		for (const std::string& command : commands) {
+			batch << command << "\n";
+		}
 
-	batch.close();
+		batch.close();
 	
-	system("shaderbatchfile.bat");
-	std::filesystem::remove("shaderbatchfile.bat"); 
+		system("shaderbatchfile.bat");
+		std::filesystem::remove("shaderbatchfile.bat"); 
+	}
+
+	m_compiledShaderCount = static_cast<uint32_t>(commands.size());
+	m_shaderCompileTime = std::chrono::duration<float, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+void VoxelEngine::printStartupStats()
+{
+	auto currentTime = std::chrono::high_resolution_clock::now();
+
+	std::cout << "" << std::endl;
+	std::cout << "Startup: initialized after " << std::chrono::duration<float, std::chrono::milliseconds::period>(currentTime - startTime).count() 
+		<< " ms, shader check took " << m_shaderCompileTime << " ms (" << m_compiledShaderCount << " shaders recompiled)" << std::endl;
+
+	m_pipelineCache.PrintStats();
+
+	//every pipeline exists now, the next start reads them from the cache
+	m_pipelineCache.Save();
 }
 
 std::vector<const char*> VoxelEngine::getRequiredExtensions()
@@ -519,6 +721,14 @@ void VoxelEngine::createLogicalDevice()
 	std::cout << "The " << indices.graphicsAndComputeFamily.value() << "th QueueFamily supports every required QueueFlag for graphical needs!" << std::endl;
 	std::cout << "The " << indices.presentFamily.value() << "th QueueFamily supports presentation to a surface!" << std::endl;
 
+	if (indices.transferFamily.has_value()) {
+		uniqueQueueFamilies.insert(indices.transferFamily.value());
+		std::cout << "The " << indices.transferFamily.value() << "th QueueFamily is a dedicated transfer family, uploads run on it!" << std::endl;
+	}
+	else {
+		std::cout << "No dedicated transfer QueueFamily, uploads run on the graphics queue!" << std::endl;
+	}
+
 
 	float queuePriority = 1.0f;
 	for (uint32_t queueFamily : uniqueQueueFamilies) { 
@@ -530,7 +740,46 @@ void VoxelEngine::createLogicalDevice()
 		queueCreateInfos.push_back(queueCreateInfo); 
 	}
 
+	//the chunk mesh arena draws each page with one vkCmdDrawIndexedIndirect, firstInstance picks the chunk draw data
+	VkPhysicalDeviceFeatures supportedFeatures;
+	vkGetPhysicalDeviceFeatures(m_physicalDevice, &supportedFeatures);
+
 	VkPhysicalDeviceFeatures deviceFeatures{};
+	deviceFeatures.multiDrawIndirect = supportedFeatures.multiDrawIndirect;
+	deviceFeatures.drawIndirectFirstInstance = supportedFeatures.drawIndirectFirstInstance;
+	m_multiDrawIndirect = supportedFeatures.multiDrawIndirect && supportedFeatures.drawIndirectFirstInstance;
+
+	std::cout << (m_multiDrawIndirect ? "Multi draw indirect is supported, chunks are drawn with one indirect draw per arena page!" 
+		: "No multi draw indirect, chunks are drawn one by one!") << std::endl;
+
+	//the gpu culling writes the indirect draws itself, with VK_KHR_draw_indirect_count it also writes how many there are
+	m_gpuCulling = m_chunkCulling == ChunkCulling::GPU && m_renderMode == RenderMode::CHUNKED_MESH && !m_useCompute && m_multiDrawIndirect;
+
+	std::vector<const char*> enabledExtensions = deviceExtensions;
+	bool drawIndirectCount = false;
+	if (m_gpuCulling) 
+	{
+		uint32_t extensionCount;
+		vkEnumerateDeviceExtensionProperties(m_physicalDevice, nullptr, &extensionCount, nullptr);
+
+		std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+		vkEnumerateDeviceExtensionProperties(m_physicalDevice, nullptr, &extensionCount, availableExtensions.data());
+
+		for (const auto& extension : availableExtensions) {
+			if (strcmp(extension.extensionName, VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME) == 0) 
+			{
+				drawIndirectCount = true;
+				enabledExtensions.push_back(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+			}
+		}
+	}
+
+	if (m_chunkCulling == ChunkCulling::GPU && m_renderMode == RenderMode::CHUNKED_MESH && !m_useCompute) 
+	{
+		std::cout << (!m_gpuCulling ? "No multi draw indirect, chunks are culled on the CPU!" 
+			: drawIndirectCount ? "Chunks are culled on the GPU and drawn with vkCmdDrawIndexedIndirectCountKHR!" 
+			: "Chunks are culled on the GPU, no draw indirect count, culled chunks stay in the indirect draws with instanceCount 0!") << std::endl;
+	}
 
 	VkDeviceCreateInfo createInfo{};
 	createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
@@ -540,8 +789,8 @@ void VoxelEngine::createLogicalDevice()
 
 	createInfo.pEnabledFeatures = &deviceFeatures;
 
-	createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-	createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+	createInfo.enabledExtensionCount = static_cast<uint32_t>(enabledExtensions.size());
+	createInfo.ppEnabledExtensionNames = enabledExtensions.data();
 
 	if (enableValidationLayers) {
 		createInfo.enabledLayerCount = static_cast<uint32_t>(validationLayers.size());
@@ -568,9 +817,31 @@ void VoxelEngine::createLogicalDevice()
 
 	}
 
+	if (drawIndirectCount) 
+	{
+		m_vkCmdDrawIndexedIndirectCount = (PFN_vkCmdDrawIndexedIndirectCountKHR)vkGetDeviceProcAddr(m_logicalDevice, "vkCmdDrawIndexedIndirectCountKHR");
+	}
+
 	vkGetDeviceQueue(m_logicalDevice, indices.graphicsAndComputeFamily.value(), 0, &m_graphicsQueue);
 	vkGetDeviceQueue(m_logicalDevice, indices.graphicsAndComputeFamily.value(), 0, &m_queueCompute);
 	vkGetDeviceQueue(m_logicalDevice, indices.presentFamily.value(), 0, &m_presentQueue);
+
+	m_transferQueue = m_graphicsQueue;
+	if (indices.transferFamily.has_value()) {
+		vkGetDeviceQueue(m_logicalDevice, indices.transferFamily.value(), 0, &m_transferQueue);
+	}
+
+	//every buffer and image memory is sub allocated from here on
+	m_allocator.Init(m_physicalDevice, m_logicalDevice);
+}
+
+void VoxelEngine::createPipelineCache()
+{
+	//the cache file carries the device and driver it was written by, Create drops it if they differ
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(m_physicalDevice, &properties);
+
+	m_pipelineCache.Create(m_logicalDevice, properties, PIPELINE_CACHE_PATH);
 }
 
 void VoxelEngine::createSurface()
@@ -789,7 +1060,12 @@ static std::vector<char> readFile(const std::string &filename)
 
 void VoxelEngine::createGraphicsPipeline()
 {
-	auto vertShaderCode = readFile("shaders/vert.spv");
+	std::string vertShaderPath = "shaders/vert.spv";
+	if (m_renderMode == RenderMode::INSTANCED) { vertShaderPath = "shaders/instancedvert.spv"; }
+	if (m_renderMode == RenderMode::VERTEX_PULLING) { vertShaderPath = "shaders/pullingvert.spv"; }
+	if (m_renderMode == RenderMode::CHUNKED_MESH) { vertShaderPath = "shaders/packedvert.spv"; }
+
+	auto vertShaderCode = readFile(vertShaderPath);
 	auto fragShaderCode = readFile("shaders/frag.spv");
 
 	VkShaderModule vertShaderModule = createShaderModule(vertShaderCode);
@@ -813,12 +1089,37 @@ void VoxelEngine::createGraphicsPipeline()
 	VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
 	vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
 
-	auto bindingDescription = Vertex::getBindingDescription();
-	auto attributeDescriptions = Vertex::getAttributeDescriptions();
+	auto vertexAttributeDescriptions = Vertex::getAttributeDescriptions();
 
-	vertexInputInfo.vertexBindingDescriptionCount = 1;
+	std::vector<VkVertexInputBindingDescription> bindingDescriptions = { Vertex::getBindingDescription() };
+	std::vector<VkVertexInputAttributeDescription> attributeDescriptions(vertexAttributeDescriptions.begin(), vertexAttributeDescriptions.end());
+
+	if (m_renderMode == RenderMode::INSTANCED) 
+	{
+		//the cube only needs its corner positions, colour comes per instance
+		auto instanceAttributeDescriptions = VoxelInstance::getAttributeDescriptions();
+
+		bindingDescriptions.push_back(VoxelInstance::getBindingDescription());
+		attributeDescriptions = { vertexAttributeDescriptions[0] };
+		attributeDescriptions.insert(attributeDescriptions.end(), instanceAttributeDescriptions.begin(), instanceAttributeDescriptions.end());
+	}
+	else if (m_renderMode == RenderMode::VERTEX_PULLING) 
+	{
+		//everything is read from the voxel storage buffer
+		bindingDescriptions.clear();
+		attributeDescriptions.clear();
+	}
+	else if (m_renderMode == RenderMode::CHUNKED_MESH) 
+	{
+		auto packedAttributeDescriptions = PackedVertex::getAttributeDescriptions();
+
+		bindingDescriptions = { PackedVertex::getBindingDescription() };
+		attributeDescriptions.assign(packedAttributeDescriptions.begin(), packedAttributeDescriptions.end());
+	}
+
+	vertexInputInfo.vertexBindingDescriptionCount = static_cast<uint32_t>(bindingDescriptions.size());
 	vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
-	vertexInputInfo.pVertexBindingDescriptions = &bindingDescription; 
+	vertexInputInfo.pVertexBindingDescriptions = bindingDescriptions.data(); 
 	vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data(); 
 
 
@@ -926,7 +1227,7 @@ void VoxelEngine::createGraphicsPipeline()
 	pipelineInfo.subpass = 0; 
 	pipelineInfo.basePipelineHandle = VK_NULL_HANDLE; 
 
-	if (vkCreateGraphicsPipelines(m_logicalDevice, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &m_graphicsPipeline) != VK_SUCCESS) {
+	if (m_pipelineCache.CreateGraphicsPipeline(pipelineInfo, m_graphicsPipeline) != VK_SUCCESS) {
 		throw std::runtime_error("failed to create graphics pipeline!");
 	}
 	else {
@@ -1013,10 +1314,21 @@ void VoxelEngine::createDescriptorLayout()
 	uboLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
 	uboLayoutBinding.pImmutableSamplers = nullptr; // Optional 
 
+	VkDescriptorSetLayoutBinding voxelLayoutBinding{};
+	voxelLayoutBinding.binding = 1;
+	voxelLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	voxelLayoutBinding.descriptorCount = 1;
+	voxelLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+	voxelLayoutBinding.pImmutableSamplers = nullptr;
+
+	std::array<VkDescriptorSetLayoutBinding, 2> bindings = { uboLayoutBinding, voxelLayoutBinding };
+
 	VkDescriptorSetLayoutCreateInfo layoutInfo{};
 	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-	layoutInfo.bindingCount = 1;
-	layoutInfo.pBindings = &uboLayoutBinding;
+	//binding 1 holds the voxel records for vertex pulling and the chunk draw data for the chunked mode
+	bool storageBinding = m_renderMode == RenderMode::VERTEX_PULLING || m_renderMode == RenderMode::CHUNKED_MESH;
+	layoutInfo.bindingCount = storageBinding ? 2 : 1;
+	layoutInfo.pBindings = bindings.data();
 
 	if (vkCreateDescriptorSetLayout(m_logicalDevice, &layoutInfo, nullptr, &m_descriptorSetLayout) != VK_SUCCESS) {
 		throw std::runtime_error("failed to create descriptor set layout!");
@@ -1099,44 +1411,21 @@ void VoxelEngine::createCommandPool()
 void VoxelEngine::createVertexBuffer()
 {
 	VkDeviceSize bufferSize = sizeof(m_vertices[0]) * m_vertices.size();
-	VkBuffer stagingBuffer; 
-	VkDeviceMemory stagingBufferMemory; 
-	createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, 
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory); 
-
-	void* data;
-	vkMapMemory(m_logicalDevice, stagingBufferMemory, 0, bufferSize, 0, &data);
-	memcpy(data, m_vertices.data(), (size_t)bufferSize);
-	vkUnmapMemory(m_logicalDevice, stagingBufferMemory);
-
-	createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, 
-		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_vertexBuffer, m_vertexBufferMemory);
 
-	copyBuffer(stagingBuffer, m_vertexBuffer, bufferSize);
-
-	vkDestroyBuffer(m_logicalDevice, stagingBuffer, nullptr);
-	vkFreeMemory(m_logicalDevice, stagingBufferMemory, nullptr);
-}
-
-uint32_t VoxelEngine::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties)
-{ 
-	VkPhysicalDeviceMemoryProperties memProperties; 
-	vkGetPhysicalDeviceMemoryProperties(m_physicalDevice, &memProperties); 
-
-	std::cout << "" << std::endl;
-	std::cout << "Memory Type Count: " << memProperties.memoryTypeCount << std::endl;
-	std::cout << "Memory Heap Count: " << memProperties.memoryHeapCount << std::endl;
-
-	for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) { 
-		if (typeFilter & (1 << i) && (memProperties.memoryTypes[i].propertyFlags & properties) == properties) {
-			return i; 
-		}
+	//an empty scene has nothing to upload, recordCommandBuffer skips the draw
+	if (bufferSize == 0) 
+	{
+		return;
 	}
 
-	throw std::runtime_error("failed to find suitable memory type!");
+	createUploadBuffer(bufferSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, m_uploadPolicy, m_vertexBuffer, m_vertexBufferMemory);
+
+	//written directly or copied with the next batch of the upload ring, the end of initVulkan waits for it
+	uploadBuffer(m_vertexBuffer, m_vertexBufferMemory, m_uploadPolicy, m_vertices.data(), bufferSize);
 }
 
-void VoxelEngine::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory)
+void VoxelEngine::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, MemoryAllocation& bufferMemory, 
+	AllocationLifetime lifetime)
 {
 	VkBufferCreateInfo bufferInfo{};
 	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
@@ -1151,182 +1440,863 @@ void VoxelEngine::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMe
 	VkMemoryRequirements memRequirements;
 	vkGetBufferMemoryRequirements(m_logicalDevice, buffer, &memRequirements);
 
-	VkMemoryAllocateInfo allocInfo{};
-	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-	allocInfo.allocationSize = memRequirements.size;
-	allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
-
-	if (vkAllocateMemory(m_logicalDevice, &allocInfo, nullptr, &bufferMemory) != VK_SUCCESS) {
-		throw std::runtime_error("failed to allocate buffer memory!");
-	}
-	else {
-		std::cout << "" << std::endl;
-		std::cout << "Success: allocated vertex buffer memory" << std::endl;
-	}
+	//sub allocated, only new blocks cost a vkAllocateMemory
+	bufferMemory = m_allocator.Allocate(memRequirements, properties, AllocationKind::BUFFER, lifetime);
 
-	vkBindBufferMemory(m_logicalDevice, buffer, bufferMemory, 0);
+	vkBindBufferMemory(m_logicalDevice, buffer, bufferMemory.memory, bufferMemory.offset);
 }
 
-void VoxelEngine::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size)
+void VoxelEngine::createIndexBuffer()
 {
-	VkCommandBufferAllocateInfo allocInfo{};
-	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-	allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-	allocInfo.commandPool = m_commandPool;
-	allocInfo.commandBufferCount = 1;
-
-	VkCommandBuffer commandBuffer;
-	vkAllocateCommandBuffers(m_logicalDevice, &allocInfo, &commandBuffer);
+	VkDeviceSize bufferSize = sizeof(m_indices[0]) * m_indices.size();
+	m_indexCount = static_cast<uint32_t>(m_indices.size());
 
-	VkCommandBufferBeginInfo beginInfo{};
-	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	if (bufferSize == 0) 
+	{
+		return;
+	}
 
-	vkBeginCommandBuffer(commandBuffer, &beginInfo);
+	createUploadBuffer(bufferSize, VK_BUFFER_USAGE_INDEX_BUFFER_BIT, m_uploadPolicy, m_indexBuffer, m_indexBufferMemory);
 
-	VkBufferCopy copyRegion{};
-	copyRegion.srcOffset = 0; // Optional
-	copyRegion.dstOffset = 0; // Optional
-	copyRegion.size = size;
-	vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
+	uploadBuffer(m_indexBuffer, m_indexBufferMemory, m_uploadPolicy, m_indices.data(), bufferSize);
+}
 
-	vkEndCommandBuffer(commandBuffer); 
+void VoxelEngine::createUploadResources()
+{
+	QueueFamilyIndices queueFamilyIndices = findQueueFamilies(m_physicalDevice, false);
 
-	VkSubmitInfo submitInfo{};
-	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-	submitInfo.commandBufferCount = 1;
-	submitInfo.pCommandBuffers = &commandBuffer;
+	//every upload, from the startup buffers to the mesh rebuilds on the workers, is staged in the ring and copied once per frame
+	uint32_t graphicsFamily = queueFamilyIndices.graphicsAndComputeFamily.value();
+	m_uploadRing.Init(m_logicalDevice, &m_allocator, m_transferQueue, queueFamilyIndices.transferFamily.value_or(graphicsFamily), 
+		m_graphicsQueue, graphicsFamily);
 
-	vkQueueSubmit(m_graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
-	vkQueueWaitIdle(m_graphicsQueue);
+	if (!m_useCompute && m_renderMode == RenderMode::CHUNKED_MESH) 
+	{
+		m_chunkArena.Init(m_logicalDevice, &m_allocator, &m_uploadRing, useDirectWrite(m_uploadPolicy), MAX_FRAMES_IN_FLIGHT);
+	}
 
-	vkFreeCommandBuffers(m_logicalDevice, m_commandPool, 1, &commandBuffer);
+	std::cout << "" << std::endl;
+	std::cout << "Upload policy: " << (useDirectWrite(m_uploadPolicy) ? "direct writes into device local host visible memory" : "staged through the upload ring") 
+		<< std::endl;
 }
 
-void VoxelEngine::createIndexBuffer()
+bool VoxelEngine::useDirectWrite(const UploadPolicy a_policy)
 {
-	VkDeviceSize bufferSize = sizeof(m_indices[0]) * m_indices.size();
-
-	VkBuffer stagingBuffer;
-	VkDeviceMemory stagingBufferMemory;
-	createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, 
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
+	return a_policy == UploadPolicy::DIRECT_WRITE && m_allocator.HasDirectWriteMemory();
+}
 
-	void* data;
-	vkMapMemory(m_logicalDevice, stagingBufferMemory, 0, bufferSize, 0, &data);
-	memcpy(data, m_indices.data(), (size_t)bufferSize);
-	vkUnmapMemory(m_logicalDevice, stagingBufferMemory);
+void VoxelEngine::createUploadBuffer(VkDeviceSize a_size, VkBufferUsageFlags a_usage, const UploadPolicy a_policy, VkBuffer& a_buffer, 
+	MemoryAllocation& a_bufferMemory)
+{
+	if (useDirectWrite(a_policy)) 
+	{
+		//the cpu writes the final buffer, no staging space and no copy on the gpu
+		createBuffer(a_size, a_usage, DIRECT_WRITE_MEMORY_PROPERTIES, a_buffer, a_bufferMemory);
+		return;
+	}
 
-	createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, 
-		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_indexBuffer, m_indexBufferMemory);
+	createBuffer(a_size, a_usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, a_buffer, a_bufferMemory);
+}
 
-	copyBuffer(stagingBuffer, m_indexBuffer, bufferSize);
+uint64_t VoxelEngine::uploadBuffer(VkBuffer a_buffer, const MemoryAllocation& a_bufferMemory, const UploadPolicy a_policy, const void* a_data, 
+	VkDeviceSize a_size)
+{
+	//integrated GPUs map plain device local memory as well, the policy decides and not the allocation
+	if (useDirectWrite(a_policy)) 
+	{
+		//host coherent, the next queue submit makes the writes visible to the gpu
+		memcpy(a_bufferMemory.mapped, a_data, a_size);
+		return 0;
+	}
 
-	vkDestroyBuffer(m_logicalDevice, stagingBuffer, nullptr);
-	vkFreeMemory(m_logicalDevice, stagingBufferMemory, nullptr);
+	return m_uploadRing.Upload(a_buffer, 0, a_data, a_size);
 }
 
-void VoxelEngine::createUniformBuffers()
+void VoxelEngine::startMeshRebuild()
 {
-	VkDeviceSize bufferSize = sizeof(UniformBufferObject);
+	if (m_meshRebuild) 
+	{
+		//picked up as soon as the running rebuild is swapped in
+		m_meshRebuildQueued = true;
+		return;
+	}
 
-	m_uniformBuffers.resize(MAX_FRAMES_IN_FLIGHT);
-	m_uniformBuffersMemory.resize(MAX_FRAMES_IN_FLIGHT);
-	m_uniformBuffersMapped.resize(MAX_FRAMES_IN_FLIGHT);
+	m_meshRebuildQueued = false;
 
-	for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-		createBuffer(bufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, 
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, 
-			m_uniformBuffers[i], m_uniformBuffersMemory[i]);
+	Scene& scene = m_scenes.at(m_currentScene);
+	bool chunked = m_renderMode == RenderMode::CHUNKED_MESH;
 
-		vkMapMemory(m_logicalDevice, m_uniformBuffersMemory[i], 0, bufferSize, 0, &m_uniformBuffersMapped[i]);
+	if (chunked && !scene.GetWorld().HasDirtyChunks()) 
+	{
+		return;
 	}
-}
 
-void VoxelEngine::createDescriptorPool() 
-{
-	VkDescriptorPoolSize poolSize{};
-	poolSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-	poolSize.descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+	m_meshRebuild.reset(new MeshRebuild());
+	MeshRebuild* rebuild = m_meshRebuild.get();
+	rebuild->chunked = chunked;
+	rebuild->startTime = std::chrono::high_resolution_clock::now();
 
-	VkDescriptorPoolCreateInfo poolInfo{};
-	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-	poolInfo.poolSizeCount = 1;
-	poolInfo.pPoolSizes = &poolSize;
-	poolInfo.maxSets = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+	//the chunked mode only replaces the dirty chunks, the expanded mesh is always built as a whole
+	std::vector<glm::ivec3> dirtyChunks = scene.GetWorld().TakeDirtyChunks();
+	rebuild->chunkCoords = chunked ? dirtyChunks : scene.GetWorld().GetChunkCoords();
 
-	if (vkCreateDescriptorPool(m_logicalDevice, &poolInfo, nullptr, &m_descriptorPool) != VK_SUCCESS) {
-		throw std::runtime_error("failed to create descriptor pool!");
-	}
+	rebuild->group.Run([this, rebuild]() { recordMeshRebuild(*rebuild); });
+
+	//the render thread only looks at the flag, it never waits for the group between frames
+	rebuild->group.ContinueWith([rebuild]() { rebuild->readyToSwap = true; });
 }
 
-void VoxelEngine::createDescriptorSets()
+void VoxelEngine::recordMeshRebuild(MeshRebuild& a_rebuild)
 {
-	std::vector<VkDescriptorSetLayout> layouts(MAX_FRAMES_IN_FLIGHT, m_descriptorSetLayout);
-	VkDescriptorSetAllocateInfo allocInfo{};
-	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-	allocInfo.descriptorPool = m_descriptorPool;
-	allocInfo.descriptorSetCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
-	allocInfo.pSetLayouts = layouts.data();
+	//runs on a JobSystem worker, the scene is not edited until the group of the rebuild is done
+	Scene& scene = m_scenes.at(m_currentScene);
+	MeshLayout& layout = a_rebuild.layout;
 
-	m_descriptorSets.resize(MAX_FRAMES_IN_FLIGHT); 
+	layout = scene.PrepareMesh(m_meshingMode, a_rebuild.chunkCoords);
 
-	if (vkAllocateDescriptorSets(m_logicalDevice, &allocInfo, m_descriptorSets.data()) != VK_SUCCESS) {
-		throw std::runtime_error("failed to allocate descriptor sets!");
+	if (a_rebuild.chunked) 
+	{
+		recordChunkMeshes(a_rebuild);
+		return;
 	}
-	else {
-		std::cout << "" << std::endl;
-		std::cout << "Success: allocated descriptor sets" << std::endl;
+
+	VkDeviceSize vertexBufferSize = sizeof(Vertex) * layout.vertexCount;
+	VkDeviceSize indexBufferSize = sizeof(uint32_t) * layout.indexCount;
+
+	if (indexBufferSize == 0) 
+	{
+		a_rebuild.meshedTime = std::chrono::high_resolution_clock::now();
+		return;
 	}
 
-	for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-		VkDescriptorBufferInfo bufferInfo{};
-		bufferInfo.buffer = m_uniformBuffers[i];
-		bufferInfo.offset = 0;
-		bufferInfo.range = sizeof(UniformBufferObject);
+	ChunkGpuMesh mesh{};
+	mesh.indexCount = layout.indexCount;
 
-		VkWriteDescriptorSet descriptorWrite{};
-		descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-		descriptorWrite.dstSet = m_descriptorSets[i];
-		descriptorWrite.dstBinding = 0;
-		descriptorWrite.dstArrayElement = 0;
-		descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-		descriptorWrite.descriptorCount = 1;
-		descriptorWrite.pBufferInfo = &bufferInfo;
+	createUploadBuffer(vertexBufferSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, m_uploadPolicy, mesh.vertexBuffer, mesh.vertexBufferMemory);
+	createUploadBuffer(indexBufferSize, VK_BUFFER_USAGE_INDEX_BUFFER_BIT, m_uploadPolicy, mesh.indexBuffer, mesh.indexBufferMemory);
 
-		vkUpdateDescriptorSets(m_logicalDevice, 1, &descriptorWrite, 0, nullptr);
+	a_rebuild.meshes.emplace_back(glm::ivec3(0), mesh);
+
+	if (useDirectWrite(m_uploadPolicy)) 
+	{
+		//meshed straight into the final buffers, the rebuild can be swapped in as soon as the job is done
+		scene.WriteMesh(layout, static_cast<Vertex*>(mesh.vertexBufferMemory.mapped), static_cast<uint32_t*>(mesh.indexBufferMemory.mapped));
+
+		a_rebuild.meshedTime = std::chrono::high_resolution_clock::now();
+		a_rebuild.uploadBatch = 0;
+		return;
 	}
-}
 
-void VoxelEngine::createCommandBuffers()
-{
-	m_commandBuffers.resize(MAX_FRAMES_IN_FLIGHT);   
+	//meshed straight into the upload ring, a full ring waits for older batches or falls back to an overflow buffer
+	UploadRegion vertexRegion = m_uploadRing.Reserve(vertexBufferSize);
+	UploadRegion indexRegion = m_uploadRing.Reserve(indexBufferSize);
 
-	VkCommandBufferAllocateInfo allocInfo{}; 
-	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO; 
-	allocInfo.commandPool = m_commandPool; 
-	allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY; 
-	allocInfo.commandBufferCount = (uint32_t)m_commandBuffers.size(); 
+	scene.WriteMesh(layout, static_cast<Vertex*>(vertexRegion.mapped), static_cast<uint32_t*>(indexRegion.mapped));
 
-	if (vkAllocateCommandBuffers(m_logicalDevice, &allocInfo, m_commandBuffers.data()) != VK_SUCCESS) {
-		throw std::runtime_error("failed to allocate command buffers!");
-	}
-	else {
-		std::cout << "" << std::endl;
-		std::cout << "Success: created command buffer" << std::endl;
-	}
+	a_rebuild.meshedTime = std::chrono::high_resolution_clock::now();
+
+	//the copies join the batch the main thread flushes next, the later of the two batches covers both
+	a_rebuild.uploadBatch = m_uploadRing.Copy(vertexRegion, { { mesh.vertexBuffer, 0, 0, vertexBufferSize } });
+	a_rebuild.uploadBatch = std::max(a_rebuild.uploadBatch, m_uploadRing.Copy(indexRegion, { { mesh.indexBuffer, 0, 0, indexBufferSize } }));
 }
 
-void VoxelEngine::createSyncObjects()
+void VoxelEngine::recordChunkMeshes(MeshRebuild& a_rebuild)
 {
-	m_imageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-	m_renderFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-	m_computeFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
+	//every non empty dirty chunk gets new ranges in the arena, its old ones stay drawn until the rebuild is swapped in
+	Scene& scene = m_scenes.at(m_currentScene);
+	const MeshLayout& layout = a_rebuild.layout;
+	bool directWrite = useDirectWrite(m_uploadPolicy);
 
-	m_inFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
-	m_computeInFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
+	std::vector<int> chunkMesh(layout.ranges.size(), -1);
+	std::vector<VkDeviceSize> vertexStagingOffsets(layout.ranges.size(), 0);
+	std::vector<VkDeviceSize> indexStagingOffsets(layout.ranges.size(), 0);
+	VkDeviceSize vertexStagingSize = 0;
+	VkDeviceSize indexStagingSize = 0;
 
-	VkSemaphoreCreateInfo semaphoreInfo{};
+	for (size_t c = 0; c < layout.ranges.size(); c++) {
+		const ChunkDrawRange& range = layout.ranges[c];
+
+		if (range.indexCount == 0) 
+		{
+			continue;
+		}
+
+		ArenaMesh mesh = m_chunkArena.Allocate(layout.vertexCounts[c], range.indexCount);
+
+		chunkMesh[c] = static_cast<int>(a_rebuild.arenaMeshes.size());
+		a_rebuild.arenaMeshes.emplace_back(range.coord, mesh);
+
+		//staged, every chunk gets its own part of the two ring regions, 16 bit index parts are padded to keep the next one aligned
+		vertexStagingOffsets[c] = vertexStagingSize;
+		indexStagingOffsets[c] = indexStagingSize;
+		vertexStagingSize += sizeof(PackedVertex) * mesh.vertexCount;
+		indexStagingSize += (m_chunkArena.GetIndexBytes(mesh) + 3) & ~VkDeviceSize(3);
+	}
+
+	if (a_rebuild.arenaMeshes.empty()) 
+	{
+		a_rebuild.meshedTime = std::chrono::high_resolution_clock::now();
+		return;
+	}
+
+	UploadRegion vertexRegion;
+	UploadRegion indexRegion;
+
+	if (!directWrite) 
+	{
+		vertexRegion = m_uploadRing.Reserve(vertexStagingSize);
+		indexRegion = m_uploadRing.Reserve(indexStagingSize);
+	}
+
+	std::vector<ChunkMeshTarget> targets(layout.ranges.size());
+	std::vector<UploadCopy> vertexCopies;
+	std::vector<UploadCopy> indexCopies;
+
+	for (size_t c = 0; c < layout.ranges.size(); c++) {
+		if (chunkMesh[c] < 0) 
+		{
+			continue;
+		}
+
+		const ArenaMesh& mesh = a_rebuild.arenaMeshes[chunkMesh[c]].second;
+		void* indices = nullptr;
+
+		if (directWrite) 
+		{
+			targets[c].vertices = m_chunkArena.GetMappedVertices(mesh);
+			indices = m_chunkArena.GetMappedIndices(mesh);
+		}
+		else 
+		{
+			targets[c].vertices = reinterpret_cast<PackedVertex*>(static_cast<char*>(vertexRegion.mapped) + vertexStagingOffsets[c]);
+			indices = static_cast<char*>(indexRegion.mapped) + indexStagingOffsets[c];
+
+			//only the ranges of the chunk are written, the rest of the page keeps being drawn
+			vertexCopies.push_back({ m_chunkArena.GetVertexBuffer(mesh), vertexStagingOffsets[c], m_chunkArena.GetVertexOffset(mesh), 
+				sizeof(PackedVertex) * mesh.vertexCount });
+			indexCopies.push_back({ m_chunkArena.GetIndexBuffer(mesh), indexStagingOffsets[c], m_chunkArena.GetIndexOffset(mesh), 
+				m_chunkArena.GetIndexBytes(mesh) });
+		}
+
+		if (m_chunkArena.HasShortIndices(mesh)) 
+		{
+			targets[c].shortIndices = static_cast<uint16_t*>(indices);
+		}
+		else 
+		{
+			targets[c].indices = static_cast<uint32_t*>(indices);
+		}
+	}
+
+	scene.WriteMesh(layout, targets);
+
+	a_rebuild.meshedTime = std::chrono::high_resolution_clock::now();
+
+	if (!directWrite) 
+	{
+		a_rebuild.uploadBatch = m_uploadRing.Copy(vertexRegion, vertexCopies);
+		a_rebuild.uploadBatch = std::max(a_rebuild.uploadBatch, m_uploadRing.Copy(indexRegion, indexCopies));
+	}
+}
+
+void VoxelEngine::updateMeshRebuild(const bool a_block)
+{
+	if (!m_meshRebuild) 
+	{
+		return;
+	}
+
+	MeshRebuild& rebuild = *m_meshRebuild;
+
+	if (!a_block) 
+	{
+		rebuild.framesDrawn++;
+		rebuild.longestFrame = std::max(rebuild.longestFrame, m_deltaTime);
+	}
+	else 
+	{
+		rebuild.group.Wait();
+
+		//the continuation is a job of its own, a worker picks it up right after the group
+		while (!rebuild.readyToSwap)
+		{
+			std::this_thread::yield();
+		}
+	}
+
+	if (!rebuild.readyToSwap) 
+	{
+		return;
+	}
+
+	if (!rebuild.jobDone) 
+	{
+		//the job does not read the scene anymore, edits made in the meantime can go in
+		std::vector<SphereEdit> pendingEdits;
+		pendingEdits.swap(m_pendingEdits);
+
+		for (const SphereEdit& edit : pendingEdits) {
+			applySphereEdit(edit);
+		}
+
+		rebuild.jobDone = true;
+	}
+
+	if (a_block) 
+	{
+		m_uploadRing.WaitForBatch(rebuild.uploadBatch);
+	}
+
+	//the previous meshes keep being drawn until the batch with the copies is done
+	if (!m_uploadRing.IsBatchDone(rebuild.uploadBatch)) 
+	{
+		return;
+	}
+
+	//swap at the frame boundary, frames still in flight keep their old buffers until they retire
+	if (rebuild.chunked) 
+	{
+		float voxelSize = m_scenes.at(m_currentScene).GetWorld().GetVoxelSize();
+
+		//dirty chunks without a mesh stop drawing, the others draw their new ranges, the arena frees the old ones once the frames retired
+		for (const glm::ivec3& chunkCoord : rebuild.chunkCoords) {
+			m_chunkArena.RemoveDraw(chunkCoord, m_frameNumber);
+		}
+
+		for (const auto& entry : rebuild.arenaMeshes) {
+			ChunkDrawData drawData{};
+			drawData.originSize = glm::vec4(glm::vec3(entry.first * CHUNK_SIZE), voxelSize);
+
+			m_chunkArena.SetDraw(entry.first, entry.second, drawData, m_frameNumber);
+		}
+	}
+	else 
+	{
+		retireBuffer(m_vertexBuffer, m_vertexBufferMemory);
+		retireBuffer(m_indexBuffer, m_indexBufferMemory);
+		m_indexCount = 0;
+
+		if (!rebuild.meshes.empty()) 
+		{
+			const ChunkGpuMesh& mesh = rebuild.meshes.front().second;
+
+			m_vertexBuffer = mesh.vertexBuffer;
+			m_vertexBufferMemory = mesh.vertexBufferMemory;
+			m_indexBuffer = mesh.indexBuffer;
+			m_indexBufferMemory = mesh.indexBufferMemory;
+			m_indexCount = mesh.indexCount;
+		}
+	}
+
+	auto swapTime = std::chrono::high_resolution_clock::now();
+
+	std::cout << "" << std::endl;
+	std::cout << "Mesh rebuilt (" << getRenderModeName() << ", " << ChunkMesher::GetModeName(m_meshingMode) << "): " 
+		<< rebuild.chunkCoords.size() << " chunks, " << rebuild.layout.indexCount / 3 << " triangles, meshing took " 
+		<< std::chrono::duration<float, std::chrono::milliseconds::period>(rebuild.meshedTime - rebuild.startTime).count() << " ms, swapped in after " 
+		<< std::chrono::duration<float, std::chrono::milliseconds::period>(swapTime - rebuild.startTime).count() << " ms, " 
+		<< rebuild.framesDrawn << " frames drawn meanwhile, longest frame " << rebuild.longestFrame * 1000.0f << " ms" << std::endl;
+
+	bool chunked = rebuild.chunked;
+	m_meshRebuild.reset();
+	invalidateCommandBuffers();
+
+	//edits and "u" presses that came in during the rebuild
+	if (!a_block && (m_meshRebuildQueued || (chunked && m_scenes.at(m_currentScene).GetWorld().HasDirtyChunks()))) 
+	{
+		startMeshRebuild();
+	}
+}
+
+void VoxelEngine::retireBuffer(VkBuffer& a_buffer, MemoryAllocation& a_bufferMemory)
+{
+	if (a_buffer != VK_NULL_HANDLE || a_bufferMemory.memory != VK_NULL_HANDLE) 
+	{
+		m_retiredBuffers.push_back({ a_buffer, a_bufferMemory, m_frameNumber });
+	}
+
+	a_buffer = VK_NULL_HANDLE;
+	a_bufferMemory = MemoryAllocation();
+}
+
+void VoxelEngine::freeRetiredBuffers(const bool a_all)
+{
+	//the in flight fence waited for at the start of a frame belongs to the frame MAX_FRAMES_IN_FLIGHT before it
+	auto retired = [this, a_all](const RetiredBuffer& a_retired) { return a_all || m_frameNumber >= a_retired.frameNumber + MAX_FRAMES_IN_FLIGHT; };
+
+	for (RetiredBuffer& retiredBuffer : m_retiredBuffers) {
+		if (retired(retiredBuffer)) 
+		{
+			vkDestroyBuffer(m_logicalDevice, retiredBuffer.buffer, nullptr);
+			m_allocator.Free(retiredBuffer.memory);
+		}
+	}
+
+	m_retiredBuffers.erase(std::remove_if(m_retiredBuffers.begin(), m_retiredBuffers.end(), retired), m_retiredBuffers.end());
+}
+
+void VoxelEngine::createInstanceBuffer()
+{
+	if (m_instances.empty()) 
+	{
+		return;
+	}
+
+	VkDeviceSize bufferSize = sizeof(m_instances[0]) * m_instances.size();
+
+	//the same records are read as instance attributes or pulled from pulling.vert as storage buffer
+	createUploadBuffer(bufferSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, m_uploadPolicy, 
+		m_instanceBuffer, m_instanceBufferMemory);
+
+	uploadBuffer(m_instanceBuffer, m_instanceBufferMemory, m_uploadPolicy, m_instances.data(), bufferSize);
+}
+
+void VoxelEngine::createUniformBuffers()
+{
+	VkDeviceSize bufferSize = sizeof(UniformBufferObject);
+
+	m_uniformBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+	m_uniformBuffersMemory.resize(MAX_FRAMES_IN_FLIGHT);
+	m_uniformBuffersMapped.resize(MAX_FRAMES_IN_FLIGHT);
+
+	for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+		createBuffer(bufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, 
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, 
+			m_uniformBuffers[i], m_uniformBuffersMemory[i]);
+
+		//host visible blocks stay mapped by the allocator
+		m_uniformBuffersMapped[i] = m_uniformBuffersMemory[i].mapped;
+	}
+}
+
+void VoxelEngine::createDescriptorPool() 
+{
+	std::array<VkDescriptorPoolSize, 2> poolSizes{};
+	poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	poolSizes[0].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+	poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	poolSizes[1].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+
+	VkDescriptorPoolCreateInfo poolInfo{};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.poolSizeCount = m_renderMode == RenderMode::VERTEX_PULLING || m_renderMode == RenderMode::CHUNKED_MESH ? 2 : 1;
+	poolInfo.pPoolSizes = poolSizes.data();
+	poolInfo.maxSets = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+
+	if (vkCreateDescriptorPool(m_logicalDevice, &poolInfo, nullptr, &m_descriptorPool) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create descriptor pool!");
+	}
+}
+
+void VoxelEngine::createDescriptorSets()
+{
+	std::vector<VkDescriptorSetLayout> layouts(MAX_FRAMES_IN_FLIGHT, m_descriptorSetLayout);
+	VkDescriptorSetAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.descriptorPool = m_descriptorPool;
+	allocInfo.descriptorSetCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+	allocInfo.pSetLayouts = layouts.data();
+
+	m_descriptorSets.resize(MAX_FRAMES_IN_FLIGHT); 
+
+	if (vkAllocateDescriptorSets(m_logicalDevice, &allocInfo, m_descriptorSets.data()) != VK_SUCCESS) {
+		throw std::runtime_error("failed to allocate descriptor sets!");
+	}
+	else {
+		std::cout << "" << std::endl;
+		std::cout << "Success: allocated descriptor sets" << std::endl;
+	}
+
+	for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+		VkDescriptorBufferInfo bufferInfo{};
+		bufferInfo.buffer = m_uniformBuffers[i];
+		bufferInfo.offset = 0;
+		bufferInfo.range = sizeof(UniformBufferObject);
+
+		VkWriteDescriptorSet descriptorWrite{};
+		descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		descriptorWrite.dstSet = m_descriptorSets[i];
+		descriptorWrite.dstBinding = 0;
+		descriptorWrite.dstArrayElement = 0;
+		descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+		descriptorWrite.descriptorCount = 1;
+		descriptorWrite.pBufferInfo = &bufferInfo;
+
+		vkUpdateDescriptorSets(m_logicalDevice, 1, &descriptorWrite, 0, nullptr);
+	}
+
+	writeInstanceDescriptors();
+
+	if (m_renderMode != RenderMode::CHUNKED_MESH) 
+	{
+		return;
+	}
+
+	//the arena keeps one draw data buffer per frame in flight for the whole run
+	for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+		VkDescriptorBufferInfo bufferInfo{};
+		bufferInfo.buffer = m_chunkArena.GetDrawDataBuffer(i);
+		bufferInfo.offset = 0;
+		bufferInfo.range = sizeof(ChunkDrawData) * ARENA_MAX_DRAWS;
+
+		VkWriteDescriptorSet descriptorWrite{};
+		descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		descriptorWrite.dstSet = m_descriptorSets[i];
+		descriptorWrite.dstBinding = 1;
+		descriptorWrite.dstArrayElement = 0;
+		descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		descriptorWrite.descriptorCount = 1;
+		descriptorWrite.pBufferInfo = &bufferInfo;
+
+		vkUpdateDescriptorSets(m_logicalDevice, 1, &descriptorWrite, 0, nullptr);
+	}
+}
+
+void VoxelEngine::writeInstanceDescriptors()
+{
+	//only vertex pulling reads the voxel records through a descriptor, an empty scene has no buffer to point to
+	if (m_renderMode != RenderMode::VERTEX_PULLING || m_instanceBuffer == VK_NULL_HANDLE) 
+	{
+		return;
+	}
+
+	for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+		VkDescriptorBufferInfo bufferInfo{};
+		bufferInfo.buffer = m_instanceBuffer;
+		bufferInfo.offset = 0;
+		bufferInfo.range = sizeof(VoxelInstance) * m_instances.size();
+
+		VkWriteDescriptorSet descriptorWrite{};
+		descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		descriptorWrite.dstSet = m_descriptorSets[i];
+		descriptorWrite.dstBinding = 1;
+		descriptorWrite.dstArrayElement = 0;
+		descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		descriptorWrite.descriptorCount = 1;
+		descriptorWrite.pBufferInfo = &bufferInfo;
+
+		vkUpdateDescriptorSets(m_logicalDevice, 1, &descriptorWrite, 0, nullptr);
+	}
+}
+
+void VoxelEngine::createChunkCullPipeline()
+{
+	//cull records, indirect commands, chunk draw data, draw counts per page and the uniform buffer the frustum planes are taken from
+	std::array<VkDescriptorSetLayoutBinding, 5> layoutBindings{};
+	for (uint32_t i = 0; i < layoutBindings.size(); i++) {
+		layoutBindings[i].binding = i;
+		layoutBindings[i].descriptorCount = 1;
+		layoutBindings[i].descriptorType = i == 4 ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		layoutBindings[i].pImmutableSamplers = nullptr;
+		layoutBindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	}
+
+	VkDescriptorSetLayoutCreateInfo layoutInfo{};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.bindingCount = static_cast<uint32_t>(layoutBindings.size());
+	layoutInfo.pBindings = layoutBindings.data();
+
+	if (vkCreateDescriptorSetLayout(m_logicalDevice, &layoutInfo, nullptr, &m_cullDescriptorSetLayout) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create cull descriptor set layout!");
+	}
+
+	auto cullShaderCode = readFile("shaders/cullcomp.spv");
+
+	VkShaderModule cullShaderModule = createShaderModule(cullShaderCode);
+
+	VkPipelineShaderStageCreateInfo cullShaderStageInfo{};
+	cullShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	cullShaderStageInfo.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	cullShaderStageInfo.module = cullShaderModule;
+	cullShaderStageInfo.pName = "main";
+
+	//record count and compaction
+	VkPushConstantRange pushConstantRange{};
+	pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	pushConstantRange.offset = 0;
+	pushConstantRange.size = sizeof(ChunkCullPushConstants);
+
+	VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutInfo.setLayoutCount = 1;
+	pipelineLayoutInfo.pSetLayouts = &m_cullDescriptorSetLayout;
+	pipelineLayoutInfo.pushConstantRangeCount = 1;
+	pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+	if (vkCreatePipelineLayout(m_logicalDevice, &pipelineLayoutInfo, nullptr, &m_cullPipelineLayout) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create cull pipeline layout!");
+	}
+
+	VkComputePipelineCreateInfo pipelineInfo{};
+	pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipelineInfo.layout = m_cullPipelineLayout;
+	pipelineInfo.stage = cullShaderStageInfo;
+
+	if (m_pipelineCache.CreateComputePipeline(pipelineInfo, m_cullPipeline) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create cull pipeline!");
+	}
+	else {
+		std::cout << "" << std::endl;
+		std::cout << "Success: created chunk cull pipeline" << std::endl;
+	}
+
+	vkDestroyShaderModule(m_logicalDevice, cullShaderModule, nullptr);
+}
+
+void VoxelEngine::createChunkCullDescriptorSets()
+{
+	std::array<VkDescriptorPoolSize, 2> poolSizes{};
+	poolSizes[0].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	poolSizes[0].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT) * 4;
+	poolSizes[1].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	poolSizes[1].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+
+	VkDescriptorPoolCreateInfo poolInfo{};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+	poolInfo.pPoolSizes = poolSizes.data();
+	poolInfo.maxSets = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+
+	if (vkCreateDescriptorPool(m_logicalDevice, &poolInfo, nullptr, &m_cullDescriptorPool) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create cull descriptor pool!");
+	}
+
+	std::vector<VkDescriptorSetLayout> layouts(MAX_FRAMES_IN_FLIGHT, m_cullDescriptorSetLayout);
+	VkDescriptorSetAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.descriptorPool = m_cullDescriptorPool;
+	allocInfo.descriptorSetCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+	allocInfo.pSetLayouts = layouts.data();
+
+	m_cullDescriptorSets.resize(MAX_FRAMES_IN_FLIGHT);
+	if (vkAllocateDescriptorSets(m_logicalDevice, &allocInfo, m_cullDescriptorSets.data()) != VK_SUCCESS) {
+		throw std::runtime_error("failed to allocate cull descriptor sets!");
+	}
+
+	//the arena keeps the buffers of every frame in flight for the whole run
+	for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+		std::array<VkDescriptorBufferInfo, 5> bufferInfos{};
+		bufferInfos[0] = { m_chunkArena.GetCullRecordBuffer(i), 0, sizeof(ChunkCullRecord) * ARENA_MAX_DRAWS };
+		bufferInfos[1] = { m_chunkArena.GetIndirectBuffer(i), 0, sizeof(VkDrawIndexedIndirectCommand) * ARENA_MAX_DRAWS };
+		bufferInfos[2] = { m_chunkArena.GetDrawDataBuffer(i), 0, sizeof(ChunkDrawData) * ARENA_MAX_DRAWS };
+		bufferInfos[3] = { m_chunkArena.GetCountBuffer(i), 0, sizeof(uint32_t) * ARENA_MAX_PAGES };
+		bufferInfos[4] = { m_uniformBuffers[i], 0, sizeof(UniformBufferObject) };
+
+		std::array<VkWriteDescriptorSet, 5> descriptorWrites{};
+		for (uint32_t b = 0; b < descriptorWrites.size(); b++) {
+			descriptorWrites[b].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			descriptorWrites[b].dstSet = m_cullDescriptorSets[i];
+			descriptorWrites[b].dstBinding = b;
+			descriptorWrites[b].dstArrayElement = 0;
+			descriptorWrites[b].descriptorType = b == 4 ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			descriptorWrites[b].descriptorCount = 1;
+			descriptorWrites[b].pBufferInfo = &bufferInfos[b];
+		}
+
+		vkUpdateDescriptorSets(m_logicalDevice, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+	}
+}
+
+void VoxelEngine::recordChunkCulling(VkCommandBuffer a_commandBuffer)
+{
+	if (m_cullPushConstants.recordCount == 0) 
+	{
+		return;
+	}
+
+	//the draw counts start at zero, cull.comp counts the visible chunks of every page up
+	if (m_cullPushConstants.compact) 
+	{
+		vkCmdFillBuffer(a_commandBuffer, m_chunkArena.GetCountBuffer(m_currentFrame), 0, sizeof(uint32_t) * ARENA_MAX_PAGES, 0);
+
+		VkMemoryBarrier clearBarrier{};
+		clearBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		clearBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		clearBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+		vkCmdPipelineBarrier(a_commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &clearBarrier, 0, nullptr, 0, nullptr);
+	}
+
+	vkCmdBindPipeline(a_commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_cullPipeline);
+	vkCmdBindDescriptorSets(a_commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_cullPipelineLayout, 0, 1, &m_cullDescriptorSets[m_currentFrame], 0, nullptr);
+	vkCmdPushConstants(a_commandBuffer, m_cullPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(ChunkCullPushConstants), &m_cullPushConstants);
+	vkCmdDispatch(a_commandBuffer, (m_cullPushConstants.recordCount + CHUNK_CULL_GROUP_SIZE - 1) / CHUNK_CULL_GROUP_SIZE, 1, 1);
+
+	//commands and counts are read by the indirect draws, the draw data by packed.vert
+	VkMemoryBarrier cullBarrier{};
+	cullBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	cullBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	cullBarrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+
+	vkCmdPipelineBarrier(a_commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, 
+		0, 1, &cullBarrier, 0, nullptr, 0, nullptr);
+}
+
+void VoxelEngine::createCommandBuffers()
+{
+	m_commandBuffers.resize(MAX_FRAMES_IN_FLIGHT);   
+
+	VkCommandBufferAllocateInfo allocInfo{}; 
+	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO; 
+	allocInfo.commandPool = m_commandPool; 
+	allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY; 
+	allocInfo.commandBufferCount = (uint32_t)m_commandBuffers.size(); 
+
+	if (vkAllocateCommandBuffers(m_logicalDevice, &allocInfo, m_commandBuffers.data()) != VK_SUCCESS) {
+		throw std::runtime_error("failed to allocate command buffers!");
+	}
+	else {
+		std::cout << "" << std::endl;
+		std::cout << "Success: created command buffer" << std::endl;
+	}
+}
+
+void VoxelEngine::createSecondaryCommandBuffers()
+{
+	QueueFamilyIndices queueFamilyIndices = findQueueFamilies(m_physicalDevice, false);
+
+	//one slot per thread that can record at once, the render thread helps while it waits for the others
+	size_t slotCount = std::min<size_t>(JobSystem::GetInstance().GetWorkerCount() + 1, MAX_RECORDING_TASKS);
+	m_recordingSlots.resize(slotCount);
+
+	for (RecordingSlot& slot : m_recordingSlots) {
+		VkCommandPoolCreateInfo poolInfo{};
+		poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+		poolInfo.queueFamilyIndex = queueFamilyIndices.graphicsAndComputeFamily.value();
+
+		if (vkCreateCommandPool(m_logicalDevice, &poolInfo, nullptr, &slot.commandPool) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create recording command pool!");
+		}
+
+		slot.commandBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+
+		VkCommandBufferAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocInfo.commandPool = slot.commandPool;
+		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+		allocInfo.commandBufferCount = (uint32_t)slot.commandBuffers.size();
+
+		if (vkAllocateCommandBuffers(m_logicalDevice, &allocInfo, slot.commandBuffers.data()) != VK_SUCCESS) {
+			throw std::runtime_error("failed to allocate secondary command buffers!");
+		}
+	}
+
+	std::cout << "" << std::endl;
+	std::cout << "Success: created " << slotCount << " secondary command buffer slots for parallel chunk draw recording" << std::endl;
+}
+
+bool VoxelEngine::useParallelRecording()
+{
+	return !m_recordingSlots.empty() && m_chunkArena.GetCommandCount(m_currentFrame) >= 2 * MIN_DRAWS_PER_RECORDING_TASK;
+}
+
+void VoxelEngine::recordChunkDrawsParallel(VkCommandBuffer a_commandBuffer, uint32_t a_imageIndex, const std::vector<VkDescriptorSet>& a_descriptorSets)
+{
+	uint32_t commandCount = m_chunkArena.GetCommandCount(m_currentFrame);
+	uint32_t taskCount = std::min(static_cast<uint32_t>(m_recordingSlots.size()), commandCount / MIN_DRAWS_PER_RECORDING_TASK);
+	uint32_t commandsPerTask = (commandCount + taskCount - 1) / taskCount;
+
+	std::vector<VkCommandBuffer> secondaryBuffers(taskCount);
+
+	TaskGroup group;
+	JobSystem::GetInstance().ParallelFor(group, taskCount, 1, [&](int a_begin, int a_end)
+	{
+		for (int t = a_begin; t < a_end; t++) {
+			//the slot is only recorded by this task, the in flight fence of the frame was waited for
+			VkCommandBuffer secondary = m_recordingSlots[t].commandBuffers[m_currentFrame];
+			vkResetCommandBuffer(secondary, 0);
+
+			VkCommandBufferInheritanceInfo inheritanceInfo{};
+			inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+			inheritanceInfo.renderPass = m_renderPass;
+			inheritanceInfo.subpass = 0;
+			inheritanceInfo.framebuffer = m_swapChainFramebuffers[a_imageIndex];
+
+			VkCommandBufferBeginInfo beginInfo{};
+			beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+			beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+			beginInfo.pInheritanceInfo = &inheritanceInfo;
+
+			if (vkBeginCommandBuffer(secondary, &beginInfo) != VK_SUCCESS) {
+				throw std::runtime_error("failed to begin recording secondary command buffer!");
+			}
+
+			//secondary command buffers inherit no state from the primary one
+			VkViewport viewport{};
+			viewport.x = 0.0f;
+			viewport.y = 0.0f;
+			viewport.width = static_cast<float>(m_swapChainExtent.width);
+			viewport.height = static_cast<float>(m_swapChainExtent.height);
+			viewport.minDepth = 0.0f;
+			viewport.maxDepth = 1.0f;
+
+			VkRect2D scissor{};
+			scissor.offset = { 0, 0 };
+			scissor.extent = m_swapChainExtent;
+
+			vkCmdBindPipeline(secondary, VK_PIPELINE_BIND_POINT_GRAPHICS, m_graphicsPipeline);
+			vkCmdSetViewport(secondary, 0, 1, &viewport);
+			vkCmdSetScissor(secondary, 0, 1, &scissor);
+			vkCmdBindDescriptorSets(secondary, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineLayout, 0, 1, &a_descriptorSets[m_currentFrame], 0, nullptr);
+
+			uint32_t firstCommand = t * commandsPerTask;
+			uint32_t endCommand = std::min(firstCommand + commandsPerTask, commandCount);
+			m_chunkArena.RecordDrawRange(secondary, m_currentFrame, m_multiDrawIndirect, firstCommand, endCommand);
+
+			if (vkEndCommandBuffer(secondary) != VK_SUCCESS) {
+				throw std::runtime_error("failed to record secondary command buffer!");
+			}
+
+			secondaryBuffers[t] = secondary;
+		}
+	});
+	group.Wait();
+
+	vkCmdExecuteCommands(a_commandBuffer, taskCount, secondaryBuffers.data());
+}
+
+void VoxelEngine::createReusedCommandBuffers()
+{
+	if (!m_reusedCommandBuffers.empty()) 
+	{
+		vkFreeCommandBuffers(m_logicalDevice, m_commandPool, static_cast<uint32_t>(m_reusedCommandBuffers.size()), m_reusedCommandBuffers.data());
+	}
+
+	//the framebuffer is baked into the render pass, so every frame slot needs one buffer per swapchain image
+	m_reusedCommandBuffers.resize(MAX_FRAMES_IN_FLIGHT * m_swapChainImages.size());
+	m_reusedCommandVersions.assign(m_reusedCommandBuffers.size(), 0);
+
+	VkCommandBufferAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	allocInfo.commandPool = m_commandPool;
+	allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	allocInfo.commandBufferCount = (uint32_t)m_reusedCommandBuffers.size();
+
+	if (vkAllocateCommandBuffers(m_logicalDevice, &allocInfo, m_reusedCommandBuffers.data()) != VK_SUCCESS) {
+		throw std::runtime_error("failed to allocate reused command buffers!");
+	}
+	else {
+		std::cout << "" << std::endl;
+		std::cout << "Success: created " << m_reusedCommandBuffers.size() << " reused command buffers" << std::endl;
+	}
+}
+
+void VoxelEngine::invalidateCommandBuffers()
+{
+	m_commandVersion++;
+}
+
+void VoxelEngine::createSyncObjects()
+{
+	m_imageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
+	m_renderFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
+	m_computeFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
+
+	m_inFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
+	m_computeInFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
+
+	VkSemaphoreCreateInfo semaphoreInfo{};
 	semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
 
 	VkFenceCreateInfo fenceInfo{};
@@ -1347,7 +2317,7 @@ void VoxelEngine::createSyncObjects()
 
 }
 
-void VoxelEngine::recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex, std::vector<VkDescriptorSet> a_descriptorSets)
+void VoxelEngine::recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex, const std::vector<VkDescriptorSet>& a_descriptorSets)
 {
 	VkCommandBufferBeginInfo beginInfo{}; 
 	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO; 
@@ -1372,6 +2342,25 @@ void VoxelEngine::recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t im
 	renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size()); 
 	renderPassInfo.pClearValues = clearValues.data();  
 
+	//compute work has to happen outside of the render pass
+	if (m_gpuCulling) 
+	{
+		recordChunkCulling(commandBuffer);
+	}
+
+	//many chunk draws are recorded into secondary command buffers on the JobSystem, the render pass then holds nothing else
+	if (!m_useCompute && m_renderMode == RenderMode::CHUNKED_MESH && useParallelRecording()) 
+	{
+		vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+		recordChunkDrawsParallel(commandBuffer, imageIndex, a_descriptorSets);
+		vkCmdEndRenderPass(commandBuffer);
+
+		if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+			throw std::runtime_error("failed to record command buffer!");
+		}
+		return;
+	}
+
 	vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE); 
 		
 	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_graphicsPipeline); 
@@ -1391,18 +2380,54 @@ void VoxelEngine::recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t im
 	vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
 
 
-	VkBuffer vertexBuffers[] = { m_vertexBuffer };
-	VkDeviceSize offsets[] = { 0 }; 
-	vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets); 
+	bool instanced = !m_useCompute && m_renderMode == RenderMode::INSTANCED;
+	bool pulling = !m_useCompute && m_renderMode == RenderMode::VERTEX_PULLING;
+	bool chunked = !m_useCompute && m_renderMode == RenderMode::CHUNKED_MESH;
 
-	vkCmdBindIndexBuffer(commandBuffer, m_indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+	VkBuffer vertexBuffers[] = { m_vertexBuffer, m_instanceBuffer };
+	VkDeviceSize offsets[] = { 0, 0 }; 
+	uint32_t instanceCount = instanced ? static_cast<uint32_t>(m_instances.size()) : 1;
 
+	if (chunked) 
+	{
+		if (m_chunkArena.GetDrawCount() > 0) 
+		{
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineLayout, 0, 1, &a_descriptorSets[m_currentFrame], 0, nullptr);
 
-	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineLayout, 0, 1, &a_descriptorSets[m_currentFrame], 0, nullptr);
+			//one indirect draw per arena page over all of its chunks
+			if (m_gpuCulling) 
+			{
+				m_chunkArena.RecordDrawsGpuCulled(commandBuffer, m_currentFrame, m_vkCmdDrawIndexedIndirectCount);
+			}
+			else 
+			{
+				m_chunkArena.RecordDraws(commandBuffer, m_currentFrame, m_multiDrawIndirect);
+			}
+		}
+	}
+	else if (pulling) 
+	{
+		if (!m_instances.empty()) 
+		{
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineLayout, 0, 1, &a_descriptorSets[m_currentFrame], 0, nullptr);
 
-	//vkCmdDraw(commandBuffer, static_cast<uint32_t>(m_vertices2D.size()), 1, 0, 0);
-		
-	vkCmdDrawIndexed(commandBuffer, static_cast<uint32_t>(m_indices.size()), 1, 0, 0, 0); //DRAW COMMAND
+			//36 vertices per voxel, pulling.vert derives voxel and cube corner from gl_VertexIndex
+			vkCmdDraw(commandBuffer, static_cast<uint32_t>(m_instances.size() * INDICES_COUNT_PER_VOXEL), 1, 0, 0);
+		}
+	}
+	else if (instanceCount > 0 && m_indexCount > 0) 
+	{
+		vkCmdBindVertexBuffers(commandBuffer, 0, instanced ? 2 : 1, vertexBuffers, offsets);
+
+		vkCmdBindIndexBuffer(commandBuffer, m_indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+
+
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineLayout, 0, 1, &a_descriptorSets[m_currentFrame], 0, nullptr);
+
+		//vkCmdDraw(commandBuffer, static_cast<uint32_t>(m_vertices2D.size()), 1, 0, 0);
+
+		vkCmdDrawIndexed(commandBuffer, m_indexCount, instanceCount, 0, 0, 0); //DRAW COMMAND
+	}
 
 
 	vkCmdEndRenderPass(commandBuffer); 
@@ -1416,6 +2441,12 @@ void VoxelEngine::drawFrame()
 {
 	vkWaitForFences(m_logicalDevice, 1, &m_inFlightFences[m_currentFrame], VK_TRUE, UINT64_MAX);
 
+	//frame boundary, buffers no frame in flight uses anymore are freed and a finished mesh rebuild is swapped in
+	m_frameNumber++;
+	freeRetiredBuffers(false);
+	m_chunkArena.FreeRetired(m_frameNumber, false);
+	updateMeshRebuild(false);
+
 	uint32_t imageIndex; 
 	VkResult result = vkAcquireNextImageKHR(m_logicalDevice, m_swapChain, UINT64_MAX, m_imageAvailableSemaphores[m_currentFrame], VK_NULL_HANDLE, &imageIndex);
 
@@ -1429,10 +2460,49 @@ void VoxelEngine::drawFrame()
 
 	updateUniformBuffer(m_currentFrame);
 
+	//only chunks inside the view frustum get an indirect command, the commands of this frame slot are not read anymore
+	if (m_gpuCulling) 
+	{
+		m_chunkArena.UpdateFrameGpu(m_currentFrame, m_vkCmdDrawIndexedIndirectCount != nullptr, m_cullPushConstants);
+	}
+	else if (m_renderMode == RenderMode::CHUNKED_MESH) 
+	{
+		m_chunkArena.UpdateFrame(m_currentFrame, m_viewProjection);
+	}
+
+	//all uploads queued since the last frame go out as one batch, on the transfer queue they overlap this frame
+	m_uploadRing.Flush();
+
 	vkResetFences(m_logicalDevice, 1, &m_inFlightFences[m_currentFrame]);
 
-	vkResetCommandBuffer(m_commandBuffers[m_currentFrame], 0);
-	recordCommandBuffer(m_commandBuffers[m_currentFrame], imageIndex, m_descriptorSets);
+	VkCommandBuffer commandBuffer = m_commandBuffers[m_currentFrame];
+
+	if (m_reuseCommandBuffers) 
+	{
+		//chunks that were added or removed change the recorded draws
+		uint64_t drawsVersion = m_chunkArena.GetDrawsVersion();
+		if (m_renderMode == RenderMode::CHUNKED_MESH && drawsVersion != m_recordedDrawsVersion)
+		{
+			m_recordedDrawsVersion = drawsVersion;
+			invalidateCommandBuffers();
+		}
+
+		//the fence of this frame slot was waited for, none of its buffers is pending anymore
+		size_t reusedIndex = m_currentFrame * m_swapChainImages.size() + imageIndex;
+		commandBuffer = m_reusedCommandBuffers[reusedIndex];
+
+		if (m_reusedCommandVersions[reusedIndex] != m_commandVersion)
+		{
+			vkResetCommandBuffer(commandBuffer, 0);
+			recordCommandBuffer(commandBuffer, imageIndex, m_descriptorSets);
+			m_reusedCommandVersions[reusedIndex] = m_commandVersion;
+		}
+	}
+	else 
+	{
+		vkResetCommandBuffer(commandBuffer, 0);
+		recordCommandBuffer(commandBuffer, imageIndex, m_descriptorSets);
+	}
 
 	VkSubmitInfo submitInfo{}; 
 	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO; 
@@ -1443,7 +2513,7 @@ void VoxelEngine::drawFrame()
 	submitInfo.pWaitSemaphores = waitSemaphores;												//tell submitInfo what to wait for
 	submitInfo.pWaitDstStageMask = waitStages; 
 	submitInfo.commandBufferCount = 1; 
-	submitInfo.pCommandBuffers = &m_commandBuffers[m_currentFrame];
+	submitInfo.pCommandBuffers = &commandBuffer;
 
 	VkSemaphore signalSemaphores[] = { m_renderFinishedSemaphores[m_currentFrame] };								//which semaphore to signal when finished rendering
 
@@ -1477,6 +2547,19 @@ void VoxelEngine::drawFrame()
 		throw std::runtime_error("failed to present swap chain image!");
 	}
 
+	if (!m_firstFrameDrawn) 
+	{
+		//wait once so the time includes the gpu work of the first frame
+		vkDeviceWaitIdle(m_logicalDevice);
+		m_firstFrameDrawn = true;
+
+		auto currentTime = std::chrono::high_resolution_clock::now();
+
+		std::cout << "" << std::endl;
+		std::cout << "First frame (" << getRenderModeName() << ") after " 
+			<< std::chrono::duration<float, std::chrono::milliseconds::period>(currentTime - startTime).count() << " ms" << std::endl;
+	}
+
 	m_currentFrame = (m_currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
 }
 
@@ -1494,6 +2577,9 @@ void VoxelEngine::updateUniformBuffer(uint32_t currentImage)
 	ubo.camUp = m_pCamera->GetUp3();
 	ubo.camRight = m_pCamera->GetRight3();
 
+	//the frustum culling of the chunked mode uses the same matrices as packed.vert
+	m_viewProjection = ubo.proj * ubo.view * ubo.model;
+
 	memcpy(m_uniformBuffersMapped[currentImage], &ubo, sizeof(ubo)); 
 }
 
@@ -1521,14 +2607,19 @@ void VoxelEngine::recreateSwapchain()
 	{
 		createFramebuffersCompute();
 	}
-	
+
+	//the old buffers point to the destroyed framebuffers
+	if (m_reuseCommandBuffers) 
+	{
+		createReusedCommandBuffers();
+	}
 }
 
 void VoxelEngine::cleanupSwapchain()
 {
 	vkDestroyImageView(m_logicalDevice, m_depthImageView, nullptr); 
 	vkDestroyImage(m_logicalDevice, m_depthImage, nullptr); 
-	vkFreeMemory(m_logicalDevice, m_depthImageMemory, nullptr); 
+	m_allocator.Free(m_depthImageMemory); 
 
 	for (auto framebuffer : m_swapChainFramebuffers) {
 		vkDestroyFramebuffer(m_logicalDevice, framebuffer, nullptr);
@@ -1585,7 +2676,7 @@ bool VoxelEngine::hasStencilComponent(VkFormat format)
 	return format == VK_FORMAT_D32_SFLOAT_S8_UINT || format == VK_FORMAT_D24_UNORM_S8_UINT;
 }
 
-void VoxelEngine::createImage(uint32_t a_width, uint32_t a_height, VkFormat a_format, VkImageTiling a_tiling, VkImageUsageFlags a_usage, VkMemoryPropertyFlags a_properties, VkImage& a_image, VkDeviceMemory& a_imageMemory, VkImageLayout a_initialLayout)
+void VoxelEngine::createImage(uint32_t a_width, uint32_t a_height, VkFormat a_format, VkImageTiling a_tiling, VkImageUsageFlags a_usage, VkMemoryPropertyFlags a_properties, VkImage& a_image, MemoryAllocation& a_imageMemory, VkImageLayout a_initialLayout)
 {
 	VkImageCreateInfo imageInfo{};
 	imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
@@ -1612,16 +2703,9 @@ void VoxelEngine::createImage(uint32_t a_width, uint32_t a_height, VkFormat a_fo
 	VkMemoryRequirements memRequirements;
 	vkGetImageMemoryRequirements(m_logicalDevice, a_image, &memRequirements);
 
-	VkMemoryAllocateInfo allocInfo{};
-	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-	allocInfo.allocationSize = memRequirements.size;
-	allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, a_properties);
-
-	if (vkAllocateMemory(m_logicalDevice, &allocInfo, nullptr, &a_imageMemory) != VK_SUCCESS) {
-		throw std::runtime_error("failed to allocate image memory!");
-	}
+	a_imageMemory = m_allocator.Allocate(memRequirements, a_properties, AllocationKind::IMAGE);
 
-	vkBindImageMemory(m_logicalDevice, a_image, a_imageMemory, 0);
+	vkBindImageMemory(m_logicalDevice, a_image, a_imageMemory.memory, a_imageMemory.offset);
 }
 
 VkImageView VoxelEngine::createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags)
@@ -1757,19 +2841,447 @@ void VoxelEngine::endSingleTimeCommands(VkCommandBuffer commandBuffer)
 
 void VoxelEngine::updateBuffers()
 {
+	if (m_renderMode == RenderMode::EXPANDED_MESH || m_renderMode == RenderMode::CHUNKED_MESH) 
+	{
+		//meshing and staging run on the JobSystem, the current mesh keeps being drawn until the new one is uploaded
+		startMeshRebuild();
+		return;
+	}
+
 	vkDeviceWaitIdle(m_logicalDevice);
 
-	vkDestroyBuffer(m_logicalDevice, m_indexBuffer, nullptr);
-	vkFreeMemory(m_logicalDevice, m_indexBufferMemory, nullptr);
+	//the instance records are rebuilt as a whole, the dirty chunks are covered by that
+	m_scenes.at(m_currentScene).GetWorld().TakeDirtyChunks();
 
-	vkDestroyBuffer(m_logicalDevice, m_vertexBuffer, nullptr);
-	vkFreeMemory(m_logicalDevice, m_vertexBufferMemory, nullptr);
+	auto updateStart = std::chrono::high_resolution_clock::now();
 
-	//m_scenes.at(m_currentScene).OverwriteVertsAndIndices(m_vertices, m_indices);
-	m_scenes.at(m_currentScene).OverwriteVertsAndIndicesMT(m_vertices, m_indices); 
+	vkDestroyBuffer(m_logicalDevice, m_instanceBuffer, nullptr);
+	m_allocator.Free(m_instanceBufferMemory);
+	m_instanceBuffer = VK_NULL_HANDLE;
 
-	createVertexBuffer(); 
-	createIndexBuffer();
+	m_scenes.at(m_currentScene).OverwriteInstances(m_instances);
+	auto instanceEnd = std::chrono::high_resolution_clock::now();
+
+	createInstanceBuffer();
+	writeInstanceDescriptors();
+	invalidateCommandBuffers();
+
+	//the next frame already draws the new records
+	m_uploadRing.WaitIdle();
+
+	auto updateEnd = std::chrono::high_resolution_clock::now();
+
+	std::cout << "" << std::endl;
+	std::cout << "Voxel records updated (" << getRenderModeName() << "): " << m_instances.size() << " voxels, " 
+		<< m_instances.size() * sizeof(VoxelInstance) / (1024 * 1024) << " MB, gathering took " 
+		<< std::chrono::duration<float, std::chrono::milliseconds::period>(instanceEnd - updateStart).count() << " ms, update took " 
+		<< std::chrono::duration<float, std::chrono::milliseconds::period>(updateEnd - updateStart).count() << " ms" << std::endl;
+}
+
+void VoxelEngine::editSceneAtCamera(const uint32_t a_material)
+{
+	SphereEdit edit{};
+	edit.center = m_pCamera->GetPosition3() + glm::normalize(m_pCamera->GetForward3()) * EDIT_SPHERE_DISTANCE;
+	edit.material = a_material;
+
+	//a rebuild job is still reading the scene
+	if (m_meshRebuild && !m_meshRebuild->group.IsDone()) 
+	{
+		m_pendingEdits.emplace_back(edit);
+
+		std::cout << "" << std::endl;
+		std::cout << "Edit queued until the running mesh rebuild finished meshing" << std::endl;
+		return;
+	}
+
+	applySphereEdit(edit);
+}
+
+void VoxelEngine::applySphereEdit(const SphereEdit& a_edit)
+{
+	Scene& scene = m_scenes.at(m_currentScene);
+	scene.EditSphere(a_edit.center, EDIT_SPHERE_RADIUS, a_edit.material);
+
+	std::cout << "" << std::endl;
+	std::cout << (a_edit.material == EMPTY_MATERIAL ? "Sphere carved" : "Sphere placed") << " at (" << a_edit.center.x << ", " << a_edit.center.y << ", " 
+		<< a_edit.center.z << "), " << scene.GetVoxelCount() << " voxels" << std::endl;
+
+	if (m_useCompute)
+	{
+		updateBrickMap();
+		return;
+	}
+
+	//the other modes pick the edit up with the next "u" update
+	if (m_renderMode == RenderMode::CHUNKED_MESH) 
+	{
+		startMeshRebuild();
+	}
+}
+
+void VoxelEngine::createBrickMapBuffers()
+{
+	//the pool is written in place while it is bound, with a transfer queue of its own the copies need a concurrent buffer
+	bool directWrite = useDirectWrite(m_uploadPolicy);
+	std::vector<uint32_t> queueFamilies = m_uploadRing.GetQueueFamilies();
+	bool concurrent = !directWrite && queueFamilies.size() > 1;
+
+	VkDeviceSize poolSize = sizeof(uint32_t) * m_brickMap.GetPool().size();
+
+	VkBufferCreateInfo bufferInfo{};
+	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferInfo.size = poolSize;
+	bufferInfo.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | (directWrite ? 0 : VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+	bufferInfo.sharingMode = concurrent ? VK_SHARING_MODE_CONCURRENT : VK_SHARING_MODE_EXCLUSIVE;
+	bufferInfo.queueFamilyIndexCount = concurrent ? static_cast<uint32_t>(queueFamilies.size()) : 0;
+	bufferInfo.pQueueFamilyIndices = concurrent ? queueFamilies.data() : nullptr;
+
+	if (vkCreateBuffer(m_logicalDevice, &bufferInfo, nullptr, &m_brickPoolBuffer) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create brick map buffer!");
+	}
+
+	VkMemoryRequirements memRequirements;
+	vkGetBufferMemoryRequirements(m_logicalDevice, m_brickPoolBuffer, &memRequirements);
+
+	m_brickPoolBufferMemory = m_allocator.Allocate(memRequirements, directWrite ? DIRECT_WRITE_MEMORY_PROPERTIES : VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 
+		AllocationKind::BUFFER);
+
+	vkBindBufferMemory(m_logicalDevice, m_brickPoolBuffer, m_brickPoolBufferMemory.memory, m_brickPoolBufferMemory.offset);
+
+	if (concurrent)
+	{
+		m_uploadRing.AddConcurrentBuffer(m_brickPoolBuffer);
+	}
+
+	m_brickUploadBatch = uploadBuffer(m_brickPoolBuffer, m_brickPoolBufferMemory, m_uploadPolicy, m_brickMap.GetPool().data(), poolSize);
+
+	//one grid per frame in flight like the uniform buffers, each frame switches to the new grid once its last submit is done
+	VkDeviceSize gridSize = sizeof(uint32_t) * m_brickMap.GetGrid().size();
+
+	m_brickGridBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+	m_brickGridBuffersMemory.resize(MAX_FRAMES_IN_FLIGHT);
+	m_brickGridVersions.resize(MAX_FRAMES_IN_FLIGHT);
+
+	for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+		createBuffer(gridSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, 
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, 
+			m_brickGridBuffers[i], m_brickGridBuffersMemory[i]);
+
+		memcpy(m_brickGridBuffersMemory[i].mapped, m_brickMap.GetGrid().data(), gridSize);
+		m_brickGridVersions[i] = m_brickMap.GetVersion();
+	}
+}
+
+void VoxelEngine::destroyBrickMapBuffers()
+{
+	if (m_brickPoolBuffer == VK_NULL_HANDLE)
+	{
+		return;
+	}
+
+	if (!useDirectWrite(m_uploadPolicy) && m_uploadRing.GetQueueFamilies().size() > 1)
+	{
+		m_uploadRing.RemoveConcurrentBuffer(m_brickPoolBuffer);
+	}
+
+	vkDestroyBuffer(m_logicalDevice, m_brickPoolBuffer, nullptr);
+	m_allocator.Free(m_brickPoolBufferMemory);
+	m_brickPoolBuffer = VK_NULL_HANDLE;
+
+	for (size_t i = 0; i < m_brickGridBuffers.size(); i++) {
+		vkDestroyBuffer(m_logicalDevice, m_brickGridBuffers[i], nullptr);
+		m_allocator.Free(m_brickGridBuffersMemory[i]);
+	}
+
+	m_brickGridBuffers.clear();
+	m_brickGridBuffersMemory.clear();
+	m_brickGridVersions.clear();
+}
+
+void VoxelEngine::writeBrickMapDescriptors()
+{
+	for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+		std::array<VkWriteDescriptorSet, 2> descriptorWrites{};
+
+		VkDescriptorBufferInfo brickGridBufferInfo{};
+		brickGridBufferInfo.buffer = m_brickGridBuffers[i];
+		brickGridBufferInfo.offset = 0;
+		brickGridBufferInfo.range = sizeof(uint32_t) * m_brickMap.GetGrid().size();
+
+		descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		descriptorWrites[0].dstSet = m_descriptorSetsCompute[i];
+		descriptorWrites[0].dstBinding = 8;
+		descriptorWrites[0].dstArrayElement = 0;
+		descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		descriptorWrites[0].descriptorCount = 1;
+		descriptorWrites[0].pBufferInfo = &brickGridBufferInfo;
+
+		VkDescriptorBufferInfo brickPoolBufferInfo{};
+		brickPoolBufferInfo.buffer = m_brickPoolBuffer;
+		brickPoolBufferInfo.offset = 0;
+		brickPoolBufferInfo.range = sizeof(uint32_t) * m_brickMap.GetPool().size();
+
+		descriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		descriptorWrites[1].dstSet = m_descriptorSetsCompute[i];
+		descriptorWrites[1].dstBinding = 9;
+		descriptorWrites[1].dstArrayElement = 0;
+		descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		descriptorWrites[1].descriptorCount = 1;
+		descriptorWrites[1].pBufferInfo = &brickPoolBufferInfo;
+
+		vkUpdateDescriptorSets(m_logicalDevice, descriptorWrites.size(), descriptorWrites.data(), 0, nullptr);
+	}
+}
+
+void VoxelEngine::updateBrickMap()
+{
+	Scene& scene = m_scenes.at(m_currentScene);
+	std::vector<glm::ivec3> dirtyChunks = scene.GetWorld().TakeDirtyChunks();
+
+	if (!m_brickMap.Update(scene.GetWorld(), dirtyChunks))
+	{
+		//the edit left the grid or the pool is full, a new build sizes both again. Rare enough to wait for the gpu
+		vkDeviceWaitIdle(m_logicalDevice);
+
+		destroyBrickMapBuffers();
+		m_brickMap.Build(scene.GetWorld());
+		createBrickMapBuffers();
+		writeBrickMapDescriptors();
+		m_uploadRing.WaitIdle();
+
+		std::cout << "" << std::endl;
+		std::cout << "Brick map outgrown, rebuilt:" << std::endl;
+		m_brickMap.PrintStats();
+		return;
+	}
+
+	//only the changed bricks, the grids of the frames in flight do not point at their slots yet
+	bool directWrite = useDirectWrite(m_uploadPolicy);
+	VkDeviceSize brickBytes = sizeof(uint32_t) * BRICK_WORDS;
+
+	for (uint32_t slot : m_brickMap.GetDirtyBricks()) {
+		VkDeviceSize offset = brickBytes * slot;
+		const uint32_t* brick = m_brickMap.GetPool().data() + static_cast<size_t>(slot) * BRICK_WORDS;
+
+		if (directWrite)
+		{
+			memcpy(static_cast<char*>(m_brickPoolBufferMemory.mapped) + offset, brick, brickBytes);
+		}
+		else
+		{
+			//the batch of the last brick is the newest one, the per frame Flush submits it
+			m_brickUploadBatch = m_uploadRing.Upload(m_brickPoolBuffer, offset, brick, brickBytes);
+		}
+	}
+
+	size_t uploadedBytes = brickBytes * m_brickMap.GetDirtyBricks().size();
+	m_brickMap.ClearDirtyBricks();
+
+	m_brickMap.PrintStats();
+	std::cout << "Brick map streamed " << uploadedBytes / 1024 << " KB of bricks" << std::endl;
+}
+
+void VoxelEngine::updateBrickGrid(const uint32_t a_currentFrame)
+{
+	//the fence of the frame was waited for, nothing reads its grid
+	if (m_brickGridVersions.empty() || m_brickGridVersions[a_currentFrame] == m_brickMap.GetVersion())
+	{
+		return;
+	}
+
+	//the new grid points at the streamed bricks, it waits until their copies are done
+	if (m_brickUploadBatch != 0 && !m_uploadRing.IsBatchDone(m_brickUploadBatch))
+	{
+		return;
+	}
+
+	memcpy(m_brickGridBuffersMemory[a_currentFrame].mapped, m_brickMap.GetGrid().data(), sizeof(uint32_t) * m_brickMap.GetGrid().size());
+	m_brickGridVersions[a_currentFrame] = m_brickMap.GetVersion();
+
+	//the slots no grid of a frame in flight points at anymore are free for the next edit
+	m_brickMap.FreeRetiredBricks(*std::min_element(m_brickGridVersions.begin(), m_brickGridVersions.end()));
+}
+
+void VoxelEngine::moveBvhVoxels()
+{
+	//every voxel keeps its place in the build order, only its height follows the wave at the current time
+	std::vector<Voxel> movedVoxels;
+	movedVoxels.reserve(m_bvhVoxels.size());
+
+	for (const Voxel& voxel : m_bvhVoxels) {
+		glm::vec3 position = voxel.GetPosition();
+		float phase = (position.x + position.z) / BVH_WAVE_LENGTH * glm::radians(360.0f) + m_runTime;
+		position.y += BVH_WAVE_HEIGHT * glm::sin(phase);
+
+		movedVoxels.emplace_back(position, voxel.GetColor(), voxel.GetSize());
+	}
+
+	m_bvh.Refit(movedVoxels);
+
+	//the node and primitive buffers keep their size, the frames in flight still read them
+	vkDeviceWaitIdle(m_logicalDevice);
+
+	uploadBuffer(m_bvhNodeBuffer, m_bvhNodeBufferMemory, m_uploadPolicy, m_bvh.GetNodes().data(), sizeof(BvhNode) * m_bvh.GetNodes().size());
+	uploadBuffer(m_bvhPrimitiveBuffer, m_bvhPrimitiveBufferMemory, m_uploadPolicy, m_bvh.GetPrimitives().data(), 
+		sizeof(BvhPrimitive) * m_bvh.GetPrimitives().size());
+
+	//the next frame already traces the moved voxels
+	m_uploadRing.WaitIdle();
+
+	m_bvh.PrintStats();
+}
+
+void VoxelEngine::benchmarkMeshing()
+{
+	Scene& scene = m_scenes.at(m_currentScene);
+	size_t voxelCount = scene.GetVoxelCount();
+
+	std::vector<Vertex> vertices;
+	std::vector<PackedVertex> packedVertices;
+	std::vector<uint32_t> indices;
+	std::vector<ChunkDrawRange> ranges;
+
+	std::cout << "" << std::endl;
+	std::cout << "Meshing benchmark over " << voxelCount << " voxels:" << std::endl;
+
+	for (MeshingMode mode : { MeshingMode::NAIVE, MeshingMode::CULLED, MeshingMode::GREEDY })
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		scene.OverwriteVertsAndIndicesMT(vertices, indices, mode);
+		auto end = std::chrono::high_resolution_clock::now();
+
+		float milliseconds = std::chrono::duration<float, std::chrono::milliseconds::period>(end - start).count();
+		size_t meshBytes = vertices.size() * sizeof(Vertex) + indices.size() * sizeof(uint32_t);
+
+		std::cout << "| " << ChunkMesher::GetModeName(mode) 
+			<< ": " << indices.size() / 3 << " triangles" 
+			<< ", " << vertices.size() << " vertices" 
+			<< ", " << meshBytes / (1024 * 1024) << " MB" 
+			<< ", " << milliseconds << " ms" 
+			<< ", " << voxelCount / (milliseconds * 1000.0f) << " MVoxel/s" << std::endl;
+
+		start = std::chrono::high_resolution_clock::now();
+		scene.OverwriteChunkMeshesMT(packedVertices, indices, ranges, mode);
+		end = std::chrono::high_resolution_clock::now();
+
+		milliseconds = std::chrono::duration<float, std::chrono::milliseconds::period>(end - start).count();
+
+		std::cout << "|   packed: " << vertices.size() * sizeof(Vertex) / 1024 << " KB -> " 
+			<< packedVertices.size() * sizeof(PackedVertex) / 1024 << " KB vertex data" 
+			<< ", " << ranges.size() << " chunk draws" 
+			<< ", " << milliseconds << " ms" << std::endl;
+	}
+
+	std::vector<VoxelInstance> instances;
+
+	auto start = std::chrono::high_resolution_clock::now();
+	scene.OverwriteInstances(instances);
+	auto end = std::chrono::high_resolution_clock::now();
+
+	float milliseconds = std::chrono::duration<float, std::chrono::milliseconds::period>(end - start).count();
+
+	std::cout << "| Instanced / Vertex pulling: " << instances.size() * INDICES_COUNT_PER_VOXEL / 3 << " triangles" 
+		<< ", " << instances.size() << " instances" 
+		<< ", " << instances.size() * sizeof(VoxelInstance) / (1024 * 1024) << " MB" 
+		<< ", " << milliseconds << " ms" 
+		<< ", " << voxelCount / (milliseconds * 1000.0f) << " MVoxel/s" << std::endl;
+}
+
+void VoxelEngine::benchmarkUploads()
+{
+	Scene& scene = m_scenes.at(m_currentScene);
+
+	//the two biggest uploads of the engine: the packed chunk mesh and the voxel storage buffer of the ray tracer
+	std::vector<PackedVertex> vertices;
+	std::vector<uint32_t> indices;
+	std::vector<ChunkDrawRange> ranges;
+	scene.OverwriteChunkMeshesMT(vertices, indices, ranges, m_meshingMode);
+
+	std::vector<Voxel> voxel = scene.GetVoxel();
+
+	struct BenchmarkUpload
+	{
+		const char* name;
+		const void* data;
+		VkDeviceSize size;
+		VkBufferUsageFlags usage;
+	};
+
+	std::vector<BenchmarkUpload> uploads = {
+		{ "Chunk mesh vertices", vertices.data(), sizeof(PackedVertex) * vertices.size(), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT },
+		{ "Chunk mesh indices", indices.data(), sizeof(uint32_t) * indices.size(), VK_BUFFER_USAGE_INDEX_BUFFER_BIT },
+		{ "Voxel SSBO", voxel.data(), sizeof(Voxel) * voxel.size(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT }
+	};
+
+	std::cout << "" << std::endl;
+	std::cout << "Upload benchmark, " << UPLOAD_BENCHMARK_RUNS << " runs per path, from buffer creation until the gpu can read the buffer:" << std::endl;
+
+	if (!m_allocator.HasDirectWriteMemory()) 
+	{
+		std::cout << "| no device local host visible memory, only the staged path is measured" << std::endl;
+	}
+
+	//nothing of the frames may be in the ring batches that are waited for
+	m_uploadRing.WaitIdle();
+
+	for (const BenchmarkUpload& upload : uploads) {
+		if (upload.size == 0) 
+		{
+			continue;
+		}
+
+		for (UploadPolicy policy : { UploadPolicy::STAGED, UploadPolicy::DIRECT_WRITE }) 
+		{
+			if (policy == UploadPolicy::DIRECT_WRITE && !useDirectWrite(policy)) 
+			{
+				continue;
+			}
+
+			float milliseconds = 0.0f;
+
+			for (int run = 0; run < UPLOAD_BENCHMARK_RUNS; run++) {
+				auto start = std::chrono::high_resolution_clock::now();
+
+				VkBuffer buffer;
+				MemoryAllocation bufferMemory;
+				createUploadBuffer(upload.size, upload.usage, policy, buffer, bufferMemory);
+
+				uint64_t batch = uploadBuffer(buffer, bufferMemory, policy, upload.data, upload.size);
+				m_uploadRing.WaitForBatch(batch);
+
+				auto end = std::chrono::high_resolution_clock::now();
+				milliseconds += std::chrono::duration<float, std::chrono::milliseconds::period>(end - start).count();
+
+				//never bound to a command buffer, nothing else waits for it
+				vkDestroyBuffer(m_logicalDevice, buffer, nullptr);
+				m_allocator.Free(bufferMemory);
+			}
+
+			milliseconds /= UPLOAD_BENCHMARK_RUNS;
+
+			std::cout << "| " << upload.name << (policy == UploadPolicy::STAGED ? " staged: " : " direct write: ") 
+				<< upload.size / (1024.0f * 1024.0f) << " MB" 
+				<< ", " << milliseconds << " ms" 
+				<< ", " << upload.size / (milliseconds * 1000.0f * 1000.0f) << " GB/s" << std::endl;
+		}
+	}
+}
+
+const char* VoxelEngine::getRenderModeName()
+{
+	switch (m_renderMode)
+	{
+	case RenderMode::EXPANDED_MESH:
+		return "Expanded mesh";
+	case RenderMode::INSTANCED:
+		return "Instanced";
+	case RenderMode::VERTEX_PULLING:
+		return "Vertex pulling";
+	case RenderMode::CHUNKED_MESH:
+		return "Chunked packed mesh";
+	default:
+		return "Unknown";
+	}
 }
 
 void VoxelEngine::getTime()
@@ -1940,6 +3452,19 @@ QueueFamilyIndices VoxelEngine::findQueueFamilies(VkPhysicalDevice device, bool
 		i++;
 	}
 
+	//a transfer family without graphics is usually the dma engine, pure transfer families beat ones that can compute as well
+	for (i = 0; i < queueFamilyCount; i++) {
+		VkQueueFlags flags = queueFamilies[i].queueFlags;
+
+		if (!(flags & VK_QUEUE_TRANSFER_BIT) || (flags & VK_QUEUE_GRAPHICS_BIT)) {
+			continue;
+		}
+
+		if (!indices.transferFamily.has_value() || !(flags & VK_QUEUE_COMPUTE_BIT)) {
+			indices.transferFamily = i;
+		}
+	}
+
 	return indices;
 }
 
@@ -1991,7 +3516,7 @@ void VoxelEngine::createRenderPassCompute()
 
 void VoxelEngine::createDescriptorLayoutCompute()
 {
-	std::array<VkDescriptorSetLayoutBinding, 3> layoutBindings{};
+	std::array<VkDescriptorSetLayoutBinding, 10> layoutBindings{};
 	//Camera UBO
 	layoutBindings[0].binding = 0;
 	layoutBindings[0].descriptorCount = 1;
@@ -2013,6 +3538,55 @@ void VoxelEngine::createDescriptorLayoutCompute()
 	layoutBindings[2].pImmutableSamplers = nullptr;
 	layoutBindings[2].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
 
+	//Trace Grid SSBO
+	layoutBindings[3].binding = 3;
+	layoutBindings[3].descriptorCount = 1;
+	layoutBindings[3].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	layoutBindings[3].pImmutableSamplers = nullptr;
+	layoutBindings[3].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+	//BVH Node SSBO
+	layoutBindings[4].binding = 4;
+	layoutBindings[4].descriptorCount = 1;
+	layoutBindings[4].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	layoutBindings[4].pImmutableSamplers = nullptr;
+	layoutBindings[4].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+	//BVH Primitive SSBO
+	layoutBindings[5].binding = 5;
+	layoutBindings[5].descriptorCount = 1;
+	layoutBindings[5].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	layoutBindings[5].pImmutableSamplers = nullptr;
+	layoutBindings[5].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+	//Sparse Voxel Octree SSBO
+	layoutBindings[6].binding = 6;
+	layoutBindings[6].descriptorCount = 1;
+	layoutBindings[6].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	layoutBindings[6].pImmutableSamplers = nullptr;
+	layoutBindings[6].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+	//Sparse Voxel DAG SSBO
+	layoutBindings[7].binding = 7;
+	layoutBindings[7].descriptorCount = 1;
+	layoutBindings[7].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	layoutBindings[7].pImmutableSamplers = nullptr;
+	layoutBindings[7].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+	//Brick Grid SSBO
+	layoutBindings[8].binding = 8;
+	layoutBindings[8].descriptorCount = 1;
+	layoutBindings[8].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	layoutBindings[8].pImmutableSamplers = nullptr;
+	layoutBindings[8].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+	//Brick Pool SSBO
+	layoutBindings[9].binding = 9;
+	layoutBindings[9].descriptorCount = 1;
+	layoutBindings[9].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	layoutBindings[9].pImmutableSamplers = nullptr;
+	layoutBindings[9].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
 
 	VkDescriptorSetLayoutCreateInfo layoutInfo{};
 	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
@@ -2038,6 +3612,22 @@ void VoxelEngine::createGraphicsAndComputePipeline()
 	computeShaderStageInfo.module = computeShaderModule;
 	computeShaderStageInfo.pName = "main";
 
+	//constant_id 0 of shader.comp picks the structure the rays trace, the other one is compiled out
+	uint32_t rayTracingStructure = static_cast<uint32_t>(m_rayTracingStructure);
+
+	VkSpecializationMapEntry specializationEntry{};
+	specializationEntry.constantID = 0;
+	specializationEntry.offset = 0;
+	specializationEntry.size = sizeof(uint32_t);
+
+	VkSpecializationInfo specializationInfo{};
+	specializationInfo.mapEntryCount = 1;
+	specializationInfo.pMapEntries = &specializationEntry;
+	specializationInfo.dataSize = sizeof(uint32_t);
+	specializationInfo.pData = &rayTracingStructure;
+
+	computeShaderStageInfo.pSpecializationInfo = &specializationInfo;
+
 	VkPipelineLayoutCreateInfo computePipelineLayoutInfo{};
 	computePipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
 	computePipelineLayoutInfo.setLayoutCount = 1;
@@ -2056,7 +3646,7 @@ void VoxelEngine::createGraphicsAndComputePipeline()
 	computePipelineInfo.layout = m_pipelineLayoutCompute;
 	computePipelineInfo.stage = computeShaderStageInfo;
 
-	if (vkCreateComputePipelines(m_logicalDevice, VK_NULL_HANDLE, 1, &computePipelineInfo, nullptr, &m_pipelineCompute) != VK_SUCCESS) {
+	if (m_pipelineCache.CreateComputePipeline(computePipelineInfo, m_pipelineCompute) != VK_SUCCESS) {
 		throw std::runtime_error("failed to create compute pipeline!");
 	}
 	else {
@@ -2193,7 +3783,7 @@ void VoxelEngine::createGraphicsAndComputePipeline()
 	pipelineInfo.subpass = 0;
 	pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
 
-	if (vkCreateGraphicsPipelines(m_logicalDevice, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &m_graphicsPipeline) != VK_SUCCESS) {
+	if (m_pipelineCache.CreateGraphicsPipeline(pipelineInfo, m_graphicsPipeline) != VK_SUCCESS) {
 		throw std::runtime_error("failed to create graphics pipeline!");
 	}
 	else {
@@ -2237,23 +3827,10 @@ void VoxelEngine::createShaderStorageBuffersCompute()
 {
 	//Vertex Buffer
 	VkDeviceSize vertexBufferSize = sizeof(m_vertices2D[0]) * m_vertices2D.size();;
-	VkBuffer vertexStagingBuffer;
-	VkDeviceMemory vertexStagingBufferMemory;
-	createBuffer(vertexBufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, vertexStagingBuffer, vertexStagingBufferMemory);
 
-	void* vertexData;
-	vkMapMemory(m_logicalDevice, vertexStagingBufferMemory, 0, vertexBufferSize, 0, &vertexData);
-	memcpy(vertexData, m_vertices2D.data(), (size_t)vertexBufferSize);
-	vkUnmapMemory(m_logicalDevice, vertexStagingBufferMemory);
+	createUploadBuffer(vertexBufferSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, m_uploadPolicy, m_vertexBuffer, m_vertexBufferMemory);
 
-	createBuffer(vertexBufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_vertexBuffer, m_vertexBufferMemory);
-
-	copyBuffer(vertexStagingBuffer, m_vertexBuffer, vertexBufferSize);
-
-	vkDestroyBuffer(m_logicalDevice, vertexStagingBuffer, nullptr);
-	vkFreeMemory(m_logicalDevice, vertexStagingBufferMemory, nullptr);
+	uploadBuffer(m_vertexBuffer, m_vertexBufferMemory, m_uploadPolicy, m_vertices2D.data(), vertexBufferSize);
 
 	//Index Buffer
 	createIndexBuffer();
@@ -2266,26 +3843,77 @@ void VoxelEngine::createShaderStorageBuffersCompute()
 
 	std::vector<Voxel> voxel = m_scenes[m_currentScene].GetVoxel();
 
-	VkDeviceSize voxelBufferSize = sizeof(Voxel) * m_scenes[m_currentScene].GetVoxel().size();
+	VkDeviceSize voxelBufferSize = sizeof(Voxel) * voxel.size();
 
-	//Create a staging buffer used to upload data to the gpu
-	VkBuffer voxelStagingBuffer;
-	VkDeviceMemory voxelStagingBufferMemory;
-	createBuffer(voxelBufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, 
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, voxelStagingBuffer, voxelStagingBufferMemory);
+	createUploadBuffer(voxelBufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, m_uploadPolicy, m_voxelBuffer, m_voxelBufferMemory);
 
-	void* voxelData;
-	vkMapMemory(m_logicalDevice, voxelStagingBufferMemory, 0, voxelBufferSize, 0, &voxelData);
-	memcpy(voxelData, voxel.data(), (size_t)voxelBufferSize);
-	vkUnmapMemory(m_logicalDevice, voxelStagingBufferMemory);
-	
-	createBuffer(voxelBufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT  | VK_BUFFER_USAGE_TRANSFER_DST_BIT, 
-		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_voxelBuffer, m_voxelBufferMemory);
-	copyBuffer(voxelStagingBuffer, m_voxelBuffer, voxelBufferSize);
+	uploadBuffer(m_voxelBuffer, m_voxelBufferMemory, m_uploadPolicy, voxel.data(), voxelBufferSize);
+
+	//Trace Grid SSBO
+	//the rays walk the occupancy grid instead of testing the voxels, the header alone keeps the buffer from being empty.
+	//every structure is bound either way, the ones shader.comp does not trace are built from no voxels
+	VoxelWorld emptyWorld;
+	m_traceGrid.Build(m_rayTracingStructure == RayTracingStructure::OCCUPANCY_GRID ? m_scenes[m_currentScene].GetWorld() : emptyWorld);
+
+	VkDeviceSize traceGridBufferSize = sizeof(uint32_t) * m_traceGrid.GetData().size();
+
+	createUploadBuffer(traceGridBufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, m_uploadPolicy, m_traceGridBuffer, m_traceGridBufferMemory);
+
+	uploadBuffer(m_traceGridBuffer, m_traceGridBufferMemory, m_uploadPolicy, m_traceGrid.GetData().data(), traceGridBufferSize);
+
+	//BVH SSBOs
+	if (m_rayTracingStructure == RayTracingStructure::BVH)
+	{
+		//kept for the refits of "t"
+		m_bvhVoxels = voxel;
+	}
+
+	m_bvh.Build(m_bvhVoxels);
+	m_bvh.PrintStats();
+
+	VkDeviceSize bvhNodeBufferSize = sizeof(BvhNode) * m_bvh.GetNodes().size();
+
+	createUploadBuffer(bvhNodeBufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, m_uploadPolicy, m_bvhNodeBuffer, m_bvhNodeBufferMemory);
+
+	uploadBuffer(m_bvhNodeBuffer, m_bvhNodeBufferMemory, m_uploadPolicy, m_bvh.GetNodes().data(), bvhNodeBufferSize);
+
+	VkDeviceSize bvhPrimitiveBufferSize = sizeof(BvhPrimitive) * m_bvh.GetPrimitives().size();
+
+	createUploadBuffer(bvhPrimitiveBufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, m_uploadPolicy, m_bvhPrimitiveBuffer, m_bvhPrimitiveBufferMemory);
 
-	//Destroy staging Buffer
-	vkDestroyBuffer(m_logicalDevice, voxelStagingBuffer, nullptr);
-	vkFreeMemory(m_logicalDevice, voxelStagingBufferMemory, nullptr);
+	uploadBuffer(m_bvhPrimitiveBuffer, m_bvhPrimitiveBufferMemory, m_uploadPolicy, m_bvh.GetPrimitives().data(), bvhPrimitiveBufferSize);
+
+	//Sparse Voxel Octree SSBO
+	m_svo.Build(m_rayTracingStructure == RayTracingStructure::SPARSE_VOXEL_OCTREE ? m_scenes[m_currentScene].GetWorld() : emptyWorld);
+	m_svo.PrintStats();
+
+	VkDeviceSize svoBufferSize = sizeof(uint32_t) * m_svo.GetData().size();
+
+	createUploadBuffer(svoBufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, m_uploadPolicy, m_svoBuffer, m_svoBufferMemory);
+
+	uploadBuffer(m_svoBuffer, m_svoBufferMemory, m_uploadPolicy, m_svo.GetData().data(), svoBufferSize);
+
+	//Sparse Voxel DAG SSBO
+	//merged from an octree of its own, only the dag is uploaded
+	SparseVoxelOctree dagOctree;
+	dagOctree.Build(m_rayTracingStructure == RayTracingStructure::SPARSE_VOXEL_DAG ? m_scenes[m_currentScene].GetWorld() : emptyWorld);
+	m_dag.Build(dagOctree);
+	m_dag.PrintStats();
+
+	VkDeviceSize dagBufferSize = sizeof(uint32_t) * m_dag.GetData().size();
+
+	createUploadBuffer(dagBufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, m_uploadPolicy, m_dagBuffer, m_dagBufferMemory);
+
+	uploadBuffer(m_dagBuffer, m_dagBufferMemory, m_uploadPolicy, m_dag.GetData().data(), dagBufferSize);
+
+	//Brick Map SSBOs
+	m_brickMap.Build(m_rayTracingStructure == RayTracingStructure::BRICK_MAP ? m_scenes[m_currentScene].GetWorld() : emptyWorld);
+	m_brickMap.PrintStats();
+
+	//the build covers every chunk, the first edit only streams the chunks it touched
+	m_scenes[m_currentScene].GetWorld().TakeDirtyChunks();
+
+	createBrickMapBuffers();
 
 	//Image 
 	createImage(WIDTH, HEIGHT, VK_FORMAT_R8G8B8A8_SNORM, VK_IMAGE_TILING_OPTIMAL,
@@ -2304,7 +3932,7 @@ void VoxelEngine::createDescriptorPoolCompute()
 	poolSizes[0].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
 
 	poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-	poolSizes[1].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+	poolSizes[1].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT) * 8;
 
 	poolSizes[2].type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE; //VK_DESCRIPTOR_TYPE_STORAGE_IMAGE VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER
 	poolSizes[2].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
@@ -2339,7 +3967,7 @@ void VoxelEngine::createDescriptorSetsCompute()
 	}
 
 	for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-		std::array<VkWriteDescriptorSet, 3> descriptorWrites{};
+		std::array<VkWriteDescriptorSet, 8> descriptorWrites{};
 
 		VkDescriptorBufferInfo uniformBufferInfo{};
 		uniformBufferInfo.buffer = m_uniformBuffers[i];
@@ -2357,7 +3985,7 @@ void VoxelEngine::createDescriptorSetsCompute()
 		VkDescriptorBufferInfo voxelStorageBufferInfo{};
 		voxelStorageBufferInfo.buffer = m_voxelBuffer;
 		voxelStorageBufferInfo.offset = 0;
-		voxelStorageBufferInfo.range = sizeof(Voxel) * m_scenes[m_currentScene].GetVoxel().size();
+		voxelStorageBufferInfo.range = sizeof(Voxel) * m_scenes[m_currentScene].GetVoxelCount();
 
 		descriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
 		descriptorWrites[1].dstSet = m_descriptorSetsCompute[i];
@@ -2380,8 +4008,76 @@ void VoxelEngine::createDescriptorSetsCompute()
 		descriptorWrites[2].descriptorCount = 1;
 		descriptorWrites[2].pImageInfo = &imageInfo;
 
+		VkDescriptorBufferInfo traceGridBufferInfo{};
+		traceGridBufferInfo.buffer = m_traceGridBuffer;
+		traceGridBufferInfo.offset = 0;
+		traceGridBufferInfo.range = sizeof(uint32_t) * m_traceGrid.GetData().size();
+
+		descriptorWrites[3].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		descriptorWrites[3].dstSet = m_descriptorSetsCompute[i];
+		descriptorWrites[3].dstBinding = 3;
+		descriptorWrites[3].dstArrayElement = 0;
+		descriptorWrites[3].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		descriptorWrites[3].descriptorCount = 1;
+		descriptorWrites[3].pBufferInfo = &traceGridBufferInfo;
+
+		VkDescriptorBufferInfo bvhNodeBufferInfo{};
+		bvhNodeBufferInfo.buffer = m_bvhNodeBuffer;
+		bvhNodeBufferInfo.offset = 0;
+		bvhNodeBufferInfo.range = sizeof(BvhNode) * m_bvh.GetNodes().size();
+
+		descriptorWrites[4].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		descriptorWrites[4].dstSet = m_descriptorSetsCompute[i];
+		descriptorWrites[4].dstBinding = 4;
+		descriptorWrites[4].dstArrayElement = 0;
+		descriptorWrites[4].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		descriptorWrites[4].descriptorCount = 1;
+		descriptorWrites[4].pBufferInfo = &bvhNodeBufferInfo;
+
+		VkDescriptorBufferInfo bvhPrimitiveBufferInfo{};
+		bvhPrimitiveBufferInfo.buffer = m_bvhPrimitiveBuffer;
+		bvhPrimitiveBufferInfo.offset = 0;
+		bvhPrimitiveBufferInfo.range = sizeof(BvhPrimitive) * m_bvh.GetPrimitives().size();
+
+		descriptorWrites[5].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		descriptorWrites[5].dstSet = m_descriptorSetsCompute[i];
+		descriptorWrites[5].dstBinding = 5;
+		descriptorWrites[5].dstArrayElement = 0;
+		descriptorWrites[5].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		descriptorWrites[5].descriptorCount = 1;
+		descriptorWrites[5].pBufferInfo = &bvhPrimitiveBufferInfo;
+
+		VkDescriptorBufferInfo svoBufferInfo{};
+		svoBufferInfo.buffer = m_svoBuffer;
+		svoBufferInfo.offset = 0;
+		svoBufferInfo.range = sizeof(uint32_t) * m_svo.GetData().size();
+
+		descriptorWrites[6].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		descriptorWrites[6].dstSet = m_descriptorSetsCompute[i];
+		descriptorWrites[6].dstBinding = 6;
+		descriptorWrites[6].dstArrayElement = 0;
+		descriptorWrites[6].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		descriptorWrites[6].descriptorCount = 1;
+		descriptorWrites[6].pBufferInfo = &svoBufferInfo;
+
+		VkDescriptorBufferInfo dagBufferInfo{};
+		dagBufferInfo.buffer = m_dagBuffer;
+		dagBufferInfo.offset = 0;
+		dagBufferInfo.range = sizeof(uint32_t) * m_dag.GetData().size();
+
+		descriptorWrites[7].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		descriptorWrites[7].dstSet = m_descriptorSetsCompute[i];
+		descriptorWrites[7].dstBinding = 7;
+		descriptorWrites[7].dstArrayElement = 0;
+		descriptorWrites[7].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		descriptorWrites[7].descriptorCount = 1;
+		descriptorWrites[7].pBufferInfo = &dagBufferInfo;
+
 		vkUpdateDescriptorSets(m_logicalDevice, descriptorWrites.size(), descriptorWrites.data(), 0, nullptr);
 	}
+
+	//rewritten on their own when the brick map is rebuilt
+	writeBrickMapDescriptors();
 }
 
 void VoxelEngine::createCommandBuffersCompute()
@@ -2434,6 +4130,9 @@ void VoxelEngine::drawFrameCompute()
 	vkWaitForFences(m_logicalDevice, 1, &m_computeInFlightFences[m_currentFrame], VK_TRUE, UINT64_MAX);
 
 	updateUniformBuffer(m_currentFrame);
+	updateBrickGrid(m_currentFrame);
+
+	m_uploadRing.Flush();
 
 	vkResetFences(m_logicalDevice, 1, &m_computeInFlightFences[m_currentFrame]);
 
@@ -2526,9 +4225,8 @@ void VoxelEngine::recordCommandBufferCompute(VkCommandBuffer a_commandBuffer)
 
 	vkCmdBindDescriptorSets(a_commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipelineLayoutCompute, 0, 1, &m_descriptorSetsCompute[m_currentFrame], 0, nullptr);
 
-	vkCmdDispatch(a_commandBuffer, WIDTH, HEIGHT, 1);
-
-	vkCmdDispatch(a_commandBuffer, ceil(WIDTH/8), ceil(HEIGHT/4), 1);
+	//one invocation per pixel in 8x4 work groups, shader.comp skips the ones past the image
+	vkCmdDispatch(a_commandBuffer, (WIDTH + 7) / 8, (HEIGHT + 3) / 4, 1);
 
 	if (vkEndCommandBuffer(a_commandBuffer) != VK_SUCCESS) {
 		throw std::runtime_error("failed to record compute command buffer!");
@@ -33,6 +33,7 @@
 #include <glm/gtc/matrix_transform.hpp>
 
 #include <chrono>
+#include <memory>
 
 
 #pragma region MyIncludes
@@ -41,6 +42,15 @@
 #include "Camera.h"
 #include "Voxel.h"
 #include "MyStructs.h"
+#include "DeviceMemoryAllocator.h"
+#include "UploadRing.h"
+#include "ChunkMeshArena.h"
+#include "PipelineCache.h"
+#include "TraceGrid.h"
+#include "VoxelBvh.h"
+#include "SparseVoxelOctree.h"
+#include "SparseVoxelDag.h"
+#include "BrickMap.h"
 #include "Scene.h"
 
 
@@ -50,6 +60,69 @@ const std::chrono::steady_clock::time_point startTime = std::chrono::high_resolu
 
 const int MAX_FRAMES_IN_FLIGHT = 2;
 
+// Sphere placed ("e") or carved ("r") in front of the camera
+const float EDIT_SPHERE_RADIUS = 6.0f;
+const float EDIT_SPHERE_DISTANCE = 20.0f;
+// "t" in RayTracingStructure::BVH moves every voxel up and down on a wave this high and long, the bvh is refit and not rebuilt
+const float BVH_WAVE_HEIGHT = 0.5f;
+const float BVH_WAVE_LENGTH = 16.0f;
+
+// Uploads per path and buffer in the "b" upload benchmark
+const int UPLOAD_BENCHMARK_RUNS = 5;
+
+// Chunk draws recorded per secondary command buffer at least, fewer draws are recorded inline into the primary one
+const uint32_t MIN_DRAWS_PER_RECORDING_TASK = 1024;
+// Secondary command buffers a frame is split into at most
+const uint32_t MAX_RECORDING_TASKS = 16;
+
+struct SphereEdit
+{
+	glm::vec3 center;
+	uint32_t material;
+};
+
+// A mesh rebuild on the JobSystem: the job meshes into upload ring regions, creates the new device local buffers (chunked: allocates
+// new ranges in the chunk mesh arena) and queues the copies, the render thread flushes them with the next frame and swaps the new
+// meshes in at a frame boundary once their batch is done. With direct writes the job meshes straight into the final memory
+struct MeshRebuild
+{
+	bool chunked = false;
+	std::vector<glm::ivec3> chunkCoords;		// chunked: the dirty chunks whose meshes get replaced, otherwise every chunk
+	MeshLayout layout;
+
+	uint64_t uploadBatch = 0;					// batch of the upload ring the copies went into, 0 if there was nothing to copy
+
+	// a single mesh of the whole scene
+	std::vector<std::pair<glm::ivec3, ChunkGpuMesh>> meshes;
+	// chunked: one arena mesh per non empty dirty chunk
+	std::vector<std::pair<glm::ivec3, ArenaMesh>> arenaMeshes;
+
+	std::atomic<bool> readyToSwap{ false };		// set by the continuation of the group, the render thread polls it
+	bool jobDone = false;						// the job finished and the edits queued meanwhile went in
+	uint32_t framesDrawn = 0;
+	float longestFrame = 0.0f;
+	std::chrono::high_resolution_clock::time_point startTime;
+	std::chrono::high_resolution_clock::time_point meshedTime;
+
+	TaskGroup group;
+};
+
+// Buffer replaced by a mesh rebuild, destroyed once the frames in flight that may use it have retired
+struct RetiredBuffer
+{
+	VkBuffer buffer;
+	MemoryAllocation memory;
+	uint64_t frameNumber;
+};
+
+// Secondary command buffers of one recording task, one per frame in flight. Every task has a command pool of its own,
+// the tasks of a frame record at the same time on the JobSystem
+struct RecordingSlot
+{
+	VkCommandPool commandPool;
+	std::vector<VkCommandBuffer> commandBuffers;
+};
+
 const std::vector<const char*> validationLayers = {
 	"VK_LAYER_KHRONOS_validation"
 };
@@ -76,6 +149,44 @@ const float ALPHA = 1.0f;
 
 const std::vector<VkQueueFlagBits> neededQueueFlags = { VK_QUEUE_GRAPHICS_BIT };
 
+enum class RenderMode
+{
+	EXPANDED_MESH,	// Scene meshed into Vertex/Index buffers on the CPU
+	INSTANCED,		// one shared cube, every voxel is an instance with position/size/colour
+	VERTEX_PULLING,	// no vertex/index buffers, pulling.vert builds the cubes from the voxel records in a storage buffer
+	CHUNKED_MESH	// chunk local PackedVertex meshes pooled in the chunk mesh arena, drawn indirect per arena page
+};
+
+enum class UploadPolicy
+{
+	STAGED,			// written to the upload ring and copied into device local buffers on the transfer queue
+	DIRECT_WRITE	// vertex, index, instance and voxel buffers live in device local host visible memory and are written by the cpu, 
+					// staged like above if the device has no such memory
+};
+
+enum class ChunkCulling
+{
+	CPU,			// the chunk mesh arena culls the chunk bounds with SIMD and writes the indirect commands of the visible chunks
+	GPU				// cull.comp culls the chunk bounds and compacts the visible chunks into the indirect buffer, 
+					// drawn with vkCmdDrawIndexedIndirectCountKHR (or with instanceCount 0 for culled chunks without it), needs multiDrawIndirect
+};
+
+enum class CommandRecording
+{
+	EVERY_FRAME,	// the command buffer of the frame is reset and recorded again every frame
+	REUSED			// one command buffer per frame in flight and swapchain image, recorded again only after geometry, swapchain or descriptors changed,
+					// every other frame just submits it. The chunked mode with ChunkCulling::CPU records every frame, its draws follow the camera
+};
+
+enum class RayTracingStructure
+{
+	OCCUPANCY_GRID,	// shader.comp walks the chunks and cells of the TraceGrid, voxels have to sit on the integer grid
+	BVH,			// shader.comp traverses a binned SAH bvh over the voxels of the Scene (VoxelBvh)
+	SPARSE_VOXEL_OCTREE,	// shader.comp marches a sparse voxel octree of the surface voxels (SparseVoxelOctree)
+	SPARSE_VOXEL_DAG,	// the same octree with identical subtrees merged and the colours in a stream of their own (SparseVoxelDag)
+	BRICK_MAP		// a coarse grid of 8^3 bricks from a fixed size pool (BrickMap), "e"/"r" edits only upload the bricks they change
+};
+
 class VoxelEngine
 {
 public:
@@ -85,6 +196,14 @@ public:
 protected:
 	
 	bool m_useCompute = false;
+	//culling only removes faces between touching voxels (voxel size >= 0.5), the default scene of 0.2 voxels keeps every face
+	//and CULLED would emit 24 instead of 8 vertices per voxel
+	MeshingMode m_meshingMode = MeshingMode::NAIVE;
+	RenderMode m_renderMode = RenderMode::EXPANDED_MESH;
+	UploadPolicy m_uploadPolicy = UploadPolicy::DIRECT_WRITE;
+	ChunkCulling m_chunkCulling = ChunkCulling::GPU;
+	CommandRecording m_commandRecording = CommandRecording::REUSED;
+	RayTracingStructure m_rayTracingStructure = RayTracingStructure::OCCUPANCY_GRID;
 
 #pragma region VulkanBase
 
@@ -97,7 +216,9 @@ protected:
 
 	void processInput();
 
-	void createAndExecuteShaderBat();
+	//the shaders are compiled at build time, this only recompiles the ones edited since (or all if the .spv files are missing)
+	void compileOutdatedShaders();
+	void printStartupStats();
 
 	void createInstance();
 	bool checkValidationLayerSupport();
@@ -127,6 +248,7 @@ protected:
 	bool checkDeviceExtensionSupport(VkPhysicalDevice a_device);
 
 	void createLogicalDevice();
+	void createPipelineCache();
 
 	void createSurface();
 
@@ -150,22 +272,51 @@ protected:
 	void createCommandPool();
 
 	void createVertexBuffer();
-	uint32_t findMemoryType(uint32_t a_typeFilter, VkMemoryPropertyFlags a_properties);
-	void createBuffer(VkDeviceSize a_size, VkBufferUsageFlags a_usage, VkMemoryPropertyFlags a_properties, VkBuffer& a_buffer, VkDeviceMemory& a_bufferMemory);
-	void copyBuffer(VkBuffer a_srcBuffer, VkBuffer a_dstBuffer, VkDeviceSize a_size);
+	void createBuffer(VkDeviceSize a_size, VkBufferUsageFlags a_usage, VkMemoryPropertyFlags a_properties, VkBuffer& a_buffer, MemoryAllocation& a_bufferMemory, 
+		AllocationLifetime a_lifetime = AllocationLifetime::PERSISTENT);
 
 	void createIndexBuffer(); 
 
+	void createInstanceBuffer();
+	void createUploadResources();
+	bool useDirectWrite(const UploadPolicy a_policy);
+	// A buffer the data of its usage can be uploaded to with uploadBuffer, mapped if a_policy writes it directly
+	void createUploadBuffer(VkDeviceSize a_size, VkBufferUsageFlags a_usage, const UploadPolicy a_policy, VkBuffer& a_buffer, 
+		MemoryAllocation& a_bufferMemory);
+	// Returns the upload batch to wait for, 0 for direct writes
+	uint64_t uploadBuffer(VkBuffer a_buffer, const MemoryAllocation& a_bufferMemory, const UploadPolicy a_policy, const void* a_data, 
+		VkDeviceSize a_size);
+	void startMeshRebuild();
+	void recordMeshRebuild(MeshRebuild& a_rebuild);
+	void recordChunkMeshes(MeshRebuild& a_rebuild);
+	void updateMeshRebuild(const bool a_block);
+	void retireBuffer(VkBuffer& a_buffer, MemoryAllocation& a_bufferMemory);
+	void freeRetiredBuffers(const bool a_all);
+	void writeInstanceDescriptors();
+
 	void createUniformBuffers();
 
 	void createDescriptorPool();
 	void createDescriptorSets();
 
+	//gpu culling of the chunked mode, cull.comp writes the indirect commands of the chunk mesh arena
+	void createChunkCullPipeline();
+	void createChunkCullDescriptorSets();
+	void recordChunkCulling(VkCommandBuffer a_commandBuffer);
+
 	void createCommandBuffers();
+	void createSecondaryCommandBuffers();
+	//splits the chunk draws of the frame over the recording slots, only without multi draw indirect where every chunk is a draw call
+	bool useParallelRecording();
+	void recordChunkDrawsParallel(VkCommandBuffer a_commandBuffer, uint32_t a_imageIndex, const std::vector<VkDescriptorSet>& a_descriptorSets);
+	//CommandRecording::REUSED, reallocated with the swapchain since the image count can change
+	void createReusedCommandBuffers();
+	//the reused command buffers are recorded again before their next submit
+	void invalidateCommandBuffers();
 
 	void createSyncObjects();
 
-	void recordCommandBuffer(VkCommandBuffer a_commandBuffer, uint32_t a_imageIndex, std::vector<VkDescriptorSet> a_descriptorSets);
+	void recordCommandBuffer(VkCommandBuffer a_commandBuffer, uint32_t a_imageIndex, const std::vector<VkDescriptorSet>& a_descriptorSets);
 
 	void drawFrame();
 	void updateUniformBuffer(uint32_t a_currentImage);
@@ -178,13 +329,24 @@ protected:
 	VkFormat findDepthFormat();
 	bool hasStencilComponent(VkFormat a_format); 
 	void createImage(uint32_t a_width, uint32_t a_height, VkFormat a_format, VkImageTiling a_tiling, VkImageUsageFlags a_usage, 
-		VkMemoryPropertyFlags a_properties, VkImage& a_image, VkDeviceMemory& a_imageMemory, VkImageLayout a_initialLayout);
+		VkMemoryPropertyFlags a_properties, VkImage& a_image, MemoryAllocation& a_imageMemory, VkImageLayout a_initialLayout);
 	VkImageView createImageView(VkImage a_image, VkFormat a_format, VkImageAspectFlags a_aspectFlags);
 	void transitionImageLayout(VkImage a_image, VkFormat a_format, VkImageLayout a_oldLayout, VkImageLayout a_newLayout); 
 	VkCommandBuffer beginSingleTimeCommands();
 	void endSingleTimeCommands(VkCommandBuffer a_commandBuffer);
 
 	void updateBuffers();
+	void editSceneAtCamera(const uint32_t a_material);
+	void applySphereEdit(const SphereEdit& a_edit);
+	void createBrickMapBuffers();
+	void destroyBrickMapBuffers();
+	void writeBrickMapDescriptors();
+	void updateBrickMap();
+	void moveBvhVoxels();
+	void updateBrickGrid(const uint32_t a_currentFrame);
+	void benchmarkMeshing();
+	void benchmarkUploads();
+	const char* getRenderModeName();
 
 	std::vector<Vertex> m_vertices = {
 		{{-0.5f, -0.5f, 0.0f},	{1.0f, 0.0f, 0.0f}},	//ROT
@@ -202,9 +364,12 @@ protected:
 	VkDebugUtilsMessengerEXT m_debugMessenger = VK_NULL_HANDLE;
 	VkPhysicalDevice m_physicalDevice = VK_NULL_HANDLE;
 	VkDevice m_logicalDevice = VK_NULL_HANDLE;
+	DeviceMemoryAllocator m_allocator;
+	PipelineCache m_pipelineCache;
 	VkQueue m_graphicsQueue = VK_NULL_HANDLE;
 	VkSurfaceKHR m_surface = VK_NULL_HANDLE;
 	VkQueue m_presentQueue = VK_NULL_HANDLE;
+	VkQueue m_transferQueue = VK_NULL_HANDLE;
 	VkSwapchainKHR m_swapChain = VK_NULL_HANDLE;
 	std::vector<VkImage> m_swapChainImages;
 	VkFormat m_swapChainImageFormat;
@@ -217,21 +382,48 @@ protected:
 	std::vector<VkFramebuffer> m_swapChainFramebuffers;
 	VkCommandPool m_commandPool = VK_NULL_HANDLE;
 	std::vector<VkCommandBuffer> m_commandBuffers;
+	std::vector<RecordingSlot> m_recordingSlots;
+	bool m_reuseCommandBuffers = false;					// CommandRecording::REUSED and commands that do not depend on the camera
+	std::vector<VkCommandBuffer> m_reusedCommandBuffers;	// m_currentFrame * swapchain image count + image index
+	std::vector<uint64_t> m_reusedCommandVersions;		// m_commandVersion the buffer was recorded at, 0 = never
+	uint64_t m_commandVersion = 1;
+	uint64_t m_recordedDrawsVersion = 0;				// draws version of the chunk mesh arena the reused buffers were recorded with
 	std::vector<VkSemaphore> m_imageAvailableSemaphores;
 	std::vector<VkSemaphore> m_renderFinishedSemaphores;
 	std::vector<VkFence> m_inFlightFences;
 	VkBuffer m_vertexBuffer = VK_NULL_HANDLE;
-	VkDeviceMemory m_vertexBufferMemory = VK_NULL_HANDLE;
+	MemoryAllocation m_vertexBufferMemory;
 	VkBuffer m_indexBuffer = VK_NULL_HANDLE;
-	VkDeviceMemory m_indexBufferMemory = VK_NULL_HANDLE;
+	MemoryAllocation m_indexBufferMemory;
+	std::vector<VoxelInstance> m_instances;
+	uint32_t m_indexCount = 0;
+	ChunkMeshArena m_chunkArena;
+	bool m_multiDrawIndirect = false;		// multiDrawIndirect and drawIndirectFirstInstance are enabled
+	glm::mat4 m_viewProjection = glm::mat4(1.0f);		// of the last updateUniformBuffer, the chunk arena culls against it
+	bool m_gpuCulling = false;							// ChunkCulling::GPU, the chunked mode and multi draw indirect
+	PFN_vkCmdDrawIndexedIndirectCountKHR m_vkCmdDrawIndexedIndirectCount = nullptr;		// VK_KHR_draw_indirect_count if the device has it
+	VkDescriptorSetLayout m_cullDescriptorSetLayout = VK_NULL_HANDLE;
+	VkPipelineLayout m_cullPipelineLayout = VK_NULL_HANDLE;
+	VkPipeline m_cullPipeline = VK_NULL_HANDLE;
+	VkDescriptorPool m_cullDescriptorPool = VK_NULL_HANDLE;
+	std::vector<VkDescriptorSet> m_cullDescriptorSets;
+	ChunkCullPushConstants m_cullPushConstants{};
+	std::unique_ptr<MeshRebuild> m_meshRebuild;
+	bool m_meshRebuildQueued = false;
+	std::vector<SphereEdit> m_pendingEdits;
+	std::vector<RetiredBuffer> m_retiredBuffers;
+	uint64_t m_frameNumber = 0;
+	UploadRing m_uploadRing;
+	VkBuffer m_instanceBuffer = VK_NULL_HANDLE;
+	MemoryAllocation m_instanceBufferMemory;
 	std::vector<VkBuffer> m_uniformBuffers;
-	std::vector<VkDeviceMemory> m_uniformBuffersMemory; 
+	std::vector<MemoryAllocation> m_uniformBuffersMemory; 
 	std::vector<void*> m_uniformBuffersMapped;
 	VkDescriptorPool m_descriptorPool = VK_NULL_HANDLE;
 	std::vector<VkDescriptorSet> m_descriptorSets; 
 	int m_currentFrame = 0;
 	VkImage m_depthImage = VK_NULL_HANDLE;
-	VkDeviceMemory m_depthImageMemory = VK_NULL_HANDLE;
+	MemoryAllocation m_depthImageMemory;
 	VkImageView m_depthImageView = VK_NULL_HANDLE;
 
 #pragma endregion
@@ -260,7 +452,29 @@ protected:
 	//VertexBuffer
 	//IndexBuffer
 	VkBuffer m_voxelBuffer;
-	VkDeviceMemory m_voxelBufferMemory;
+	MemoryAllocation m_voxelBufferMemory;
+	TraceGrid m_traceGrid;
+	VkBuffer m_traceGridBuffer = VK_NULL_HANDLE;		// occupancy grid shader.comp traverses
+	MemoryAllocation m_traceGridBufferMemory;
+	VoxelBvh m_bvh;
+	std::vector<Voxel> m_bvhVoxels;						// voxels of the bvh build in build order, the wave of "t" starts from them
+	VkBuffer m_bvhNodeBuffer = VK_NULL_HANDLE;			// depth first BvhNodes, only filled with RayTracingStructure::BVH
+	MemoryAllocation m_bvhNodeBufferMemory;
+	VkBuffer m_bvhPrimitiveBuffer = VK_NULL_HANDLE;		// BvhPrimitives in leaf order
+	MemoryAllocation m_bvhPrimitiveBufferMemory;
+	SparseVoxelOctree m_svo;
+	VkBuffer m_svoBuffer = VK_NULL_HANDLE;				// header, nodes and colours of the octree
+	MemoryAllocation m_svoBufferMemory;
+	SparseVoxelDag m_dag;
+	VkBuffer m_dagBuffer = VK_NULL_HANDLE;				// header, merged nodes and colours of the dag
+	MemoryAllocation m_dagBufferMemory;
+	BrickMap m_brickMap;
+	std::vector<VkBuffer> m_brickGridBuffers;			// header and coarse grid of the brick map, one per frame in flight
+	std::vector<MemoryAllocation> m_brickGridBuffersMemory;
+	std::vector<uint64_t> m_brickGridVersions;			// BrickMap version each grid holds
+	VkBuffer m_brickPoolBuffer = VK_NULL_HANDLE;		// brick slots, only free slots are written while the frames in flight read it
+	MemoryAllocation m_brickPoolBufferMemory;
+	uint64_t m_brickUploadBatch = 0;					// upload batch of the newest streamed bricks
 	//UniformBuffer
 	VkQueue m_queueCompute;
 	std::vector<VkDescriptorSet> m_descriptorSetsCompute;
@@ -273,7 +487,7 @@ protected:
 
 	//testing
 	VkImage m_textureImage;
-	VkDeviceMemory m_textureImageMemory;
+	MemoryAllocation m_textureImageMemory;
 	VkImageView m_textureImageView;
 	VkSampler m_textureSampler;
 	void createTextureRessources();
@@ -297,6 +511,15 @@ protected:
 	float m_lastTime = 0.0f;
 	float m_deltaTime = 0.0f;
 
+	bool m_firstFrameDrawn = false;
+	float m_shaderCompileTime = 0.0f;		// ms
+	uint32_t m_compiledShaderCount = 0;
+	bool m_benchmarkKeyDown = false;
+	bool m_memoryStatsKeyDown = false;
+	bool m_fillKeyDown = false;
+	bool m_carveKeyDown = false;
+	bool m_refitKeyDown = false;
+
 	float m_speed = 1;
 	float m_mouseSpeed = 0.0005f;
 
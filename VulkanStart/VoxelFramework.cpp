@@ -1,8 +1,14 @@
 #include "VoxelFramework.h"
 
-VoxelFramework::VoxelFramework(bool a_compute)
+VoxelFramework::VoxelFramework(bool a_compute, RenderMode a_renderMode, UploadPolicy a_uploadPolicy, ChunkCulling a_chunkCulling, 
+	CommandRecording a_commandRecording, RayTracingStructure a_rayTracingStructure)
 {
 	m_useCompute = a_compute;
+	m_renderMode = a_renderMode;
+	m_uploadPolicy = a_uploadPolicy;
+	m_chunkCulling = a_chunkCulling;
+	m_commandRecording = a_commandRecording;
+	m_rayTracingStructure = a_rayTracingStructure;
 }
 
 void VoxelFramework::InitSceneObjects()
@@ -7,7 +7,9 @@
 class VoxelFramework : public VoxelEngine{
 
 public:
-	VoxelFramework(bool a_compute);
+	VoxelFramework(bool a_compute, RenderMode a_renderMode = RenderMode::EXPANDED_MESH, UploadPolicy a_uploadPolicy = UploadPolicy::DIRECT_WRITE,
+		ChunkCulling a_chunkCulling = ChunkCulling::GPU, CommandRecording a_commandRecording = CommandRecording::REUSED,
+		RayTracingStructure a_rayTracingStructure = RayTracingStructure::OCCUPANCY_GRID);
 
 	void InitSceneObjects();
 };
@@ -0,0 +1,270 @@
+#include "VoxelWorld.h"
+
+static int FloorDiv(const int a_value, const int a_divisor)
+{
+	return (a_value >= 0) ? a_value / a_divisor : (a_value - a_divisor + 1) / a_divisor;
+}
+
+VoxelWorld::VoxelWorld()
+{
+
+}
+
+void VoxelWorld::SetVoxel(const glm::ivec3& a_cell, const uint32_t a_material)
+{
+	if (a_material == EMPTY_MATERIAL) 
+	{
+		RemoveVoxel(a_cell);
+		return;
+	}
+
+	glm::ivec3 chunkCoord = ChunkCoordFromCell(a_cell);
+	glm::ivec3 local = LocalFromCell(a_cell);
+
+	auto it = m_chunks.find(chunkCoord);
+	if (it == m_chunks.end()) 
+	{
+		it = m_chunks.emplace(chunkCoord, VoxelChunk(chunkCoord)).first;
+	}
+
+	VoxelChunk& chunk = it->second;
+	if (chunk.GetMaterial(local.x, local.y, local.z) == a_material) 
+	{
+		return;
+	}
+
+	int solidBefore = chunk.GetSolidCount();
+	chunk.SetMaterial(local.x, local.y, local.z, a_material);
+	m_voxelCount += chunk.GetSolidCount() - solidBefore;
+
+	MarkDirty(a_cell);
+}
+
+void VoxelWorld::RemoveVoxel(const glm::ivec3& a_cell)
+{
+	auto it = m_chunks.find(ChunkCoordFromCell(a_cell));
+	if (it == m_chunks.end()) 
+	{
+		return;
+	}
+
+	glm::ivec3 local = LocalFromCell(a_cell);
+	VoxelChunk& chunk = it->second;
+	if (!chunk.IsSolid(local.x, local.y, local.z)) 
+	{
+		return;
+	}
+
+	int solidBefore = chunk.GetSolidCount();
+	chunk.SetMaterial(local.x, local.y, local.z, EMPTY_MATERIAL);
+	m_voxelCount -= solidBefore - chunk.GetSolidCount();
+
+	MarkDirty(a_cell);
+
+	if (chunk.IsEmpty()) 
+	{
+		m_chunks.erase(it);
+	}
+}
+
+uint32_t VoxelWorld::GetMaterial(const glm::ivec3& a_cell) const
+{
+	const VoxelChunk* chunk = FindChunk(ChunkCoordFromCell(a_cell));
+	if (!chunk) 
+	{
+		return EMPTY_MATERIAL;
+	}
+
+	glm::ivec3 local = LocalFromCell(a_cell);
+	return chunk->GetMaterial(local.x, local.y, local.z);
+}
+
+bool VoxelWorld::IsSolid(const glm::ivec3& a_cell) const
+{
+	return GetMaterial(a_cell) != EMPTY_MATERIAL;
+}
+
+const VoxelChunk* VoxelWorld::FindChunk(const glm::ivec3& a_chunkCoord) const
+{
+	auto it = m_chunks.find(a_chunkCoord);
+	if (it == m_chunks.end()) 
+	{
+		return nullptr;
+	}
+	return &it->second;
+}
+
+const std::unordered_map<glm::ivec3, VoxelChunk, ChunkCoordHash>& VoxelWorld::GetChunks() const
+{
+	return m_chunks;
+}
+
+std::vector<glm::ivec3> VoxelWorld::GetChunkCoords() const
+{
+	std::vector<glm::ivec3> coords;
+	coords.reserve(m_chunks.size());
+
+	for (const auto& chunk : m_chunks) {
+		coords.push_back(chunk.first);
+	}
+
+	return coords;
+}
+
+bool VoxelWorld::GetBounds(glm::ivec3& a_minCell, glm::ivec3& a_maxCell) const
+{
+	if (m_chunks.empty()) 
+	{
+		return false;
+	}
+
+	a_minCell = glm::ivec3(INT32_MAX, INT32_MAX, INT32_MAX);
+	a_maxCell = glm::ivec3(INT32_MIN, INT32_MIN, INT32_MIN);
+
+	for (const auto& chunk : m_chunks) {
+		a_minCell = glm::min(a_minCell, chunk.second.GetOrigin());
+		a_maxCell = glm::max(a_maxCell, chunk.second.GetOrigin() + glm::ivec3(CHUNK_SIZE - 1));
+	}
+
+	return true;
+}
+
+size_t VoxelWorld::GetVoxelCount() const
+{
+	return m_voxelCount;
+}
+
+float VoxelWorld::GetVoxelSize() const
+{
+	return m_voxelSize;
+}
+
+void VoxelWorld::SetVoxelSize(const float a_voxelSize)
+{
+	//every vertex depends on the size
+	if (a_voxelSize != m_voxelSize) 
+	{
+		MarkAllDirty();
+	}
+
+	m_voxelSize = a_voxelSize;
+}
+
+bool VoxelWorld::HasDirtyChunks() const
+{
+	return !m_dirtyChunks.empty();
+}
+
+std::vector<glm::ivec3> VoxelWorld::TakeDirtyChunks()
+{
+	std::vector<glm::ivec3> dirtyChunks(m_dirtyChunks.begin(), m_dirtyChunks.end());
+	m_dirtyChunks.clear();
+	return dirtyChunks;
+}
+
+void VoxelWorld::MarkDirty(const glm::ivec3& a_cell)
+{
+	glm::ivec3 chunkCoord = ChunkCoordFromCell(a_cell);
+	glm::ivec3 local = LocalFromCell(a_cell);
+
+	m_dirtyChunks.insert(chunkCoord);
+
+	//the neighbour chunk culls its border faces against this cell
+	for (int axis = 0; axis < 3; axis++)
+	{
+		glm::ivec3 neighbour = chunkCoord;
+
+		if (local[axis] == 0)
+		{
+			neighbour[axis]--;
+			m_dirtyChunks.insert(neighbour);
+		}
+		else if (local[axis] == CHUNK_SIZE - 1)
+		{
+			neighbour[axis]++;
+			m_dirtyChunks.insert(neighbour);
+		}
+	}
+}
+
+void VoxelWorld::MarkAllDirty()
+{
+	for (const auto& entry : m_chunks) {
+		m_dirtyChunks.insert(entry.first);
+	}
+}
+
+void VoxelWorld::Clear()
+{
+	//the meshes of the removed chunks have to go as well
+	MarkAllDirty();
+
+	m_chunks.clear();
+	m_voxelCount = 0;
+}
+
+void VoxelWorld::ImportVoxel(const std::vector<Voxel>& a_voxel)
+{
+	for (const Voxel& voxel : a_voxel) {
+		SetVoxel(CellFromPosition(voxel.GetPosition()), PackColor(voxel.GetColor()));
+		SetVoxelSize(voxel.GetSize());
+	}
+}
+
+std::vector<Voxel> VoxelWorld::ExportVoxel() const
+{
+	std::vector<Voxel> voxel;
+	voxel.reserve(m_voxelCount);
+
+	for (const auto& entry : m_chunks) {
+		const VoxelChunk& chunk = entry.second;
+		glm::ivec3 origin = chunk.GetOrigin();
+		const std::vector<uint32_t>& materials = chunk.GetMaterials();
+
+		for (int i = 0; i < CHUNK_VOLUME; i++) {
+			if (materials[i] == EMPTY_MATERIAL) 
+			{
+				continue;
+			}
+
+			glm::ivec3 cell = origin + glm::ivec3(i % CHUNK_SIZE, (i / CHUNK_SIZE) % CHUNK_SIZE, i / CHUNK_AREA);
+			voxel.emplace_back(glm::vec3(cell), UnpackColor(materials[i]), m_voxelSize);
+		}
+	}
+
+	return voxel;
+}
+
+glm::ivec3 VoxelWorld::CellFromPosition(const glm::vec3& a_position)
+{
+	return glm::ivec3(glm::floor(a_position + glm::vec3(0.5f)));
+}
+
+glm::ivec3 VoxelWorld::ChunkCoordFromCell(const glm::ivec3& a_cell)
+{
+	return glm::ivec3(FloorDiv(a_cell.x, CHUNK_SIZE), FloorDiv(a_cell.y, CHUNK_SIZE), FloorDiv(a_cell.z, CHUNK_SIZE));
+}
+
+glm::ivec3 VoxelWorld::LocalFromCell(const glm::ivec3& a_cell)
+{
+	return a_cell - ChunkCoordFromCell(a_cell) * CHUNK_SIZE;
+}
+
+uint32_t VoxelWorld::PackColor(const glm::vec3& a_color)
+{
+	glm::vec3 color = glm::clamp(a_color, 0.0f, 1.0f);
+
+	uint32_t r = static_cast<uint32_t>(color.x * 255.0f + 0.5f);
+	uint32_t g = static_cast<uint32_t>(color.y * 255.0f + 0.5f);
+	uint32_t b = static_cast<uint32_t>(color.z * 255.0f + 0.5f);
+
+	return r | (g << 8) | (b << 16) | (255u << 24);
+}
+
+glm::vec3 VoxelWorld::UnpackColor(const uint32_t a_material)
+{
+	return glm::vec3(
+		(a_material & 0xFF) / 255.0f,
+		((a_material >> 8) & 0xFF) / 255.0f,
+		((a_material >> 16) & 0xFF) / 255.0f);
+}
@@ -0,0 +1,66 @@
+#ifndef VOXEL_WORLD_H
+#define VOXEL_WORLD_H
+
+#include <glm/glm.hpp>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "VoxelChunk.h"
+#include "Voxel.h"
+
+struct ChunkCoordHash {
+	size_t operator()(const glm::ivec3& a_coord) const {
+		size_t hash = static_cast<uint32_t>(a_coord.x) * 73856093u;
+		hash ^= static_cast<uint32_t>(a_coord.y) * 19349663u;
+		hash ^= static_cast<uint32_t>(a_coord.z) * 83492791u;
+		return hash;
+	}
+};
+
+// Dense 32^3 chunks keyed by integer chunk coordinate. Every cell is one voxel at an integer world position,
+// the grid stores a single render size for all voxels (half extent like Voxel::m_size)
+class VoxelWorld
+{
+private:
+	std::unordered_map<glm::ivec3, VoxelChunk, ChunkCoordHash> m_chunks;
+	size_t m_voxelCount = 0;
+	float m_voxelSize = 0.5f;
+
+	// Chunks whose mesh changed since the last TakeDirtyChunks, may contain chunks that no longer exist
+	std::unordered_set<glm::ivec3, ChunkCoordHash> m_dirtyChunks;
+
+	void MarkDirty(const glm::ivec3& a_cell);
+	void MarkAllDirty();
+
+public:
+	VoxelWorld();
+
+	void SetVoxel(const glm::ivec3& a_cell, const uint32_t a_material);
+	void RemoveVoxel(const glm::ivec3& a_cell);
+	uint32_t GetMaterial(const glm::ivec3& a_cell) const;
+	bool IsSolid(const glm::ivec3& a_cell) const;
+
+	const VoxelChunk* FindChunk(const glm::ivec3& a_chunkCoord) const;
+	const std::unordered_map<glm::ivec3, VoxelChunk, ChunkCoordHash>& GetChunks() const;
+	std::vector<glm::ivec3> GetChunkCoords() const;
+	bool GetBounds(glm::ivec3& a_minCell, glm::ivec3& a_maxCell) const;
+
+	size_t GetVoxelCount() const;
+	float GetVoxelSize() const;
+	void SetVoxelSize(const float a_voxelSize);
+
+	bool HasDirtyChunks() const;
+	std::vector<glm::ivec3> TakeDirtyChunks();
+
+	void Clear();
+	void ImportVoxel(const std::vector<Voxel>& a_voxel);
+	std::vector<Voxel> ExportVoxel() const;
+
+	static glm::ivec3 CellFromPosition(const glm::vec3& a_position);
+	static glm::ivec3 ChunkCoordFromCell(const glm::ivec3& a_cell);
+	static glm::ivec3 LocalFromCell(const glm::ivec3& a_cell);
+
+	static uint32_t PackColor(const glm::vec3& a_color);
+	static glm::vec3 UnpackColor(const uint32_t a_material);
+};
+#endif // !VOXEL_WORLD_H
@@ -9,20 +9,47 @@
 #include <cmath>
 
 // Change bool Value to switch from Rasterizer to Ray tracer
+// Change renderMode to switch the Rasterizer between the CPU expanded mesh, instanced cubes (one instance per voxel), vertex pulling from a voxel storage buffer
+// and chunk meshes with 8 byte packed vertices (all chunks pooled in a few arena buffers, one indirect draw per buffer)
+// The time to the first frame and the time of every "u" update are printed for each mode
+// Change uploadPolicy to switch between uploads through the staging ring and direct writes into device local host visible memory (used if the device has it)
+// Change chunkCulling to frustum cull the chunks of the chunked mode on the CPU (SIMD) or in a compute pass that writes the indirect draws (needs multi draw indirect)
+// Change commandRecording to record the command buffer every frame or to reuse recorded command buffers until geometry or swapchain change
 // VoxelFramework inherits from  VoxelEngine (The Core) | VoxelFramework can be used to change singular Functions => I used it for Voxel Generation testing purposes
 // shader.vert and shader.frag are Shaders from Rasterizer approach | shader.comp, compshader.vert and compshader.frag are for the Ray tracing approach
+// The Ray tracer walks the chunks and cells of an occupancy grid built from the Scene (TraceGrid) with a 3D DDA, the first solid cell ends the ray
+// Change rayTracingStructure to trace a BVH built over the voxels instead (binned SAH, built in parallel). It takes voxels of any position and size,
+// but the Scene stores its voxels in the VoxelWorld, so it currently traces the same grid voxels as the other structures
+// or a sparse voxel octree of the surface voxels (memory follows the surface, every chunk is a subtree that is rebuilt on its own)
+// or the same octree as a DAG with identical subtrees merged, the colours are kept apart so equal shapes of any colour are shared
+// or a brick map: a coarse grid pointing into a pool of fixed size 8^3 bricks, the only structure "e"/"r" edits stream into while tracing
+// The shaders are compiled to SPIR-V when the project is built (glslc.exe of the Vulkan SDK has to be on the PATH), at startup only shaders edited since are recompiled
+// Created pipelines are kept in shaders/pipeline_cache.bin, the next start of the same GPU and driver creates them from there
 
 // Inputs and Makros
 // Mouse Inputs turn the Camera,
 // WASD moves the Camera through the Scene | SPACE and Left CONTROL are used to go UP and DOWN in the Scene
 // "u" can be used to update the Vertex and Index Buffer from a simple colourfull plane to the desired Voxel Mass created in VoxelFramework::InitSceneObjects (Rasterizer Only)
+// In the chunked mode "u" only remeshes and re-uploads the chunks changed since the last update, all other chunk meshes stay on the GPU
+// Both mesh modes rebuild in the background, the old mesh is drawn until the new one is uploaded and swapped in at a frame boundary
+// "b" meshes the current Scene once per meshing mode and prints triangle count, mesh size and throughput of each mode (Rasterizer Only)
+//     afterwards it uploads the chunk mesh and the voxel storage buffer through both upload paths and prints the time until the gpu can read them
+// "m" prints the device memory stats: blocks, sub allocations, staging ring usage and fragmentation
+// "e" places and "r" carves a sphere of voxels in front of the camera, the chunked mode remeshes the touched chunks right away
+//     (Rasterizer and RayTracingStructure::BRICK_MAP, which uploads only the bricks the edit changed)
+// "t" moves the voxels up and down on a wave and refits the BVH to them instead of building it again (RayTracingStructure::BVH only)
 
 
 int main() { 
 
     bool rayTracing = false;
+    RenderMode renderMode = RenderMode::EXPANDED_MESH;
+    UploadPolicy uploadPolicy = UploadPolicy::DIRECT_WRITE;
+    ChunkCulling chunkCulling = ChunkCulling::GPU;
+    CommandRecording commandRecording = CommandRecording::REUSED;
+    RayTracingStructure rayTracingStructure = RayTracingStructure::OCCUPANCY_GRID;
 
-    VoxelFramework* app = new VoxelFramework(rayTracing);
+    VoxelFramework* app = new VoxelFramework(rayTracing, renderMode, uploadPolicy, chunkCulling, commandRecording, rayTracingStructure);
 
     try {
         if (app) 
@@ -0,0 +1,28 @@
+#version 450
+
+layout(binding = 0) uniform UniformBufferObject {
+    mat4 model;
+    mat4 view;
+    mat4 proj;
+
+    vec3 camPosition;
+    vec3 camForward;
+    vec3 camRight;
+    vec3 camUp;
+} ubo;
+
+// shared unit cube (corners at +-1)
+layout(location = 0) in vec3 inPosition;
+
+// per instance: xyz = voxel center, w = half extent | colour as RGBA8
+layout(location = 1) in vec4 inPositionSize;
+layout(location = 2) in vec4 inColor;
+
+layout(location = 0) out vec3 fragColor;
+
+void main() {
+    vec3 worldPosition = inPositionSize.xyz + inPosition * inPositionSize.w;
+
+    gl_Position = ubo.proj * ubo.view * ubo.model * vec4(worldPosition, 1.0);
+    fragColor = inColor.rgb;
+} 
@@ -1,5 +1,9 @@
 glslc.exe shader.vert -o vert.spv
 glslc.exe shader.frag -o frag.spv
+glslc.exe instanced.vert -o instancedvert.spv
+glslc.exe pulling.vert -o pullingvert.spv
+glslc.exe packed.vert -o packedvert.spv
+glslc.exe cull.comp -o cullcomp.spv
 
 glslc.exe shader.comp -o comp.spv
 glslc.exe compshader.vert -o compvert.spv
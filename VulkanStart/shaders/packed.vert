@@ -0,0 +1,32 @@
+#version 450
+
+layout(binding = 0) uniform UniformBufferObject {
+    mat4 model;
+    mat4 view;
+    mat4 proj;
+
+    vec3 camPosition;
+    vec3 camForward;
+    vec3 camRight;
+    vec3 camUp;
+} ubo;
+
+// ChunkDrawData of the chunk mesh arena, the firstInstance of a chunk draw picks its record: xyz = chunk origin, w = voxel half extent
+layout(std430, binding = 1) readonly buffer ChunkDraws {
+    vec4 chunkOriginSize[];
+};
+
+// PackedVertex: xyz = chunk local cell, w = corner sides (bit 0-2) and face index (bit 3-5)
+layout(location = 0) in uvec4 inCellBits;
+layout(location = 1) in vec4 inColor;
+
+layout(location = 0) out vec3 fragColor;
+
+void main() {
+    vec3 side = vec3(uvec3(inCellBits.w, inCellBits.w >> 1, inCellBits.w >> 2) & 1u) * 2.0 - 1.0;
+    vec4 originSize = chunkOriginSize[gl_InstanceIndex];
+    vec3 worldPosition = originSize.xyz + vec3(inCellBits.xyz) + side * originSize.w;
+
+    gl_Position = ubo.proj * ubo.view * ubo.model * vec4(worldPosition, 1.0);
+    fragColor = inColor.rgb;
+} 
@@ -0,0 +1,54 @@
+#version 450
+
+layout(binding = 0) uniform UniformBufferObject {
+    mat4 model;
+    mat4 view;
+    mat4 proj;
+
+    vec3 camPosition;
+    vec3 camForward;
+    vec3 camRight;
+    vec3 camUp;
+} ubo;
+
+// VoxelInstance records (5 uints each): center xyz, half extent, RGBA8 colour
+layout(std430, binding = 1) readonly buffer VoxelInstances {
+    uint voxelData[];
+};
+
+// same corners and triangle list as Voxel::GetVertices / Voxel::GetIndices
+const vec3 cubeCorners[8] = vec3[](
+    vec3( 1.0,  1.0,  1.0),
+    vec3(-1.0,  1.0,  1.0),
+    vec3(-1.0, -1.0,  1.0),
+    vec3( 1.0, -1.0,  1.0),
+    vec3( 1.0,  1.0, -1.0),
+    vec3(-1.0,  1.0, -1.0),
+    vec3(-1.0, -1.0, -1.0),
+    vec3( 1.0, -1.0, -1.0)
+);
+
+const int cubeIndices[36] = int[](
+    0, 1, 2, 2, 3, 0,
+    4, 6, 5, 4, 7, 6,
+    1, 5, 6, 1, 6, 2,
+    2, 6, 7, 2, 7, 3,
+    0, 4, 5, 0, 5, 1,
+    3, 7, 4, 3, 4, 0
+);
+
+layout(location = 0) out vec3 fragColor;
+
+void main() {
+    uint voxel = uint(gl_VertexIndex) / 36u;
+    uint base = voxel * 5u;
+
+    vec3 center = vec3(uintBitsToFloat(voxelData[base + 0u]), uintBitsToFloat(voxelData[base + 1u]), uintBitsToFloat(voxelData[base + 2u]));
+    float size = uintBitsToFloat(voxelData[base + 3u]);
+    vec4 color = unpackUnorm4x8(voxelData[base + 4u]);
+
+    vec3 worldPosition = center + cubeCorners[cubeIndices[gl_VertexIndex % 36]] * size;
+
+    gl_Position = ubo.proj * ubo.view * ubo.model * vec4(worldPosition, 1.0);
+    fragColor = color.rgb;
+} 